@@ -12,9 +12,15 @@ macro(tablegen ofn)
     set(LLVM_TARGET_DEFINITIONS_ABSOLUTE 
       ${CMAKE_CURRENT_SOURCE_DIR}/${LLVM_TARGET_DEFINITIONS})
   endif()
+  set(tablegen_flags ${ARGN})
+  list(FIND tablegen_flags -gen-dag-isel dag_isel_idx)
+  if (LLVM_DAGISEL_DIRECT_DISPATCH AND NOT dag_isel_idx EQUAL -1)
+    list(APPEND tablegen_flags -dag-isel-direct-dispatch)
+  endif()
+
   add_custom_command(OUTPUT ${CMAKE_CURRENT_BINARY_DIR}/${ofn}.tmp
     # Generate tablegen output in a temporary file.
-    COMMAND ${LLVM_TABLEGEN_EXE} ${ARGN} -I ${CMAKE_CURRENT_SOURCE_DIR}
+    COMMAND ${LLVM_TABLEGEN_EXE} ${tablegen_flags} -I ${CMAKE_CURRENT_SOURCE_DIR}
     -I ${LLVM_MAIN_SRC_DIR}/lib/Target -I ${LLVM_MAIN_INCLUDE_DIR}
     ${LLVM_TARGET_DEFINITIONS_ABSOLUTE} 
     -o ${CMAKE_CURRENT_BINARY_DIR}/${ofn}.tmp
@@ -0,0 +1,315 @@
+//===- llvm/ADT/ConcurrentDenseMap.h - Thread-safe hash table ---*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the ConcurrentDenseMap class, a hash table that can be
+// read and inserted into from many threads at once without a lock around it.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_ADT_CONCURRENTDENSEMAP_H
+#define LLVM_ADT_CONCURRENTDENSEMAP_H
+
+#include "llvm/ADT/DenseMapInfo.h"
+#include "llvm/Support/Atomic.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/RWMutex.h"
+#include <algorithm>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+
+/// ConcurrentDenseMap - An open-addressing hash table like DenseMap, safe to
+/// use from several threads at once.  Lookups never block or take a lock.
+/// Inserts and erases claim buckets with compare-and-swap, so they do not
+/// block each other; they only wait for the rare rehash, which copies the live
+/// entries into a bigger table.
+///
+/// Entries cannot be changed once inserted, only erased, so lookup returns a
+/// copy of the value as it was inserted.  Erased entries keep their bucket
+/// until the next rehash.  The tables replaced by a rehash are kept until the
+/// map is destroyed or reclaim() is called, since other threads may still be
+/// reading them; maps that see many erases should call reclaim() now and then.
+///
+/// Keys are hashed and compared with KeyInfoT like in DenseMap.  Unlike
+/// DenseMap, the empty and tombstone keys may be stored, as the state of each
+/// bucket is kept apart from its key.
+template<typename KeyT, typename ValueT,
+         typename KeyInfoT = DenseMapInfo<KeyT> >
+class ConcurrentDenseMap {
+  typedef std::pair<KeyT, ValueT> BucketT;
+
+  // The state of each bucket is one word: Empty, Busy while its entry is
+  // being written, then the low bits of the key's hash with Ready or Dead
+  // ORed in.  Probes only look at the key of a bucket whose tag says it holds
+  // a live entry with the right hash.
+  enum {
+    Empty = 0,
+    Busy = 1,
+    Ready = 2,
+    Dead = 3,
+    StateMask = 3
+  };
+
+  struct Bucket {
+    volatile sys::cas_flag Tag;
+    BucketT KV;
+  };
+
+  struct Table {
+    unsigned NumBuckets;
+    /// Used - Buckets claimed so far, live or dead.  Once it reaches MaxUsed,
+    /// inserts wait for a rehash.
+    volatile sys::cas_flag Used;
+    unsigned MaxUsed;
+    Bucket *Buckets;
+
+    explicit Table(unsigned N) : NumBuckets(N), Used(0), MaxUsed(N / 4 * 3) {
+      Buckets = static_cast<Bucket*>(operator new(N * sizeof(Bucket)));
+      for (unsigned i = 0; i != N; ++i)
+        Buckets[i].Tag = Empty;
+    }
+
+    ~Table() {
+      for (unsigned i = 0; i != NumBuckets; ++i)
+        if (Buckets[i].Tag != Empty)
+          Buckets[i].KV.~BucketT();
+      operator delete(Buckets);
+    }
+  };
+
+  Table *volatile Current;
+
+  /// Retired - Tables replaced by a rehash.
+  std::vector<Table*> Retired;
+
+  /// NumEntries - The number of live entries.
+  volatile sys::cas_flag NumEntries;
+
+  /// RehashLock - Held for reading by inserts and erases, and for writing
+  /// while a rehash copies the table.
+  mutable sys::RWMutex RehashLock;
+
+  ConcurrentDenseMap(const ConcurrentDenseMap &);  // DO NOT IMPLEMENT
+  void operator=(const ConcurrentDenseMap &);  // DO NOT IMPLEMENT
+
+public:
+  explicit ConcurrentDenseMap(unsigned NumInitBuckets = 64) : NumEntries(0) {
+    unsigned N = NextPowerOf2(NumInitBuckets - 1);
+    Current = new Table(std::max(16U, N));
+  }
+
+  ~ConcurrentDenseMap() {
+    delete Current;
+    for (unsigned i = 0, e = Retired.size(); i != e; ++i)
+      delete Retired[i];
+  }
+
+  /// size - The number of entries.  While other threads are inserting or
+  /// erasing, the result may already be out of date.
+  unsigned size() const { return NumEntries; }
+  bool empty() const { return NumEntries == 0; }
+
+  /// count - Return 1 if the specified key is in the map, 0 otherwise.
+  unsigned count(const KeyT &Key) const {
+    return findBucket(Key) ? 1 : 0;
+  }
+
+  /// lookup - Return the entry for the specified key, or a default
+  /// constructed value if no such entry exists.
+  ValueT lookup(const KeyT &Key) const {
+    if (const Bucket *B = findBucket(Key))
+      return B->KV.second;
+    return ValueT();
+  }
+
+  /// lookup - If the key is in the map, copy its value into Val and return
+  /// true.
+  bool lookup(const KeyT &Key, ValueT &Val) const {
+    const Bucket *B = findBucket(Key);
+    if (!B)
+      return false;
+    Val = B->KV.second;
+    return true;
+  }
+
+  /// insert - Insert the specified key/value pair into the map if the key
+  /// isn't already in the map.  Return true if it was inserted.  If two
+  /// threads insert the same key at once, exactly one of them succeeds.
+  bool insert(const std::pair<KeyT, ValueT> &KV) {
+    unsigned Hash = KeyInfoT::getHashValue(KV.first);
+    sys::cas_flag LiveTag = getTag(Hash, Ready);
+
+    for (;;) {
+      RehashLock.reader_acquire();
+      Table *T = Current;
+      unsigned Mask = T->NumBuckets - 1;
+      unsigned Idx = Hash & Mask;
+      for (unsigned Probe = 1; ; Idx = (Idx + Probe++) & Mask) {
+        Bucket &B = T->Buckets[Idx];
+        sys::cas_flag Tag = B.Tag;
+
+        if (Tag == Empty) {
+          if (sys::AtomicIncrement(&T->Used) > T->MaxUsed) {
+            sys::AtomicDecrement(&T->Used);
+            break;
+          }
+          Tag = sys::CompareAndSwap(&B.Tag, Busy, Empty);
+          if (Tag == Empty) {
+            new (&B.KV) BucketT(KV);
+            sys::MemoryFence();
+            B.Tag = LiveTag;
+            sys::AtomicIncrement(&NumEntries);
+            RehashLock.reader_release();
+            return true;
+          }
+          // Someone else claimed the bucket first; look at what they put in.
+          sys::AtomicDecrement(&T->Used);
+        }
+
+        // Another insert is writing this bucket.  Wait for it: it may be
+        // inserting the same key.  Writing an entry is quick, so spin for a
+        // while, then yield in case the writer was preempted.
+        for (unsigned Spins = 0; Tag == Busy; Tag = B.Tag)
+          if (++Spins > 64)
+            sys::ThreadYield();
+
+        if (Tag == LiveTag) {
+          sys::MemoryFence();
+          if (KeyInfoT::isEqual(B.KV.first, KV.first)) {
+            RehashLock.reader_release();
+            return false;
+          }
+        }
+      }
+
+      // The table is full.
+      RehashLock.reader_release();
+      rehash(T);
+    }
+  }
+
+  /// erase - Remove the specified key from the map.  Return true if it was
+  /// there.
+  bool erase(const KeyT &Key) {
+    unsigned Hash = KeyInfoT::getHashValue(Key);
+    sys::cas_flag LiveTag = getTag(Hash, Ready);
+
+    RehashLock.reader_acquire();
+    Table *T = Current;
+    unsigned Mask = T->NumBuckets - 1;
+    unsigned Idx = Hash & Mask;
+    bool Erased = false;
+    for (unsigned Probe = 1; ; Idx = (Idx + Probe++) & Mask) {
+      Bucket &B = T->Buckets[Idx];
+      sys::cas_flag Tag = B.Tag;
+      if (Tag == Empty)
+        break;
+      if (Tag == LiveTag) {
+        sys::MemoryFence();
+        if (KeyInfoT::isEqual(B.KV.first, Key)) {
+          Erased = sys::CompareAndSwap(&B.Tag, getTag(Hash, Dead), LiveTag) ==
+                   LiveTag;
+          break;
+        }
+      }
+    }
+    if (Erased)
+      sys::AtomicDecrement(&NumEntries);
+    RehashLock.reader_release();
+    return Erased;
+  }
+
+  /// reclaim - Free the tables replaced by rehashes.  No other thread may be
+  /// using the map at the same time.
+  void reclaim() {
+    for (unsigned i = 0, e = Retired.size(); i != e; ++i)
+      delete Retired[i];
+    Retired.clear();
+  }
+
+  /// getMemorySize - Return the approximate size (in bytes) of the tables,
+  /// including those kept alive after a rehash.
+  size_t getMemorySize() const {
+    RehashLock.reader_acquire();
+    size_t Size = Current->NumBuckets * sizeof(Bucket);
+    for (unsigned i = 0, e = Retired.size(); i != e; ++i)
+      Size += Retired[i]->NumBuckets * sizeof(Bucket);
+    RehashLock.reader_release();
+    return Size;
+  }
+
+private:
+  static sys::cas_flag getTag(unsigned Hash, unsigned State) {
+    return (sys::cas_flag)(Hash << 2) | State;
+  }
+
+  const Bucket *findBucket(const KeyT &Key) const {
+    unsigned Hash = KeyInfoT::getHashValue(Key);
+    sys::cas_flag LiveTag = getTag(Hash, Ready);
+    // A rehash publishes its table only once it is complete, and never frees
+    // the old one, so whichever table is read here stays valid.
+    const Table *T = Current;
+    unsigned Mask = T->NumBuckets - 1;
+    unsigned Idx = Hash & Mask;
+    for (unsigned Probe = 1; ; Idx = (Idx + Probe++) & Mask) {
+      const Bucket &B = T->Buckets[Idx];
+      sys::cas_flag Tag = B.Tag;
+      if (Tag == Empty)
+        return 0;
+      // A Busy bucket holds an insert that has not finished yet, so it is
+      // fine not to see it.
+      if (Tag == LiveTag) {
+        sys::MemoryFence();
+        if (KeyInfoT::isEqual(B.KV.first, Key))
+          return &B;
+      }
+    }
+  }
+
+  /// rehash - Replace Old, which is full, with a table holding just its live
+  /// entries, twice as big if they take up more than half of it.
+  void rehash(Table *Old) {
+    RehashLock.writer_acquire();
+    if (Current == Old) {
+      unsigned NumLive = 0;
+      for (unsigned i = 0; i != Old->NumBuckets; ++i)
+        if ((Old->Buckets[i].Tag & StateMask) == Ready)
+          ++NumLive;
+      unsigned NewSize = Old->NumBuckets;
+      if (NumLive * 2 >= Old->NumBuckets)
+        NewSize *= 2;
+
+      Table *New = new Table(NewSize);
+      unsigned Mask = NewSize - 1;
+      for (unsigned i = 0; i != Old->NumBuckets; ++i) {
+        Bucket &B = Old->Buckets[i];
+        if ((B.Tag & StateMask) != Ready)
+          continue;
+        unsigned Idx = KeyInfoT::getHashValue(B.KV.first) & Mask;
+        for (unsigned Probe = 1; New->Buckets[Idx].Tag != Empty;
+             Idx = (Idx + Probe++) & Mask)
+          ;
+        new (&New->Buckets[Idx].KV) BucketT(B.KV);
+        New->Buckets[Idx].Tag = B.Tag;
+      }
+      New->Used = NumLive;
+
+      sys::MemoryFence();
+      Current = New;
+      Retired.push_back(Old);
+    }
+    RehashLock.writer_release();
+  }
+};
+
+} // end namespace llvm
+
+#endif
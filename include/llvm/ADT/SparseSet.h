@@ -0,0 +1,606 @@
+//===--- llvm/ADT/SparseSet.h - Sparse set ----------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the SparseSet class, which is a set of small integer keys
+// with constant time insert, erase, lookup and clear, and fast iteration.
+//
+// A sparse set is made of a dense vector holding the members in insertion
+// order, and a sparse array indexed by key pointing into the dense vector.
+// The sparse array is never cleared: a slot is only trusted if the dense entry
+// it points at has the same key.  See Briggs and Torczon, "An efficient
+// representation for sparse sets", ACM LOPLAS 2 (1993).
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_ADT_SPARSESET_H
+#define LLVM_ADT_SPARSESET_H
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/DataTypes.h"
+#include <cassert>
+#include <cstdlib>
+#include <limits>
+#include <utility>
+
+namespace llvm {
+
+/// SparseSetValTraits - Objects in a SparseSet are identified by keys that can
+/// be uniquely converted to a small integer less than the set's universe. This
+/// class allows the set to hold values that differ from the set's key type as
+/// long as an index can still be derived from the value. SparseSet never
+/// directly compares ValueT, only their indices, so it can map keys to
+/// arbitrary values. SparseSetValTraits computes the index from the value
+/// object. To compute the index from a key, SparseSet uses a separate
+/// KeyFunctorT template argument.
+///
+/// A simple type declaration, SparseSet<Type>, handles these cases:
+/// - unsigned key, identity index, identity value
+/// - unsigned key, identity index, fat value providing getSparseSetIndex()
+///
+/// The type declaration SparseSet<Type, UnaryFunction> handles:
+/// - unsigned key, remapped index, identity value (virtual registers)
+/// - pointer key, pointer-derived index, identity value (node+ID)
+/// - pointer key, pointer-derived index, fat value with getSparseSetIndex()
+///
+/// Only other, unexpected cases require specializing SparseSetValTraits.
+///
+/// For best results, ValueT should not require a destructor.
+///
+template<typename ValueT>
+struct SparseSetValTraits {
+  static unsigned getValIndex(const ValueT &Val) {
+    return Val.getSparseSetIndex();
+  }
+};
+
+/// SparseSetValFunctor - Helper class for selecting SparseSetValTraits. The
+/// generic implementation handles ValueT classes which either provide
+/// getSparseSetIndex() or specialize SparseSetValTraits<>.
+///
+template<typename KeyT, typename ValueT, typename KeyFunctorT>
+struct SparseSetValFunctor {
+  unsigned operator()(const ValueT &Val) const {
+    return SparseSetValTraits<ValueT>::getValIndex(Val);
+  }
+};
+
+/// SparseSetValFunctor<KeyT, KeyT> - Helper class for the common case of
+/// identity key/value sets.
+template<typename KeyT, typename KeyFunctorT>
+struct SparseSetValFunctor<KeyT, KeyT, KeyFunctorT> {
+  unsigned operator()(const KeyT &Key) const {
+    return KeyFunctorT()(Key);
+  }
+};
+
+/// SparseSet - Fast set implmentation for objects that can be identified by
+/// small unsigned keys.
+///
+/// SparseSet allocates memory proportional to the size of the key universe, so
+/// it is not recommended for building composite data structures.  It is useful
+/// for algorithms that require a single set with fast operations.
+///
+/// Compared to DenseSet and DenseMap, SparseSet provides constant-time fast
+/// clear() and iteration as fast as a vector.  The find(), insert(), and
+/// erase() operations are all constant time, and typically faster than a hash
+/// table.  The iteration order doesn't depend on numerical key values, it only
+/// depends on the order of insert() and erase() operations.  When no elements
+/// have been erased, the iteration order is the insertion order.
+///
+/// Compared to BitVector, SparseSet<unsigned> uses 8x-40x more memory, but
+/// offers constant-time clear() and size() operations as well as fast
+/// iteration independent on the size of the universe.
+///
+/// SparseSet contains a dense vector holding all the objects and a sparse
+/// array holding indexes into the dense vector.  Most of the memory is used by
+/// the sparse array which is the size of the key universe.  The SparseT
+/// template parameter provides a space/speed tradeoff for sets holding many
+/// elements.
+///
+/// When SparseT is uint32_t, find() only touches 2 cache lines, but the sparse
+/// array uses 4 x Universe bytes.
+///
+/// When SparseT is uint8_t (the default), find() touches up to 2+[N/256] cache
+/// lines, but the sparse array is 4x smaller.  N is the number of elements in
+/// the set.
+///
+/// For sets that may grow to thousands of elements, SparseT should be set to
+/// uint16_t or uint32_t.
+///
+/// @param ValueT      The type of objects in the set.
+/// @param KeyFunctorT A functor that computes an unsigned index from KeyT.
+/// @param SparseT     An unsigned integer type. See above.
+///
+template<typename ValueT,
+         typename KeyFunctorT = llvm::identity<unsigned>,
+         typename SparseT = uint8_t>
+class SparseSet {
+  typedef typename KeyFunctorT::argument_type KeyT;
+  typedef SmallVector<ValueT, 8> DenseT;
+  DenseT Dense;
+  SparseT *Sparse;
+  unsigned Universe;
+  KeyFunctorT KeyIndexOf;
+  SparseSetValFunctor<KeyT, ValueT, KeyFunctorT> ValIndexOf;
+
+  // Disable copy construction and assignment.
+  // This data structure is not meant to be used that way.
+  SparseSet(const SparseSet&); // DO NOT IMPLEMENT.
+  SparseSet &operator=(const SparseSet&); // DO NOT IMPLEMENT.
+
+public:
+  typedef ValueT value_type;
+  typedef ValueT &reference;
+  typedef const ValueT &const_reference;
+  typedef ValueT *pointer;
+  typedef const ValueT *const_pointer;
+
+  SparseSet() : Sparse(0), Universe(0) {}
+  ~SparseSet() { free(Sparse); }
+
+  /// setUniverse - Set the universe size which determines the largest key the
+  /// set can hold.  The universe must be sized before any elements can be
+  /// added.
+  ///
+  /// @param U Universe size. All object keys must be less than U.
+  ///
+  void setUniverse(unsigned U) {
+    // It's not hard to resize the universe on a non-empty set, but it doesn't
+    // seem like a likely use case, so we can add that code when we need it.
+    assert(empty() && "Can only resize universe on an empty map");
+    // Hysteresis prevents needless reallocations.
+    if (U >= Universe/4 && U <= Universe)
+      return;
+    free(Sparse);
+    // The Sparse array doesn't actually need to be initialized, so malloc
+    // would be enough here, but that will cause tools like valgrind to
+    // complain about branching on uninitialized data.
+    Sparse = reinterpret_cast<SparseT*>(calloc(U, sizeof(SparseT)));
+    Universe = U;
+  }
+
+  // Import trivial vector stuff from DenseT.
+  typedef typename DenseT::iterator iterator;
+  typedef typename DenseT::const_iterator const_iterator;
+
+  const_iterator begin() const { return Dense.begin(); }
+  const_iterator end() const { return Dense.end(); }
+  iterator begin() { return Dense.begin(); }
+  iterator end() { return Dense.end(); }
+
+  /// empty - Returns true if the set is empty.
+  ///
+  /// This is not the same as BitVector::empty().
+  ///
+  bool empty() const { return Dense.empty(); }
+
+  /// size - Returns the number of elements in the set.
+  ///
+  /// This is not the same as BitVector::size() which returns the size of the
+  /// universe.
+  ///
+  unsigned size() const { return Dense.size(); }
+
+  /// clear - Clears the set.  This is a very fast constant time operation.
+  ///
+  void clear() {
+    // Sparse does not need to be cleared, see find().
+    Dense.clear();
+  }
+
+  /// findIndex - Find an element by its index.
+  ///
+  /// @param   Idx A valid index to find.
+  /// @returns An iterator to the element identified by key, or end().
+  ///
+  iterator findIndex(unsigned Idx) {
+    assert(Idx < Universe && "Key out of range");
+    const unsigned Stride = std::numeric_limits<SparseT>::max() + 1u;
+    for (unsigned i = Sparse[Idx], e = size(); i < e; i += Stride) {
+      const unsigned FoundIdx = ValIndexOf(Dense[i]);
+      assert(FoundIdx < Universe && "Invalid key in set. Did object mutate?");
+      if (Idx == FoundIdx)
+        return begin() + i;
+      // Stride is 0 when SparseT >= unsigned.  We don't need to loop.
+      if (!Stride)
+        break;
+    }
+    return end();
+  }
+
+  /// find - Find an element by its key.
+  ///
+  /// @param   Key A valid key to find.
+  /// @returns An iterator to the element identified by key, or end().
+  ///
+  iterator find(const KeyT &Key) {
+    return findIndex(KeyIndexOf(Key));
+  }
+
+  const_iterator find(const KeyT &Key) const {
+    return const_cast<SparseSet*>(this)->findIndex(KeyIndexOf(Key));
+  }
+
+  /// count - Returns 1 if this set contains an element identified by Key,
+  /// 0 otherwise.
+  ///
+  unsigned count(const KeyT &Key) const {
+    return find(Key) == end() ? 0 : 1;
+  }
+
+  /// insert - Attempts to insert a new element.
+  ///
+  /// If Val is successfully inserted, return (I, true), where I is an iterator
+  /// pointing to the newly inserted element.
+  ///
+  /// If the set already contains an element with the same key as Val, return
+  /// (I, false), where I is an iterator pointing to the existing element.
+  ///
+  /// Insertion invalidates all iterators.
+  ///
+  std::pair<iterator, bool> insert(const ValueT &Val) {
+    unsigned Idx = ValIndexOf(Val);
+    iterator I = findIndex(Idx);
+    if (I != end())
+      return std::make_pair(I, false);
+    Sparse[Idx] = size();
+    Dense.push_back(Val);
+    return std::make_pair(end() - 1, true);
+  }
+
+  /// operator[] - Return the element with Key, default constructing it from
+  /// the key if it isn't in the set yet.
+  ValueT &operator[](const KeyT &Key) {
+    return *insert(ValueT(Key)).first;
+  }
+
+  /// erase - Erases an existing element identified by a valid iterator.
+  ///
+  /// This invalidates all iterators, but erase() returns an iterator pointing
+  /// to the next element.  This makes it possible to erase selected elements
+  /// while iterating over the set:
+  ///
+  ///   for (SparseSet::iterator I = Set.begin(); I != Set.end();)
+  ///     if (test(*I))
+  ///       I = Set.erase(I);
+  ///     else
+  ///       ++I;
+  ///
+  /// Note that end() changes when elements are erased, unlike std::list.
+  ///
+  iterator erase(iterator I) {
+    assert(unsigned(I - begin()) < size() && "Invalid iterator");
+    if (I != end() - 1) {
+      *I = Dense.back();
+      unsigned BackIdx = ValIndexOf(Dense.back());
+      assert(BackIdx < Universe && "Invalid key in set. Did object mutate?");
+      Sparse[BackIdx] = I - begin();
+    }
+    // This depends on SmallVector::pop_back() not invalidating iterators.
+    // std::vector::pop_back() doesn't give that guarantee.
+    Dense.pop_back();
+    return I;
+  }
+
+  /// erase - Erases an element identified by Key, if it exists.
+  ///
+  /// @param   Key The key identifying the element to erase.
+  /// @returns True when an element was erased, false if no element was found.
+  ///
+  bool erase(const KeyT &Key) {
+    iterator I = find(Key);
+    if (I == end())
+      return false;
+    erase(I);
+    return true;
+  }
+};
+
+/// SparseMultiSet - Like SparseSet, but several values may share a key.  The
+/// values with the same key form a doubly linked list threaded through the
+/// dense vector, and iterating over a key visits its values in the order they
+/// were inserted.  The sparse array points at the head of each list.
+///
+/// Erased values leave a hole in the dense vector, which is put on a free list
+/// and reused by the next insert.  clear() is still constant time.
+///
+/// @param ValueT      The type of objects in the set.
+/// @param KeyFunctorT A functor that computes an unsigned index from KeyT.
+/// @param SparseT     An unsigned integer type. See SparseSet.
+///
+template<typename ValueT,
+         typename KeyFunctorT = llvm::identity<unsigned>,
+         typename SparseT = uint8_t>
+class SparseMultiSet {
+  typedef typename KeyFunctorT::argument_type KeyT;
+
+  /// SMSNode - A value and its links.  The head of each list has its Prev
+  /// pointing at the tail of the list, and the tail has no Next, so both ends
+  /// can be reached in constant time.  A node on the free list has no Prev.
+  struct SMSNode {
+    static const unsigned INVALID = ~0U;
+
+    ValueT Data;
+    unsigned Prev;
+    unsigned Next;
+
+    SMSNode(const ValueT &D, unsigned P, unsigned N)
+      : Data(D), Prev(P), Next(N) {}
+
+    bool isTail() const { return Next == INVALID; }
+    bool isTombstone() const { return Prev == INVALID; }
+  };
+
+  static const unsigned INVALID = SMSNode::INVALID;
+
+  typedef SmallVector<SMSNode, 8> DenseT;
+  DenseT Dense;
+  SparseT *Sparse;
+  unsigned Universe;
+  KeyFunctorT KeyIndexOf;
+  SparseSetValFunctor<KeyT, ValueT, KeyFunctorT> ValIndexOf;
+
+  /// FreelistIdx - The first hole in Dense, with the rest linked through
+  /// their Next fields.
+  unsigned FreelistIdx;
+  unsigned NumFree;
+
+  // Disable copy construction and assignment.
+  // This data structure is not meant to be used that way.
+  SparseMultiSet(const SparseMultiSet&); // DO NOT IMPLEMENT.
+  SparseMultiSet &operator=(const SparseMultiSet&); // DO NOT IMPLEMENT.
+
+  unsigned sparseIndex(const SMSNode &N) const { return ValIndexOf(N.Data); }
+
+  bool isHead(const SMSNode &N) const {
+    assert(!N.isTombstone() && "Invalid node for head");
+    return Dense[N.Prev].isTail();
+  }
+
+  /// addValue - Put Val in a free slot of Dense, and return its index.
+  unsigned addValue(const ValueT &Val, unsigned Prev, unsigned Next) {
+    if (NumFree == 0) {
+      Dense.push_back(SMSNode(Val, Prev, Next));
+      return Dense.size() - 1;
+    }
+    unsigned Idx = FreelistIdx;
+    FreelistIdx = Dense[Idx].Next;
+    --NumFree;
+    Dense[Idx] = SMSNode(Val, Prev, Next);
+    return Idx;
+  }
+
+  /// makeTombstone - Put the slot at Idx on the free list.
+  void makeTombstone(unsigned Idx) {
+    Dense[Idx].Prev = INVALID;
+    Dense[Idx].Next = FreelistIdx;
+    FreelistIdx = Idx;
+    ++NumFree;
+  }
+
+public:
+  typedef ValueT value_type;
+  typedef ValueT &reference;
+  typedef const ValueT &const_reference;
+  typedef ValueT *pointer;
+  typedef const ValueT *const_pointer;
+
+  SparseMultiSet()
+    : Sparse(0), Universe(0), FreelistIdx(INVALID), NumFree(0) {}
+  ~SparseMultiSet() { free(Sparse); }
+
+  /// setUniverse - Set the universe size which determines the largest key the
+  /// set can hold.  The universe must be sized before any elements can be
+  /// added.
+  ///
+  /// @param U Universe size. All object keys must be less than U.
+  ///
+  void setUniverse(unsigned U) {
+    assert(empty() && "Can only resize universe on an empty map");
+    // Hysteresis prevents needless reallocations.
+    if (U >= Universe/4 && U <= Universe)
+      return;
+    free(Sparse);
+    // The Sparse array doesn't actually need to be initialized, see
+    // SparseSet::setUniverse.
+    Sparse = reinterpret_cast<SparseT*>(calloc(U, sizeof(SparseT)));
+    Universe = U;
+  }
+
+  /// iterator_base - Iterates over the values sharing one key, in insertion
+  /// order.
+  template<typename SMSPtrTy, typename ValT>
+  class iterator_base : public std::iterator<std::forward_iterator_tag, ValT> {
+    friend class SparseMultiSet;
+    SMSPtrTy SMS;
+    unsigned Idx;
+
+    iterator_base(SMSPtrTy P, unsigned I) : SMS(P), Idx(I) {}
+
+  public:
+    iterator_base() : SMS(0), Idx(INVALID) {}
+
+    ValT &operator*() const {
+      assert(Idx < SMS->Dense.size() && !SMS->Dense[Idx].isTombstone() &&
+             "Dereferencing iterator of invalid key or index");
+      return SMS->Dense[Idx].Data;
+    }
+    ValT *operator->() const { return &operator*(); }
+
+    bool operator==(const iterator_base &RHS) const {
+      return Idx == RHS.Idx;
+    }
+    bool operator!=(const iterator_base &RHS) const {
+      return Idx != RHS.Idx;
+    }
+
+    iterator_base &operator++() {
+      assert(Idx != INVALID && "Incrementing past end");
+      Idx = SMS->Dense[Idx].Next;
+      return *this;
+    }
+    iterator_base operator++(int) {
+      iterator_base I(*this);
+      ++*this;
+      return I;
+    }
+  };
+
+  typedef iterator_base<SparseMultiSet*, ValueT> iterator;
+  typedef iterator_base<const SparseMultiSet*, const ValueT> const_iterator;
+
+  /// end - The end of every key's range.
+  iterator end() { return iterator(this, INVALID); }
+  const_iterator end() const { return const_iterator(this, INVALID); }
+
+  /// empty - Returns true if the set is empty.
+  bool empty() const { return size() == 0; }
+
+  /// size - Returns the number of elements in the set.
+  unsigned size() const {
+    assert(NumFree <= Dense.size() && "Out-of-bounds free entries");
+    return Dense.size() - NumFree;
+  }
+
+  /// clear - Clears the set.  This is a very fast constant time operation.
+  void clear() {
+    // Sparse does not need to be cleared, see find().
+    Dense.clear();
+    NumFree = 0;
+    FreelistIdx = INVALID;
+  }
+
+  /// findIndex - Find the first element with the given index.
+  ///
+  /// @param   Idx A valid index to find.
+  /// @returns An iterator to the first element identified by Idx, or end().
+  ///
+  iterator findIndex(unsigned Idx) {
+    assert(Idx < Universe && "Key out of range");
+    const unsigned Stride = std::numeric_limits<SparseT>::max() + 1u;
+    for (unsigned i = Sparse[Idx], e = Dense.size(); i < e; i += Stride) {
+      const SMSNode &N = Dense[i];
+      // Tombstones keep their stale data, so check for them first.
+      if (!N.isTombstone()) {
+        const unsigned FoundIdx = sparseIndex(N);
+        assert(FoundIdx < Universe && "Invalid key in set. Did object mutate?");
+        if (Idx == FoundIdx && isHead(N))
+          return iterator(this, i);
+      }
+      // Stride is 0 when SparseT >= unsigned.  We don't need to loop.
+      if (!Stride)
+        break;
+    }
+    return end();
+  }
+
+  /// find - Find the first element with the given key.
+  ///
+  /// @param   Key A valid key to find.
+  /// @returns An iterator to the first element identified by Key, or end().
+  ///
+  iterator find(const KeyT &Key) {
+    return findIndex(KeyIndexOf(Key));
+  }
+
+  const_iterator find(const KeyT &Key) const {
+    iterator I = const_cast<SparseMultiSet*>(this)->find(Key);
+    return const_iterator(this, I.Idx);
+  }
+
+  /// equal_range - The values with the given key.
+  std::pair<iterator, iterator> equal_range(const KeyT &K) {
+    return std::make_pair(find(K), end());
+  }
+
+  /// count - Returns the number of elements identified by Key.  This is
+  /// linear in the number of elements with that key.
+  unsigned count(const KeyT &Key) const {
+    unsigned Ret = 0;
+    for (const_iterator I = find(Key), E = end(); I != E; ++I)
+      ++Ret;
+    return Ret;
+  }
+
+  /// contains - Returns true if this set contains an element identified by
+  /// Key.
+  bool contains(const KeyT &Key) const {
+    return find(Key) != end();
+  }
+
+  /// insert - Add Val to the end of the list of values with the same key.
+  /// Unlike SparseSet::insert, this always succeeds.
+  ///
+  /// Insertion does not invalidate iterators.
+  ///
+  iterator insert(const ValueT &Val) {
+    unsigned Idx = ValIndexOf(Val);
+    iterator I = findIndex(Idx);
+    unsigned NodeIdx = addValue(Val, INVALID, INVALID);
+
+    if (I == end()) {
+      // Make a singleton list.
+      Sparse[Idx] = NodeIdx;
+      Dense[NodeIdx].Prev = NodeIdx;
+      return iterator(this, NodeIdx);
+    }
+
+    // Stick it at the end.
+    unsigned HeadIdx = I.Idx;
+    unsigned TailIdx = Dense[HeadIdx].Prev;
+    Dense[TailIdx].Next = NodeIdx;
+    Dense[HeadIdx].Prev = NodeIdx;
+    Dense[NodeIdx].Prev = TailIdx;
+    return iterator(this, NodeIdx);
+  }
+
+  /// erase - Erases an existing element identified by a valid iterator, and
+  /// returns an iterator to the next element with the same key.  Other
+  /// iterators remain valid.
+  ///
+  iterator erase(iterator I) {
+    assert(I.Idx < Dense.size() && !Dense[I.Idx].isTombstone() &&
+           "Invalid iterator");
+    unsigned Idx = I.Idx;
+    SMSNode &N = Dense[Idx];
+    unsigned Next = N.Next;
+
+    if (isHead(N)) {
+      if (!N.isTail()) {
+        // The next node becomes the head, keeping the link to the tail.
+        Dense[Next].Prev = N.Prev;
+        Sparse[sparseIndex(N)] = Next;
+      }
+    } else {
+      if (N.isTail()) {
+        // The head's Prev points at the tail; move it back one.  Find the
+        // head before unlinking N, or N would look like a head itself.
+        iterator Head = findIndex(sparseIndex(N));
+        Dense[Head.Idx].Prev = N.Prev;
+      } else {
+        Dense[Next].Prev = N.Prev;
+      }
+      Dense[N.Prev].Next = Next;
+    }
+
+    makeTombstone(Idx);
+    return iterator(this, Next);
+  }
+
+  /// eraseAll - Erase all elements with the given key.
+  void eraseAll(const KeyT &K) {
+    for (iterator I = find(K); I != end(); /* empty */)
+      I = erase(I);
+  }
+};
+
+} // end namespace llvm
+
+#endif
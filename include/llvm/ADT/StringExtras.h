@@ -153,17 +153,38 @@ void SplitString(StringRef Source,
                  SmallVectorImpl<StringRef> &OutFragments,
                  StringRef Delimiters = " \t\n\v\f\r");
 
-/// HashString - Hash funtion for strings.
+/// HashString - Hash function for strings, seeded with Result.
 ///
-/// This is the Bernstein hash function.
-//
-// FIXME: Investigate whether a modified bernstein hash function performs
-// better: http://eternallyconfuzzled.com/tuts/algorithms/jsw_tut_hashing.aspx
-//   X*33+c -> X*33^c
+/// This is MurmurHash2, which mixes in four characters per multiplication and
+/// spreads similar strings (such as names differing in a numeric suffix) over
+/// all the bits of the hash.  Words are put together from the characters one
+/// by one, so the hash does not depend on the host's byte order or on whether
+/// char is signed, and tables keyed by strings iterate in the same order on
+/// every host.
 static inline unsigned HashString(StringRef Str, unsigned Result = 0) {
-  for (unsigned i = 0, e = Str.size(); i != e; ++i)
-    Result = Result * 33 + Str[i];
-  return Result;
+  const uint32_t M = 0x5bd1e995;
+  const unsigned char *P = reinterpret_cast<const unsigned char*>(Str.data());
+  size_t Len = Str.size();
+  uint32_t H = Result ^ (uint32_t)Len;
+  for (; Len >= 4; P += 4, Len -= 4) {
+    uint32_t K = P[0] | (P[1] << 8) | (P[2] << 16) | ((uint32_t)P[3] << 24);
+    K *= M;
+    K ^= K >> 24;
+    K *= M;
+    H = (H * M) ^ K;
+  }
+  switch (Len) {
+  case 3: H ^= P[2] << 16;
+    // FALLTHROUGH
+  case 2: H ^= P[1] << 8;
+    // FALLTHROUGH
+  case 1: H ^= P[0];
+          H *= M;
+  }
+  H ^= H >> 13;
+  H *= M;
+  H ^= H >> 15;
+  return H;
 }
 
 } // End llvm namespace
@@ -24,6 +24,8 @@
 namespace llvm {
 
   class Value;
+  class Argument;
+  class Constant;
   class Function;
   class BasicBlock;
   class CallSite;
@@ -97,8 +99,18 @@ namespace llvm {
       unsigned ConstantWeight;
       unsigned AllocaWeight;
 
+      /// ConstantBonus - The per-call bonus CountBonusForConstant computes
+      /// when a constant is passed for this argument.  It does not depend on
+      /// the constant unless the argument reaches the callee operand of a
+      /// call (CalledThrough), in which case it has to be recomputed for
+      /// every call site.  Filled in lazily, valid if ConstantBonusKnown.
+      int ConstantBonus;
+      bool ConstantBonusKnown;
+      bool CalledThrough;
+
       ArgInfo(unsigned CWeight, unsigned AWeight)
-        : ConstantWeight(CWeight), AllocaWeight(AWeight)
+        : ConstantWeight(CWeight), AllocaWeight(AWeight),
+          ConstantBonus(0), ConstantBonusKnown(false), CalledThrough(false)
           {}
     };
 
@@ -124,7 +136,10 @@ namespace llvm {
     // the ValueMap will update itself when this happens.
     ValueMap<const Function *, FunctionInfo> CachedFunctionInfo;
 
-    int CountBonusForConstant(Value *V, Constant *C = NULL);
+    int CountBonusForConstant(Value *V, Constant *C = NULL,
+                              bool *CalledThrough = NULL);
+    int getConstantArgBonus(Function *Callee, unsigned ArgNo, Argument *Arg,
+                            Constant *C);
     int ConstantFunctionBonus(CallSite CS, Constant *C);
     int getInlineSize(CallSite CS, Function *Callee);
     int getInlineBonuses(CallSite CS, Function *Callee);
@@ -68,15 +68,36 @@ namespace llvm {
     unsigned short SubclassData;
 
   private:
+    /// ExpressionSize - The number of nodes in the expression tree rooted at
+    /// this node, saturating at the largest unsigned short.
+    const unsigned short ExpressionSize;
+
     SCEV(const SCEV &);            // DO NOT IMPLEMENT
     void operator=(const SCEV &);  // DO NOT IMPLEMENT
 
   public:
-    explicit SCEV(const FoldingSetNodeIDRef ID, unsigned SCEVTy) :
-      FastID(ID), SCEVType(SCEVTy), SubclassData(0) {}
+    explicit SCEV(const FoldingSetNodeIDRef ID, unsigned SCEVTy,
+                  unsigned ExprSize = 1) :
+      FastID(ID), SCEVType(SCEVTy), SubclassData(0),
+      ExpressionSize(ExprSize > 0xFFFF ? 0xFFFF : ExprSize) {}
 
     unsigned getSCEVType() const { return SCEVType; }
 
+    /// getExpressionSize - Return the number of nodes in the expression tree
+    /// of this SCEV, counting a shared subexpression once for each use.  This
+    /// is a cheap measure of how expensive the expression is to work with.
+    unsigned short getExpressionSize() const { return ExpressionSize; }
+
+    /// computeExpressionSize - Return the ExpressionSize of a node with the
+    /// given operands.
+    static unsigned computeExpressionSize(const SCEV *const *Ops,
+                                          size_t NumOps) {
+      unsigned Size = 1;
+      for (size_t i = 0; i != NumOps && Size < 0xFFFF; ++i)
+        Size += Ops[i]->getExpressionSize();
+      return Size;
+    }
+
     /// getType - Return the LLVM type of this SCEV expression.
     ///
     const Type *getType() const;
@@ -738,6 +759,14 @@ namespace llvm {
     FoldingSet<SCEV> UniqueSCEVs;
     BumpPtrAllocator SCEVAllocator;
 
+  public:
+    /// getMemoryUsage - Return the number of bytes held by the SCEV arena,
+    /// which owns every SCEV node and operand array created for the current
+    /// function.
+    size_t getMemoryUsage() const { return SCEVAllocator.getTotalMemory(); }
+
+  private:
+
     /// FirstUnknown - The head of a linked list of all SCEVUnknown
     /// values that have been allocated. This is used by releaseMemory
     /// to locate them all and call their destructors.
@@ -145,7 +145,8 @@ namespace llvm {
 
     SCEVNAryExpr(const FoldingSetNodeIDRef ID,
                  enum SCEVTypes T, const SCEV *const *O, size_t N)
-      : SCEV(ID, T), Operands(O), NumOperands(N) {}
+      : SCEV(ID, T, computeExpressionSize(O, N)), Operands(O),
+        NumOperands(N) {}
 
   public:
     size_t getNumOperands() const { return NumOperands; }
@@ -257,7 +258,9 @@ namespace llvm {
     const SCEV *LHS;
     const SCEV *RHS;
     SCEVUDivExpr(const FoldingSetNodeIDRef ID, const SCEV *lhs, const SCEV *rhs)
-      : SCEV(ID, scUDivExpr), LHS(lhs), RHS(rhs) {}
+      : SCEV(ID, scUDivExpr,
+             1 + lhs->getExpressionSize() + rhs->getExpressionSize()),
+        LHS(lhs), RHS(rhs) {}
 
   public:
     const SCEV *getLHS() const { return LHS; }
@@ -17,13 +17,31 @@
 
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Bitcode/BitCodes.h"
+#include "llvm/Support/raw_ostream.h"
 #include <vector>
 
 namespace llvm {
 
 class BitstreamWriter {
+  /// Out - The bytes of the stream that have not been written to FS yet.
   std::vector<unsigned char> &Out;
 
+  /// FS - If non-null, completed blocks are written out to this stream once
+  /// Out reaches FlushThreshold bytes, so that the whole bitstream is never
+  /// held in memory.  Size fields of blocks that were already written out are
+  /// backpatched by seeking, so FS must support seeking.
+  raw_fd_ostream *FS;
+
+  /// FSStartPos - The offset in FS at which the bitstream starts.
+  uint64_t FSStartPos;
+
+  /// FlushedBytes - The number of bytes of the bitstream written to FS.
+  uint64_t FlushedBytes;
+
+  /// FlushThreshold - How many bytes Out may hold before the blocks in it are
+  /// written out to FS.
+  unsigned FlushThreshold;
+
   /// CurBit - Always between 0 and 31 inclusive, specifies the next bit to use.
   unsigned CurBit;
 
@@ -43,9 +61,9 @@ class BitstreamWriter {
 
   struct Block {
     unsigned PrevCodeSize;
-    unsigned StartSizeWord;
+    uint64_t StartSizeWord;
     std::vector<BitCodeAbbrev*> PrevAbbrevs;
-    Block(unsigned PCS, unsigned SSW) : PrevCodeSize(PCS), StartSizeWord(SSW) {}
+    Block(unsigned PCS, uint64_t SSW) : PrevCodeSize(PCS), StartSizeWord(SSW) {}
   };
 
   /// BlockScope - This tracks the current blocks that we have entered.
@@ -60,8 +78,12 @@ class BitstreamWriter {
   std::vector<BlockInfo> BlockInfoRecords;
 
 public:
-  explicit BitstreamWriter(std::vector<unsigned char> &O)
-    : Out(O), CurBit(0), CurValue(0), CurCodeSize(2) {}
+  explicit BitstreamWriter(std::vector<unsigned char> &O,
+                           raw_fd_ostream *fs = 0,
+                           unsigned flushThreshold = 1024 * 1024)
+    : Out(O), FS(fs), FSStartPos(fs ? fs->tell() : 0), FlushedBytes(0),
+      FlushThreshold(flushThreshold), CurBit(0), CurValue(0),
+      CurCodeSize(2) {}
 
   ~BitstreamWriter() {
     assert(CurBit == 0 && "Unflused data remaining");
@@ -80,8 +102,45 @@ public:
 
   std::vector<unsigned char> &getBuffer() { return Out; }
 
+  /// CopyBlockInfoFrom - Give this writer its own copies of the BLOCKINFO
+  /// abbrevs that have been emitted to Other, so that blocks using them can be
+  /// encoded here without touching the reference counts of Other's abbrevs.
+  void CopyBlockInfoFrom(const BitstreamWriter &Other) {
+    assert(BlockInfoRecords.empty() && "Already have blockinfo");
+    BlockInfoRecords.resize(Other.BlockInfoRecords.size());
+    for (unsigned i = 0, e = static_cast<unsigned>(BlockInfoRecords.size());
+         i != e; ++i) {
+      const BlockInfo &From = Other.BlockInfoRecords[i];
+      BlockInfo &To = BlockInfoRecords[i];
+      To.BlockID = From.BlockID;
+      for (unsigned j = 0, je = static_cast<unsigned>(From.Abbrevs.size());
+           j != je; ++j) {
+        BitCodeAbbrev *Abbv = new BitCodeAbbrev();
+        for (unsigned k = 0, ke = From.Abbrevs[j]->getNumOperandInfos();
+             k != ke; ++k)
+          Abbv->Add(From.Abbrevs[j]->getOperandInfo(k));
+        To.Abbrevs.push_back(Abbv);
+      }
+    }
+  }
+
   /// \brief Retrieve the current position in the stream, in bits.
-  uint64_t GetCurrentBitNo() const { return Out.size() * 8 + CurBit; }
+  uint64_t GetCurrentBitNo() const { return GetBufferOffset() * 8 + CurBit; }
+
+  /// GetBufferOffset - Return the number of whole bytes emitted so far,
+  /// including those already written out to the file stream.
+  uint64_t GetBufferOffset() const { return FlushedBytes + Out.size(); }
+
+  /// FlushToFile - Write the buffered bytes out to the file stream, if there
+  /// is one.  This is only valid at a word boundary.
+  void FlushToFile() {
+    if (!FS || Out.empty())
+      return;
+    assert((Out.size() & 3) == 0 && "Not 32-bit aligned");
+    FS->write((char*)&Out.front(), Out.size());
+    FlushedBytes += Out.size();
+    Out.clear();
+  }
 
   //===--------------------------------------------------------------------===//
   // Basic Primitives for emitting bits to the stream.
@@ -132,11 +191,12 @@ public:
   }
 
   void EmitVBR(uint32_t Val, unsigned NumBits) {
+    assert(NumBits >= 2 && NumBits <= 32 && "Invalid VBR chunk size!");
     uint32_t Threshold = 1U << (NumBits-1);
 
     // Emit the bits with VBR encoding, NumBits-1 bits at a time.
     while (Val >= Threshold) {
-      Emit((Val & ((1 << (NumBits-1))-1)) | (1 << (NumBits-1)), NumBits);
+      Emit((Val & (Threshold-1)) | Threshold, NumBits);
       Val >>= NumBits-1;
     }
 
@@ -147,12 +207,12 @@ public:
     if ((uint32_t)Val == Val)
       return EmitVBR((uint32_t)Val, NumBits);
 
-    uint64_t Threshold = 1U << (NumBits-1);
+    assert(NumBits >= 2 && NumBits <= 32 && "Invalid VBR chunk size!");
+    uint64_t Threshold = uint64_t(1) << (NumBits-1);
 
     // Emit the bits with VBR encoding, NumBits-1 bits at a time.
     while (Val >= Threshold) {
-      Emit(((uint32_t)Val & ((1 << (NumBits-1))-1)) |
-           (1 << (NumBits-1)), NumBits);
+      Emit((uint32_t)((Val & (Threshold-1)) | Threshold), NumBits);
       Val >>= NumBits-1;
     }
 
@@ -165,8 +225,23 @@ public:
   }
 
   // BackpatchWord - Backpatch a 32-bit word in the output with the specified
-  // value.
-  void BackpatchWord(unsigned ByteNo, unsigned NewWord) {
+  // value.  ByteNo is an offset from the start of the bitstream, which may be
+  // past 4GB when blocks are streamed out to a file.
+  void BackpatchWord(uint64_t ByteNo, unsigned NewWord) {
+    if (ByteNo < FlushedBytes) {
+      // The word has already been written out; patch it in the file.
+      char Bytes[4] = {
+        (char)(NewWord >>  0), (char)(NewWord >>  8),
+        (char)(NewWord >> 16), (char)(NewWord >> 24)
+      };
+      uint64_t EndPos = FS->tell();
+      FS->seek(FSStartPos + ByteNo);
+      FS->write(Bytes, 4);
+      FS->seek(EndPos);
+      return;
+    }
+
+    ByteNo -= FlushedBytes;
     Out[ByteNo++] = (unsigned char)(NewWord >>  0);
     Out[ByteNo++] = (unsigned char)(NewWord >>  8);
     Out[ByteNo++] = (unsigned char)(NewWord >> 16);
@@ -199,7 +274,7 @@ public:
     EmitVBR(CodeLen, bitc::CodeLenWidth);
     FlushToWord();
 
-    unsigned BlockSizeWordLoc = static_cast<unsigned>(Out.size());
+    uint64_t BlockSizeWordLoc = GetBufferOffset();
     unsigned OldCodeSize = CurCodeSize;
 
     // Emit a placeholder, which will be replaced when the block is popped.
@@ -239,8 +314,9 @@ public:
     FlushToWord();
 
     // Compute the size of the block, in words, not counting the size field.
-    unsigned SizeInWords= static_cast<unsigned>(Out.size())/4-B.StartSizeWord-1;
-    unsigned ByteNo = B.StartSizeWord*4;
+    unsigned SizeInWords =
+      static_cast<unsigned>(GetBufferOffset()/4-B.StartSizeWord-1);
+    uint64_t ByteNo = B.StartSizeWord*4;
 
     // Update the block size field in the header of this sub-block.
     BackpatchWord(ByteNo, SizeInWords);
@@ -249,8 +325,54 @@ public:
     CurCodeSize = B.PrevCodeSize;
     BlockScope.back().PrevAbbrevs.swap(CurAbbrevs);
     BlockScope.pop_back();
+
+    // The block is complete; write it out if enough has been buffered.
+    if (Out.size() >= FlushThreshold)
+      FlushToFile();
   }
 
+  /// EmitEncodedSubblock - Emit a block that was encoded on its own into
+  /// Block by another BitstreamWriter, which started out empty and emitted
+  /// just EnterSubblock(BlockID, CodeLen), the block contents and ExitBlock().
+  /// Everything after the block's size word starts on a word boundary and does
+  /// not depend on where the block sits in the stream, so only the header has
+  /// to be re-encoded for this stream.
+  void EmitEncodedSubblock(unsigned BlockID, unsigned CodeLen,
+                           const std::vector<unsigned char> &Block) {
+    // The header in Block was emitted with the initial 2-bit abbrev width.
+    unsigned HeaderBits = 2 + GetVBRSize(BlockID, bitc::BlockIDWidth) +
+                          GetVBRSize(CodeLen, bitc::CodeLenWidth);
+    unsigned SizeWordByte = (HeaderBits+31)/32*4;
+    unsigned SizeInWords = static_cast<unsigned>(Block.size())/4 -
+                           SizeWordByte/4 - 1;
+    assert((Block.size() & 3) == 0 && "Not 32-bit aligned");
+    assert((Block[SizeWordByte] | (Block[SizeWordByte+1] << 8) |
+            (Block[SizeWordByte+2] << 16) |
+            ((unsigned)Block[SizeWordByte+3] << 24)) == SizeInWords &&
+           "Block was not encoded by itself");
+
+    EmitCode(bitc::ENTER_SUBBLOCK);
+    EmitVBR(BlockID, bitc::BlockIDWidth);
+    EmitVBR(CodeLen, bitc::CodeLenWidth);
+    FlushToWord();
+    Emit(SizeInWords, bitc::BlockSizeWidth);
+    Out.insert(Out.end(), Block.begin() + SizeWordByte + 4, Block.end());
+
+    if (Out.size() >= FlushThreshold)
+      FlushToFile();
+  }
+
+private:
+  /// GetVBRSize - Return the number of bits EmitVBR uses to emit Val.
+  static unsigned GetVBRSize(uint32_t Val, unsigned NumBits) {
+    uint32_t Threshold = 1U << (NumBits-1);
+    unsigned Size = NumBits;
+    for (; Val >= Threshold; Val >>= NumBits-1)
+      Size += NumBits;
+    return Size;
+  }
+
+public:
   //===--------------------------------------------------------------------===//
   // Record Emission
   //===--------------------------------------------------------------------===//
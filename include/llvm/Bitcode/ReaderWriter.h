@@ -14,6 +14,8 @@
 #ifndef LLVM_BITCODE_H
 #define LLVM_BITCODE_H
 
+#include "llvm/Support/DataTypes.h"
+#include <map>
 #include <string>
 
 namespace llvm {
@@ -23,6 +25,7 @@ namespace llvm {
   class BitstreamWriter;
   class LLVMContext;
   class raw_ostream;
+  class raw_fd_ostream;
   
   /// getLazyBitcodeModule - Read the header of the specified bitcode buffer
   /// and prepare for lazy deserialization of function bodies.  If successful,
@@ -48,11 +51,46 @@ namespace llvm {
   Module *ParseBitcodeFile(MemoryBuffer *Buffer, LLVMContext& Context,
                            std::string *ErrMsg = 0);
 
+  /// BitcodeReadProfile - Where the bitcode reader spent its time, as
+  /// measured by ProfileBitcodeFile.
+  struct BitcodeReadProfile {
+    struct Entry {
+      /// Count - The number of blocks or records read.
+      uint64_t Count;
+      /// NumAbbreviated - The number of records that used an abbreviation.
+      uint64_t NumAbbreviated;
+      /// Microseconds - The time spent reading and handling them.  For
+      /// blocks, this does not include the time spent in nested blocks.
+      uint64_t Microseconds;
+
+      Entry() : Count(0), NumAbbreviated(0), Microseconds(0) {}
+    };
+
+    /// Blocks - The time spent on each block ID.
+    std::map<unsigned, Entry> Blocks;
+
+    /// Records - The time spent on each record code, indexed by block ID and
+    /// record code.
+    std::map<std::pair<unsigned, unsigned>, Entry> Records;
+  };
+
+  /// ProfileBitcodeFile - Read the specified bitcode file like
+  /// ParseBitcodeFile, adding the time spent on each block and record to
+  /// Profile.  This method *never* takes ownership of Buffer.
+  Module *ProfileBitcodeFile(MemoryBuffer *Buffer, LLVMContext& Context,
+                             BitcodeReadProfile &Profile,
+                             std::string *ErrMsg = 0);
+
   /// WriteBitcodeToFile - Write the specified module to the specified
   /// raw output stream.  For streams where it matters, the given stream
   /// should be in "binary" mode.
   void WriteBitcodeToFile(const Module *M, raw_ostream &Out);
 
+  /// WriteBitcodeToFile - Write the specified module to the specified file
+  /// stream.  If the stream supports seeking, completed blocks are written
+  /// out as they are finished instead of building the whole file in memory.
+  void WriteBitcodeToFile(const Module *M, raw_fd_ostream &Out);
+
   /// WriteBitcodeToStream - Write the specified module to the specified
   /// raw output stream.
   void WriteBitcodeToStream(const Module *M, BitstreamWriter &Stream);
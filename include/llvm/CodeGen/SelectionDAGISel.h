@@ -266,12 +266,114 @@ public:
                            const unsigned char *MatcherTable,
                            unsigned TableSize);
 
+  /// MatchState - Everything a pattern match has recorded about the node
+  /// being selected.  This is shared by the matcher table interpreter and the
+  /// direct-dispatch selectors tblgen emits with -dag-isel-direct-dispatch.
+  struct MatchState {
+    SDNode *NodeToMatch;
+
+    /// RecordedNodes - The nodes recorded by the matcher.  The second value is
+    /// the parent of the node, or null if the root is recorded.
+    SmallVector<std::pair<SDValue, SDNode*>, 8> RecordedNodes;
+
+    /// MatchedMemRefs - The MemRefs seen in the input pattern.
+    SmallVector<MachineMemOperand*, 2> MatchedMemRefs;
+
+    /// InputChain/InputGlue - The current chain and glue for use when
+    /// generating nodes.  Various Emit operations change these.
+    SDValue InputChain, InputGlue;
+
+    /// ChainNodesMatched - The matched nodes with input/output chains, whose
+    /// chain results are updated when the pattern is complete.
+    SmallVector<SDNode*, 3> ChainNodesMatched;
+    SmallVector<SDNode*, 3> GlueResultNodesMatched;
+
+    explicit MatchState(SDNode *N) : NodeToMatch(N) {}
+
+    void record(SDValue V, SDNode *Parent) {
+      RecordedNodes.push_back(std::make_pair(V, Parent));
+    }
+
+    /// Checkpoint - The part of a MatchState that has to be restored when one
+    /// alternative of a scope fails and the next one is tried.
+    struct Checkpoint {
+      unsigned NumRecordedNodes, NumMatchedMemRefs;
+      SDValue InputChain, InputGlue;
+      bool HasChainNodesMatched, HasGlueResultNodesMatched;
+
+      explicit Checkpoint(const MatchState &S)
+        : NumRecordedNodes(S.RecordedNodes.size()),
+          NumMatchedMemRefs(S.MatchedMemRefs.size()),
+          InputChain(S.InputChain), InputGlue(S.InputGlue),
+          HasChainNodesMatched(!S.ChainNodesMatched.empty()),
+          HasGlueResultNodesMatched(!S.GlueResultNodesMatched.empty()) {}
+    };
+
+    void rollback(const Checkpoint &CP) {
+      RecordedNodes.resize(CP.NumRecordedNodes);
+      if (CP.NumMatchedMemRefs != MatchedMemRefs.size())
+        MatchedMemRefs.resize(CP.NumMatchedMemRefs);
+      InputChain = CP.InputChain;
+      InputGlue = CP.InputGlue;
+      if (!CP.HasChainNodesMatched)
+        ChainNodesMatched.clear();
+      if (!CP.HasGlueResultNodesMatched)
+        GlueResultNodesMatched.clear();
+    }
+  };
+
+  // The matcher operations below that do more than a simple check are shared
+  // by SelectCodeCommon and the code tblgen emits with
+  // -dag-isel-direct-dispatch.
+
+  /// useMatcherTable - Return true if a selector built with
+  /// -dag-isel-direct-dispatch should run its matcher table instead
+  /// (-use-isel-matcher-table), so that the two can be compared.
+  static bool useMatcherTable();
+
+  /// SelectSpecialNode - Select the nodes that never go through the target's
+  /// patterns.  Returns true, with the result of the selection in Result, if
+  /// NodeToMatch is one of them.
+  bool SelectSpecialNode(SDNode *NodeToMatch, SDNode *&Result);
+
+  /// CaptureGlueInput - Implements OPC_CaptureGlueInput.
+  void CaptureGlueInput(MatchState &S, SDValue N);
+
+  /// IsFoldableChainNode - Implements OPC_CheckFoldableChainNode for N, given
+  /// the node stack from the root (NodeStack[0]) down to N.
+  bool IsFoldableChainNode(MatchState &S, const SDValue *NodeStack,
+                           unsigned StackSize);
+
+  /// EmitConvertToTarget - Implements OPC_EmitConvertToTarget.
+  void EmitConvertToTarget(MatchState &S, unsigned RecNo);
+
+  /// EmitMergeInputChains - Implements OPC_EmitMergeInputChains.  Returns
+  /// false if the chains cannot be merged, in which case the match fails.
+  bool EmitMergeInputChains(MatchState &S, const unsigned *RecNos,
+                            unsigned NumRecNos);
+
+  /// EmitCopyToReg - Implements OPC_EmitCopyToReg.
+  void EmitCopyToReg(MatchState &S, SDValue Val, unsigned DestPhysReg);
+
+  /// EmitMatchedNode - Implements OPC_EmitNode, and OPC_MorphNodeTo if
+  /// IsMorphNodeTo is set, in which case the match is complete.
+  SDNode *EmitMatchedNode(MatchState &S, bool IsMorphNodeTo, unsigned TargetOpc,
+                          unsigned EmitNodeInfo,
+                          const MVT::SimpleValueType *VTs, unsigned NumVTs,
+                          const SDValue *Operands, unsigned NumOperands);
+
+  /// CompleteMatch - Implements OPC_CompleteMatch.
+  void CompleteMatch(MatchState &S, const SDValue *Results,
+                     unsigned NumResults);
+
+protected:
+  void CannotYetSelect(SDNode *N);
+
 private:
 
   // Calls to these functions are generated by tblgen.
   SDNode *Select_INLINEASM(SDNode *N);
   SDNode *Select_UNDEF(SDNode *N);
-  void CannotYetSelect(SDNode *N);
 
 private:
   void DoInstructionSelection();
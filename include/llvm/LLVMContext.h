@@ -49,6 +49,16 @@ public:
   /// getMDKindNames - Populate client supplied SmallVector with the name for
   /// custom metadata IDs registered in this LLVMContext.
   void getMDKindNames(SmallVectorImpl<StringRef> &Result) const;
+
+  /// setDiscardValueNames - Control whether names given to local values
+  /// (instructions, arguments and basic blocks) are kept.  Clients that never
+  /// look at them, like the JIT, can turn this on to skip the symbol table
+  /// work when creating and reading IR.  Global values always keep their
+  /// names, as does IR parsed from assembly.
+  void setDiscardValueNames(bool Discard);
+
+  /// shouldDiscardValueNames - Return true if local value names are dropped.
+  bool shouldDiscardValueNames() const;
   
   
   typedef void (*InlineAsmDiagHandlerTy)(const SMDiagnostic&, void *Context,
@@ -58,6 +58,13 @@ class Linker {
       QuietErrors   = 4  ///< Don't print errors to stderr.
     };
 
+    /// This enumeration selects which function bodies LinkModules copies from
+    /// the source module.
+    enum LinkerMode {
+      LinkAllBodies = 0,       ///< Link every function body (the default)
+      LinkReferencedBodies = 1 ///< Skip bodies nothing in Dest can reach
+    };
+
   /// @}
   /// @name Constructors
   /// @{
@@ -259,7 +266,22 @@ class Linker {
     /// error.
     /// @returns True if an error occurs, false otherwise.
     /// @brief Generically link two modules together.
-    static bool LinkModules(Module* Dest, Module* Src, std::string* ErrorMsg);
+    static bool LinkModules(Module* Dest, Module* Src, std::string* ErrorMsg) {
+      return LinkModules(Dest, Src, LinkAllBodies, ErrorMsg);
+    }
+
+    /// This is the same as LinkModules above, with \p Mode selecting which
+    /// function bodies are copied.  With LinkReferencedBodies, the bodies of
+    /// source functions with internal, private or available_externally
+    /// linkage are only linked if they are referenced, directly or through
+    /// other linked bodies, from something that is kept in \p Dest.  The
+    /// unreferenced ones are dropped instead of being copied in and left for
+    /// GlobalDCE.  Functions that other modules could still refer to are
+    /// always linked.
+    /// @returns True if an error occurs, false otherwise.
+    /// @brief Link two modules together, optionally skipping dead bodies.
+    static bool LinkModules(Module* Dest, Module* Src, unsigned Mode,
+                            std::string* ErrorMsg);
 
     /// This function looks through the Linker's LibPaths to find a library with
     /// the name \p Filename. If the library cannot be found, the returned path
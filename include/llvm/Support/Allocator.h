@@ -83,6 +83,20 @@ public:
   virtual void Deallocate(MemSlab *Slab);
 };
 
+/// MmapSlabAllocator - A slab allocator that maps its slabs straight from the
+/// operating system with sys::Memory, rounding them up to whole pages.  If
+/// HugePages is set, slabs are rounded up to whole huge pages and backed by
+/// them where the system allows, which cuts TLB misses for big arenas.
+class MmapSlabAllocator : public SlabAllocator {
+  bool HugePages;
+
+public:
+  explicit MmapSlabAllocator(bool hugePages = false) : HugePages(hugePages) { }
+  virtual ~MmapSlabAllocator();
+  virtual MemSlab *Allocate(size_t Size);
+  virtual void Deallocate(MemSlab *Slab);
+};
+
 /// BumpPtrAllocator - This allocator is useful for containers that need
 /// very simple memory allocation strategies.  In particular, this just keeps
 /// allocating memory, and never deletes it until the entire block is dead. This
@@ -136,6 +150,7 @@ class BumpPtrAllocator {
   static MallocSlabAllocator DefaultSlabAllocator;
 
   template<typename T> friend class SpecificBumpPtrAllocator;
+  friend class ConcurrentBumpPtrAllocator;
 public:
   BumpPtrAllocator(size_t size = 4096, size_t threshold = 4096,
                    SlabAllocator &allocator = DefaultSlabAllocator);
@@ -176,6 +191,10 @@ public:
 
   unsigned GetNumSlabs() const;
 
+  /// getTotalMemory - Compute the total physical memory allocated by this
+  /// allocator.
+  size_t getTotalMemory() const;
+
   void PrintStats() const;
 };
 
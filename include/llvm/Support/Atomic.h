@@ -20,6 +20,10 @@ namespace llvm {
   namespace sys {
     void MemoryFence();
 
+    /// ThreadYield - Let other threads run before this one carries on, for
+    /// spin loops that may be waiting on a thread that was preempted.
+    void ThreadYield();
+
 #ifdef _MSC_VER
     typedef long cas_flag;
 #else
@@ -0,0 +1,138 @@
+//===- ConcurrentBumpPtrAllocator.h - Thread-safe bump allocator *- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the ConcurrentBumpPtrAllocator interface, a bump pointer
+// allocator that many threads can allocate from at once.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SUPPORT_CONCURRENTBUMPPTRALLOCATOR_H
+#define LLVM_SUPPORT_CONCURRENTBUMPPTRALLOCATOR_H
+
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/Mutex.h"
+#include <vector>
+
+namespace llvm {
+
+/// ConcurrentBumpPtrAllocator - A bump pointer allocator that many threads
+/// can allocate from at once.  Each thread bumps a pointer through a region
+/// of a slab of its own, so allocating takes no lock; only starting a new
+/// slab does.  As with BumpPtrAllocator, memory is only freed all at once.
+///
+/// Threads find their region through a small cache of their own, shared by
+/// all ConcurrentBumpPtrAllocators, so creating an allocator does not use up
+/// a thread-local storage key.  The cache has eight entries, picked by the
+/// order allocators were created in: a thread that keeps switching between
+/// two allocators created a multiple of eight apart takes the allocator's lock
+/// on every switch.  The caches are freed by llvm_shutdown, so no thread may be
+/// allocating when it runs.
+class ConcurrentBumpPtrAllocator {
+  // do not implement
+  ConcurrentBumpPtrAllocator(const ConcurrentBumpPtrAllocator &);
+  void operator=(const ConcurrentBumpPtrAllocator &);
+
+  /// Region - The part of a slab that one thread is allocating into.
+  struct Region {
+    char *CurPtr;
+    char *End;
+    size_t BytesAllocated;
+
+    /// Owner - The cache of the thread that allocates into this region.
+    const void *Owner;
+  };
+
+  /// ThreadCache - The regions a thread allocated from most recently, keyed
+  /// by allocator ID.
+  struct ThreadCache;
+
+  /// ID - Identifies this allocator in thread caches.  IDs are not reused,
+  /// so a cache entry for a destroyed allocator is never mistaken for one
+  /// created later at the same address.
+  unsigned ID;
+
+  /// SlabSize - Allocate data into slabs of this size unless we get an
+  /// allocation above SizeThreshold.
+  size_t SlabSize;
+
+  /// SizeThreshold - For any allocation larger than this threshold, we should
+  /// allocate a separate slab.
+  size_t SizeThreshold;
+
+  /// Allocator - The underlying allocator we use to get slabs of memory.
+  SlabAllocator &Allocator;
+
+  /// Lock - Guards the fields below.
+  mutable sys::Mutex Lock;
+
+  /// Regions - The regions of all threads that have allocated.
+  std::vector<Region*> Regions;
+
+  /// Slabs - The slabs of SlabSize bytes handed out to regions.
+  MemSlab *Slabs;
+
+  /// BigSlabs - The slabs allocated for single allocations above
+  /// SizeThreshold.
+  MemSlab *BigSlabs;
+
+  /// FreeSlabs - Slabs of SlabSize bytes kept by Reset for reuse.
+  MemSlab *FreeSlabs;
+
+  Region *GetRegion();
+  Region *FindRegion();
+  void *AllocateSlow(Region *R, size_t Size, size_t Alignment);
+  void DeallocateSlabs(MemSlab *Slab);
+
+public:
+  ConcurrentBumpPtrAllocator(size_t size = 65536, size_t threshold = 65536,
+             SlabAllocator &allocator = BumpPtrAllocator::DefaultSlabAllocator);
+  ~ConcurrentBumpPtrAllocator();
+
+  /// Reset - Free all memory allocated so far, keeping the slabs for reuse.
+  /// No other thread may be using the allocator while this runs.
+  void Reset();
+
+  /// Allocate - Allocate space at the specified alignment.  This may be
+  /// called from any number of threads at once.
+  void *Allocate(size_t Size, size_t Alignment);
+
+  /// Allocate space, but do not construct, one object.
+  ///
+  template <typename T>
+  T *Allocate() {
+    return static_cast<T*>(Allocate(sizeof(T),AlignOf<T>::Alignment));
+  }
+
+  /// Allocate space for an array of objects.  This does not construct the
+  /// objects though.
+  template <typename T>
+  T *Allocate(size_t Num) {
+    return static_cast<T*>(Allocate(Num * sizeof(T), AlignOf<T>::Alignment));
+  }
+
+  void Deallocate(const void * /*Ptr*/) {}
+
+  /// GetNumSlabs - Return the number of slabs in use, not counting those
+  /// kept for reuse by Reset.
+  unsigned GetNumSlabs() const;
+
+  /// getTotalMemory - Compute the total physical memory allocated by this
+  /// allocator, including slabs kept for reuse.
+  size_t getTotalMemory() const;
+
+  /// getBytesAllocated - Return the number of bytes asked for since the last
+  /// Reset.  While other threads are allocating, this is only approximate.
+  size_t getBytesAllocated() const;
+
+  void PrintStats() const;
+};
+
+}  // end namespace llvm
+
+#endif // LLVM_SUPPORT_CONCURRENTBUMPPTRALLOCATOR_H
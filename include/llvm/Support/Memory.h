@@ -66,6 +66,27 @@ namespace sys {
     /// @brief Release Read/Write/Execute memory.
     static bool ReleaseRWX(MemoryBlock &block, std::string *ErrMsg = 0);
 
+    /// This method allocates a block of Read/Write memory straight from the
+    /// operating system, for allocators that carve up big blocks themselves.
+    /// If \p HugePages is true and the system supports it, the block is
+    /// rounded up to a multiple of the huge page size, aligned to it, and
+    /// backed by huge pages where possible.
+    ///
+    /// On success, this returns a non-null memory block, otherwise it returns
+    /// a null memory block and fills in *ErrMsg.
+    ///
+    /// @brief Allocate Read/Write memory.
+    static MemoryBlock AllocateRW(size_t NumBytes, bool HugePages,
+                                  std::string *ErrMsg = 0);
+
+    /// This method releases a block of Read/Write memory that was allocated
+    /// with the AllocateRW method.
+    ///
+    /// On success, this returns false, otherwise it returns true and fills
+    /// in *ErrMsg.
+    /// @brief Release Read/Write memory.
+    static bool ReleaseRW(MemoryBlock &block, std::string *ErrMsg = 0);
+
 
     /// InvalidateInstructionCache - Before the JIT can run a block of code
     /// that has been emitted it must invalidate the instruction cache on some
@@ -19,6 +19,7 @@
 struct llvm_regex;
 
 namespace llvm {
+  class RegexDFA;
   class StringRef;
   template<typename T> class SmallVectorImpl;
 
@@ -75,6 +76,10 @@ namespace llvm {
   private:
     struct llvm_regex *preg;
     int error;
+
+    /// DFA - The automaton used to find matches for regexes without back
+    /// references, created by the first call to match.
+    RegexDFA *DFA;
   };
 }
 
@@ -0,0 +1,158 @@
+//===-- llvm/Support/ThreadPool.h - Work-stealing thread pool ---*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares ThreadPool, a set of worker threads that run tasks,
+// TaskGroup, which waits for a set of tasks to finish, and parallel_for_each.
+//
+// Each worker has its own deque of tasks.  Tasks spawned from a worker go on
+// the back of its deque and it runs them newest first, which keeps the data
+// of nested work hot in its cache.  A worker whose deque is empty steals the
+// oldest task from another worker, which tends to be the biggest piece of
+// work left.  Tasks spawned from other threads go on a shared queue.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SUPPORT_THREADPOOL_H
+#define LLVM_SUPPORT_THREADPOOL_H
+
+#include "llvm/Support/Atomic.h"
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+namespace llvm {
+
+class TaskGroup;
+
+/// ThreadPool - A fixed set of threads running tasks.  Tasks are plain
+/// function pointers with an argument; the caller keeps the argument alive
+/// until the task has run.
+///
+/// When LLVM is built without thread support, there are no workers and every
+/// task runs on the spot, on the thread that spawns it.
+class ThreadPool {
+public:
+  typedef void (*TaskFn)(void *);
+
+  /// ThreadPool - Start NumThreads workers, or getDefaultNumThreads() of them
+  /// if NumThreads is zero.
+  explicit ThreadPool(unsigned NumThreads = 0);
+
+  /// ~ThreadPool - Wait for the tasks passed to async, then stop the workers.
+  /// Task groups using the pool must be done by then.
+  ~ThreadPool();
+
+  /// getNumThreads - The number of tasks the pool can run at once.
+  unsigned getNumThreads() const { return NumThreads; }
+
+  /// getDefaultNumThreads - The number of processors online, or 1 if that is
+  /// not known.
+  static unsigned getDefaultNumThreads();
+
+  /// async - Queue Fn(Data) to run on the pool.  wait() waits for it.
+  void async(TaskFn Fn, void *Data);
+
+  /// wait - Wait until every task passed to async has finished, running
+  /// queued tasks on this thread in the meantime.
+  void wait();
+
+private:
+  ThreadPool(const ThreadPool &);  // DO NOT IMPLEMENT
+  void operator=(const ThreadPool &);  // DO NOT IMPLEMENT
+
+  friend class TaskGroup;
+  struct Impl;
+  Impl *TheImpl;
+  unsigned NumThreads;
+  TaskGroup *AsyncTasks;
+
+  void spawn(TaskFn Fn, void *Data, TaskGroup &Group);
+  void waitFor(TaskGroup &Group);
+};
+
+/// TaskGroup - A set of tasks run by a ThreadPool that can be waited for
+/// together.  Waiting runs queued tasks rather than blocking the thread, so a
+/// task may itself spawn tasks into a group and wait for them.
+class TaskGroup {
+  ThreadPool &Pool;
+
+  /// Pending - The number of tasks spawned but not yet finished.
+  volatile sys::cas_flag Pending;
+
+  TaskGroup(const TaskGroup &);  // DO NOT IMPLEMENT
+  void operator=(const TaskGroup &);  // DO NOT IMPLEMENT
+
+  friend class ThreadPool;
+public:
+  explicit TaskGroup(ThreadPool &pool) : Pool(pool), Pending(0) {}
+
+  /// ~TaskGroup - Wait for any tasks still running.
+  ~TaskGroup() { wait(); }
+
+  /// spawn - Queue Fn(Data) to run on the pool as part of this group.
+  void spawn(ThreadPool::TaskFn Fn, void *Data) { Pool.spawn(Fn, Data, *this); }
+
+  /// wait - Wait until every task spawned into this group has finished.
+  void wait() { Pool.waitFor(*this); }
+};
+
+namespace parallel_detail {
+  /// ForEachChunk - A task calling a function on part of a range.
+  template<typename IterTy, typename FuncTy>
+  struct ForEachChunk {
+    IterTy Begin, End;
+    FuncTy *Fn;
+
+    static void run(void *Arg) {
+      ForEachChunk *C = static_cast<ForEachChunk*>(Arg);
+      for (IterTy I = C->Begin; I != C->End; ++I)
+        (*C->Fn)(*I);
+    }
+  };
+}
+
+/// parallel_for_each - Call Fn on each element of [Begin, End) on the threads
+/// of Pool, returning when all calls have finished.  Fn may be called on
+/// several threads at once.  The range is handed out in chunks of GrainSize
+/// elements; by default there are several chunks per thread, so that threads
+/// done with cheap elements can take over the rest of the range.
+template<typename IterTy, typename FuncTy>
+void parallel_for_each(ThreadPool &Pool, IterTy Begin, IterTy End, FuncTy Fn,
+                       unsigned GrainSize = 0) {
+  typedef parallel_detail::ForEachChunk<IterTy, FuncTy> ChunkTy;
+  typename std::iterator_traits<IterTy>::difference_type N =
+    std::distance(Begin, End);
+  if (N <= 0)
+    return;
+
+  if (GrainSize == 0)
+    GrainSize = std::max<unsigned>(1, N / (Pool.getNumThreads() * 8));
+
+  std::vector<ChunkTy> Chunks;
+  Chunks.reserve((N + GrainSize - 1) / GrainSize);
+  while (N > 0) {
+    ChunkTy C;
+    C.Begin = Begin;
+    unsigned Size = std::min<unsigned>(GrainSize, N);
+    std::advance(Begin, Size);
+    C.End = Begin;
+    C.Fn = &Fn;
+    Chunks.push_back(C);
+    N -= Size;
+  }
+
+  TaskGroup Group(Pool);
+  for (unsigned i = 0, e = Chunks.size(); i != e; ++i)
+    Group.spawn(&ChunkTy::run, &Chunks[i]);
+  Group.wait();
+}
+
+}
+
+#endif
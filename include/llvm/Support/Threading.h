@@ -54,6 +54,22 @@ namespace llvm {
   /// the thread stack.
   void llvm_execute_on_thread(void (*UserFn)(void*), void *UserData,
                               unsigned RequestedStackSize = 0);
+
+  /// llvm_execute_on_threads - Execute the given \arg UserFn on \arg NumThreads
+  /// separate threads at the same time, passing the i'th one UserData[i], and
+  /// wait for all of them to finish.
+  ///
+  /// Like llvm_execute_on_thread, this falls back to making the calls one
+  /// after another on the current thread where no threads are available.
+  ///
+  /// \param UserFn - The callback to execute.
+  /// \param UserData - An array of NumThreads arguments to pass to UserFn.
+  /// \param NumThreads - The number of threads to run.
+  /// \param RequestedStackSize - If non-zero, a requested size (in bytes) for
+  /// each thread stack.
+  void llvm_execute_on_threads(void (*UserFn)(void*), void *const *UserData,
+                               unsigned NumThreads,
+                               unsigned RequestedStackSize = 0);
 }
 
 #endif
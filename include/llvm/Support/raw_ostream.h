@@ -365,6 +365,10 @@ public:
   /// position to the offset specified from the beginning of the file.
   uint64_t seek(uint64_t off);
 
+  /// supportsSeeking - Return true if seek() can be used on this stream,
+  /// i.e. it refers to a regular file rather than a pipe or a terminal.
+  bool supportsSeeking();
+
   /// SetUseAtomicWrite - Set the stream to attempt to use atomic writes for
   /// individual output routines where possible.
   ///
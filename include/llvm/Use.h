@@ -20,6 +20,14 @@
 //
 //   http://www.llvm.org/docs/ProgrammersManual.html#UserLayout
 //
+// Use lists are maintained eagerly: every Use is linked into its Value's list
+// as soon as it is set.  Building them lazily in a side table would require
+// every client of use_begin()/replaceAllUsesWith() (including the constant
+// uniquing tables and ValueHandles, which rely on them to stay consistent) to
+// go through a per-function context first, so Use stays a fixed three-word
+// record and the tag walk in getImpliedUser stays logarithmic in the operand
+// count instead.
+//
 //===----------------------------------------------------------------------===//
 
 #ifndef LLVM_USE_H
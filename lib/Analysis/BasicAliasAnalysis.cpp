@@ -13,6 +13,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#define DEBUG_TYPE "basicaa"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/Passes.h"
 #include "llvm/Constants.h"
@@ -30,13 +31,19 @@
 #include "llvm/Analysis/InstructionSimplify.h"
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/Target/TargetData.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/GetElementPtrTypeIterator.h"
 #include <algorithm>
 using namespace llvm;
 
+STATISTIC(NumAliasCacheHits, "Number of alias pairs answered from the cache");
+STATISTIC(NumAliasCacheMisses, "Number of alias pairs computed");
+STATISTIC(NumGEPCacheHits, "Number of GEP decompositions reused");
+
 //===----------------------------------------------------------------------===//
 // Useful predicates
 //===----------------------------------------------------------------------===//
@@ -462,12 +469,16 @@ namespace {
 
     virtual AliasResult alias(const Location &LocA,
                               const Location &LocB) {
-      assert(Visited.empty() && "Visited must be cleared after use!");
+      assert(AliasCache.empty() && "AliasCache must be cleared after use!");
+      assert(GEPCache.empty() && "GEPCache must be cleared after use!");
       assert(notDifferentParent(LocA.Ptr, LocB.Ptr) &&
              "BasicAliasAnalysis doesn't support interprocedural queries.");
       AliasResult Alias = aliasCheck(LocA.Ptr, LocA.Size, LocA.TBAATag,
                                      LocB.Ptr, LocB.Size, LocB.TBAATag);
-      Visited.clear();
+      // The caches are only valid for the duration of this query: nothing
+      // tells us when the IR they were computed from is changed.
+      AliasCache.clear();
+      GEPCache.clear();
       return Alias;
     }
 
@@ -503,9 +514,30 @@ namespace {
     }
     
   private:
-    // Visited - Track instructions visited by a aliasPHI, aliasSelect(), and aliasGEP().
+    // AliasCache - Track alias queries to guard against recursion.
+    typedef std::pair<Location, Location> LocPair;
+    typedef DenseMap<LocPair, AliasResult> AliasCacheTy;
+    AliasCacheTy AliasCache;
+
+    // DecomposedGEP - The result of DecomposeGEPExpression on a GEP.
+    struct DecomposedGEP {
+      const Value *Base;
+      int64_t Offset;
+      SmallVector<VariableGEPIndex, 4> VarIndices;
+    };
+
+    // GEPCache - Decompositions of the GEPs seen during the current query.
+    // A query that looks through PHIs and selects tends to decompose the same
+    // GEP once for every incoming value.
+    DenseMap<const GEPOperator*, DecomposedGEP> GEPCache;
+
+    // Visited - Track instructions visited by pointsToConstantMemory.
     SmallPtrSet<const Value*, 16> Visited;
 
+    // decomposeGEP - DecomposeGEPExpression, memoized in GEPCache.
+    const Value *decomposeGEP(const GEPOperator *GEP, int64_t &BaseOffs,
+                              SmallVectorImpl<VariableGEPIndex> &VarIndices);
+
     // aliasGEP - Provide a bunch of ad-hoc rules to disambiguate a GEP
     // instruction against another.
     AliasResult aliasGEP(const GEPOperator *V1, uint64_t V1Size,
@@ -530,6 +562,11 @@ namespace {
                            const MDNode *V1TBAATag,
                            const Value *V2, uint64_t V2Size,
                            const MDNode *V2TBAATag);
+
+    AliasResult aliasCheckUncached(const Value *V1, uint64_t V1Size,
+                                   const MDNode *V1TBAATag,
+                                   const Value *V2, uint64_t V2Size,
+                                   const MDNode *V2TBAATag);
   };
 }  // End of anonymous namespace
 
@@ -785,6 +822,26 @@ BasicAliasAnalysis::getModRefInfo(ImmutableCallSite CS,
   return ModRefResult(AliasAnalysis::getModRefInfo(CS, Loc) & Min);
 }
 
+/// decomposeGEP - Return DecomposeGEPExpression(GEP), reusing the result if
+/// this GEP has already been decomposed during the current query.
+const Value *
+BasicAliasAnalysis::decomposeGEP(const GEPOperator *GEP, int64_t &BaseOffs,
+                                 SmallVectorImpl<VariableGEPIndex> &VarIndices) {
+  std::pair<DenseMap<const GEPOperator*, DecomposedGEP>::iterator, bool> Pair =
+    GEPCache.insert(std::make_pair(GEP, DecomposedGEP()));
+  DecomposedGEP &Entry = Pair.first->second;
+  if (Pair.second)
+    Entry.Base = DecomposeGEPExpression(GEP, Entry.Offset, Entry.VarIndices,
+                                        TD);
+  else
+    ++NumGEPCacheHits;
+
+  BaseOffs = Entry.Offset;
+  VarIndices.clear();
+  VarIndices.append(Entry.VarIndices.begin(), Entry.VarIndices.end());
+  return Entry.Base;
+}
+
 /// aliasGEP - Provide a bunch of ad-hoc rules to disambiguate a GEP instruction
 /// against another pointer.  We know that V1 is a GEP, but we don't know
 /// anything about V2.  UnderlyingV1 is GetUnderlyingObject(GEP1, TD),
@@ -796,13 +853,6 @@ BasicAliasAnalysis::aliasGEP(const GEPOperator *GEP1, uint64_t V1Size,
                              const MDNode *V2TBAAInfo,
                              const Value *UnderlyingV1,
                              const Value *UnderlyingV2) {
-  // If this GEP has been visited before, we're on a use-def cycle.
-  // Such cycles are only valid when PHI nodes are involved or in unreachable
-  // code. The visitPHI function catches cycles containing PHIs, but there
-  // could still be a cycle without PHIs in unreachable code.
-  if (!Visited.insert(GEP1))
-    return MayAlias;
-
   int64_t GEP1BaseOffset;
   SmallVector<VariableGEPIndex, 4> GEP1VariableIndices;
 
@@ -821,12 +871,12 @@ BasicAliasAnalysis::aliasGEP(const GEPOperator *GEP1, uint64_t V1Size,
     // exactly, see if the computed offset from the common pointer tells us
     // about the relation of the resulting pointer.
     const Value *GEP1BasePtr =
-      DecomposeGEPExpression(GEP1, GEP1BaseOffset, GEP1VariableIndices, TD);
+      decomposeGEP(GEP1, GEP1BaseOffset, GEP1VariableIndices);
     
     int64_t GEP2BaseOffset;
     SmallVector<VariableGEPIndex, 4> GEP2VariableIndices;
     const Value *GEP2BasePtr =
-      DecomposeGEPExpression(GEP2, GEP2BaseOffset, GEP2VariableIndices, TD);
+      decomposeGEP(GEP2, GEP2BaseOffset, GEP2VariableIndices);
     
     // If DecomposeGEPExpression isn't able to look all the way through the
     // addressing operation, we must not have TD and this is too complex for us
@@ -862,7 +912,7 @@ BasicAliasAnalysis::aliasGEP(const GEPOperator *GEP1, uint64_t V1Size,
       return R;
 
     const Value *GEP1BasePtr =
-      DecomposeGEPExpression(GEP1, GEP1BaseOffset, GEP1VariableIndices, TD);
+      decomposeGEP(GEP1, GEP1BaseOffset, GEP1VariableIndices);
     
     // If DecomposeGEPExpression isn't able to look all the way through the
     // addressing operation, we must not have TD and this is too complex for us
@@ -930,13 +980,6 @@ BasicAliasAnalysis::aliasSelect(const SelectInst *SI, uint64_t SISize,
                                 const MDNode *SITBAAInfo,
                                 const Value *V2, uint64_t V2Size,
                                 const MDNode *V2TBAAInfo) {
-  // If this select has been visited before, we're on a use-def cycle.
-  // Such cycles are only valid when PHI nodes are involved or in unreachable
-  // code. The visitPHI function catches cycles containing PHIs, but there
-  // could still be a cycle without PHIs in unreachable code.
-  if (!Visited.insert(SI))
-    return MayAlias;
-
   // If the values are Selects with the same condition, we can do a more precise
   // check: just check for aliases between the values on corresponding arms.
   if (const SelectInst *SI2 = dyn_cast<SelectInst>(V2))
@@ -961,11 +1004,6 @@ BasicAliasAnalysis::aliasSelect(const SelectInst *SI, uint64_t SISize,
   if (Alias == MayAlias)
     return MayAlias;
 
-  // If V2 is visited, the recursive case will have been caught in the
-  // above aliasCheck call, so these subsequent calls to aliasCheck
-  // don't need to assume that V2 is being visited recursively.
-  Visited.erase(V2);
-
   AliasResult ThisAlias =
     aliasCheck(V2, V2Size, V2TBAAInfo, SI->getFalseValue(), SISize, SITBAAInfo);
   if (ThisAlias != Alias)
@@ -980,10 +1018,6 @@ BasicAliasAnalysis::aliasPHI(const PHINode *PN, uint64_t PNSize,
                              const MDNode *PNTBAAInfo,
                              const Value *V2, uint64_t V2Size,
                              const MDNode *V2TBAAInfo) {
-  // The PHI node has already been visited, avoid recursion any further.
-  if (!Visited.insert(PN))
-    return MayAlias;
-
   // If the values are PHIs in the same block, we can do a more precise
   // as well as efficient check: just check for aliases between the values
   // on corresponding edges.
@@ -1032,11 +1066,6 @@ BasicAliasAnalysis::aliasPHI(const PHINode *PN, uint64_t PNSize,
   for (unsigned i = 1, e = V1Srcs.size(); i != e; ++i) {
     Value *V = V1Srcs[i];
 
-    // If V2 is visited, the recursive case will have been caught in the
-    // above aliasCheck call, so these subsequent calls to aliasCheck
-    // don't need to assume that V2 is being visited recursively.
-    Visited.erase(V2);
-
     AliasResult ThisAlias = aliasCheck(V2, V2Size, V2TBAAInfo,
                                        V, PNSize, PNTBAAInfo);
     if (ThisAlias != Alias || ThisAlias == MayAlias)
@@ -1069,6 +1098,36 @@ BasicAliasAnalysis::aliasCheck(const Value *V1, uint64_t V1Size,
   if (!V1->getType()->isPointerTy() || !V2->getType()->isPointerTy())
     return NoAlias;  // Scalars cannot alias each other
 
+  // Check the cache before climbing up use-def chains.  This also terminates
+  // otherwise infinitely recursive queries: a pair that is already being
+  // computed further up the stack is conservatively reported as MayAlias.
+  LocPair Locs(Location(V1, V1Size, V1TBAAInfo),
+               Location(V2, V2Size, V2TBAAInfo));
+  if (V1 > V2)
+    std::swap(Locs.first, Locs.second);
+  std::pair<AliasCacheTy::iterator, bool> Pair =
+    AliasCache.insert(std::make_pair(Locs, MayAlias));
+  if (!Pair.second) {
+    ++NumAliasCacheHits;
+    return Pair.first->second;
+  }
+  ++NumAliasCacheMisses;
+
+  // The recursive queries may grow the cache, so look the entry up again.
+  AliasResult Result = aliasCheckUncached(V1, V1Size, V1TBAAInfo,
+                                          V2, V2Size, V2TBAAInfo);
+  AliasCache[Locs] = Result;
+  return Result;
+}
+
+// aliasCheckUncached - The body of aliasCheck.  V1 and V2 are distinct pointers
+// with their casts stripped and nonzero access sizes.
+//
+AliasAnalysis::AliasResult
+BasicAliasAnalysis::aliasCheckUncached(const Value *V1, uint64_t V1Size,
+                                       const MDNode *V1TBAAInfo,
+                                       const Value *V2, uint64_t V2Size,
+                                       const MDNode *V2TBAAInfo) {
   // Figure out what objects these things are pointing to if we can.
   const Value *O1 = GetUnderlyingObject(V1, TD);
   const Value *O2 = GetUnderlyingObject(V2, TD);
@@ -422,6 +422,14 @@ bool CGPassManager::runOnModule(Module &M) {
   bool Changed = doInitialization(CG);
   
   // Walk the callgraph in bottom-up SCC order.
+  //
+  // FIXME: Sibling SCCs with no call edges between them could in principle be
+  // processed concurrently, but the passes we run mutate IR that is shared
+  // across the whole module: inlining and simplification create uniqued
+  // constants and types in the LLVMContext, add and drop uses of globals and
+  // constants (whose use lists are not synchronized), refine abstract types,
+  // and update the CallGraph and non-atomic Statistics.  Until those are made
+  // thread safe the SCCs have to be visited one at a time.
   scc_iterator<CallGraph*> CGI = scc_begin(&CG);
 
   CallGraphSCC CurSCC(&CGI);
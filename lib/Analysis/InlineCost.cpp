@@ -313,19 +313,26 @@ int InlineCostAnalyzer::ConstantFunctionBonus(CallSite CS, Constant *C) {
 }
 
 // CountBonusForConstant - Figure out an approximation for how much per-call
-// performance boost we can expect if the specified value is constant.
-int InlineCostAnalyzer::CountBonusForConstant(Value *V, Constant *C) {
+// performance boost we can expect if the specified value is constant.  If
+// CalledThrough is non-null, it is set when the result depends on C because
+// the value is called.
+int InlineCostAnalyzer::CountBonusForConstant(Value *V, Constant *C,
+                                              bool *CalledThrough) {
   unsigned Bonus = 0;
   for (Value::use_iterator UI = V->use_begin(), E = V->use_end(); UI != E;++UI){
     User *U = *UI;
     if (CallInst *CI = dyn_cast<CallInst>(U)) {
       // Turning an indirect call into a direct call is a BIG win
-      if (CI->getCalledValue() == V)
+      if (CI->getCalledValue() == V) {
         Bonus += ConstantFunctionBonus(CallSite(CI), C);
+        if (CalledThrough) *CalledThrough = true;
+      }
     } else if (InvokeInst *II = dyn_cast<InvokeInst>(U)) {
       // Turning an indirect call into a direct call is a BIG win
-      if (II->getCalledValue() == V)
+      if (II->getCalledValue() == V) {
         Bonus += ConstantFunctionBonus(CallSite(II), C);
+        if (CalledThrough) *CalledThrough = true;
+      }
     }
     // FIXME: Eliminating conditional branches and switches should
     // also yield a per-call performance boost.
@@ -360,6 +367,33 @@ int InlineCostAnalyzer::CountBonusForConstant(Value *V, Constant *C) {
   return Bonus;
 }
 
+// getConstantArgBonus - Return CountBonusForConstant(Arg, C) for argument
+// ArgNo of Callee, using the summary cached in the callee's FunctionInfo when
+// the bonus doesn't depend on C.
+int InlineCostAnalyzer::getConstantArgBonus(Function *Callee, unsigned ArgNo,
+                                            Argument *Arg, Constant *C) {
+  ArgInfo &AI = CachedFunctionInfo[Callee].ArgumentWeights[ArgNo];
+  if (AI.ConstantBonusKnown && !AI.CalledThrough)
+    return AI.ConstantBonus;
+  if (AI.ConstantBonusKnown)
+    return CountBonusForConstant(Arg, C);
+
+  // Compute the bonus without a constant: this is the whole bonus unless the
+  // argument turns out to be called through.
+  bool CalledThrough = false;
+  int Bonus = CountBonusForConstant(Arg, NULL, &CalledThrough);
+
+  // CountBonusForConstant may have analyzed other functions, which can move
+  // the callee's FunctionInfo, so look it up again.
+  ArgInfo &NewAI = CachedFunctionInfo[Callee].ArgumentWeights[ArgNo];
+  NewAI.ConstantBonus = Bonus;
+  NewAI.ConstantBonusKnown = true;
+  NewAI.CalledThrough = CalledThrough;
+  if (CalledThrough)
+    return CountBonusForConstant(Arg, C);
+  return Bonus;
+}
+
 int InlineCostAnalyzer::getInlineSize(CallSite CS, Function *Callee) {
   // Get information about the callee.
   FunctionInfo *CalleeFI = &CachedFunctionInfo[Callee];
@@ -450,12 +484,13 @@ int InlineCostAnalyzer::getInlineBonuses(CallSite CS, Function *Callee) {
   // the function will be optimizable.  Currently this just looks at arguments
   // passed into the function.
   //
+  unsigned ArgNo = 0;
   CallSite::arg_iterator I = CS.arg_begin();
   for (Function::arg_iterator FI = Callee->arg_begin(), FE = Callee->arg_end();
-       FI != FE; ++I, ++FI)
+       FI != FE; ++I, ++FI, ++ArgNo)
     // Compute any constant bonus due to inlining we want to give here.
     if (isa<Constant>(I))
-      Bonus += CountBonusForConstant(FI, cast<Constant>(I));
+      Bonus += getConstantArgBonus(Callee, ArgNo, FI, cast<Constant>(I));
       
   return Bonus;
 }
@@ -604,6 +639,12 @@ InlineCostAnalyzer::growCachedCostInfo(Function *Caller, Function *Callee) {
   if (CallerMetrics.NumCalls > 0)
     --CallerMetrics.NumCalls;
 
+  // The constant argument bonuses walk the caller's uses, which just changed;
+  // they are cheap to recompute on demand, so drop them.
+  std::vector<ArgInfo> &CallerArgs = CachedFunctionInfo[Caller].ArgumentWeights;
+  for (unsigned i = 0, e = CallerArgs.size(); i != e; ++i)
+    CallerArgs[i].ConstantBonusKnown = false;
+
   if (Callee == 0) return;
   
   CodeMetrics &CalleeMetrics = CachedFunctionInfo[Callee].Metrics;
@@ -28,8 +28,10 @@
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/PredIteratorCache.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/Timer.h"
 #include "llvm/Target/TargetData.h"
 using namespace llvm;
 
@@ -45,6 +47,25 @@ STATISTIC(NumUncacheNonLocalPtr,
           "Number of uncached non-local ptr responses");
 STATISTIC(NumCacheCompleteNonLocalPtr,
           "Number of block queries that were completely cached");
+STATISTIC(NumBlockScanLimit,
+          "Number of block scans stopped by the scan limit");
+STATISTIC(NumBlockNumberLimit,
+          "Number of non-local ptr queries stopped by the block limit");
+
+// Bound the work done for a single query so that very large functions don't
+// make clients like GVN go quadratic.  A query that runs out of budget is
+// answered conservatively with a clobber.  Zero means no limit.
+static cl::opt<unsigned>
+BlockScanLimit("memdep-block-scan-limit", cl::init(500), cl::Hidden,
+  cl::desc("The number of instructions to scan in a block in memory "
+           "dependency analysis (0 = unlimited, default = 500)"));
+
+static cl::opt<unsigned>
+BlockNumberLimit("memdep-block-number-limit", cl::init(1000), cl::Hidden,
+  cl::desc("The number of blocks to visit for a single non-local memory "
+           "dependency query (0 = unlimited, default = 1000)"));
+
+static const char *const MemDepTimerGroupName = "Memory Dependence Analysis";
 
 char MemoryDependenceAnalysis::ID = 0;
   
@@ -179,9 +200,18 @@ AliasAnalysis::ModRefResult GetLocation(const Instruction *Inst,
 MemDepResult MemoryDependenceAnalysis::
 getCallSiteDependencyFrom(CallSite CS, bool isReadOnlyCall,
                           BasicBlock::iterator ScanIt, BasicBlock *BB) {
+  unsigned Limit = BlockScanLimit;
+
   // Walk backwards through the block, looking for dependencies
   while (ScanIt != BB->begin()) {
     Instruction *Inst = --ScanIt;
+
+    // Limit the amount of scanning we do so we don't end up with quadratic
+    // running time on extreme testcases.
+    if (BlockScanLimit && !isa<DbgInfoIntrinsic>(Inst) && Limit-- == 0) {
+      ++NumBlockScanLimit;
+      return MemDepResult::getClobber(Inst);
+    }
     
     // If this inst is a memory op, get the pointer it accessed
     AliasAnalysis::Location Loc;
@@ -230,11 +260,20 @@ getPointerDependencyFrom(const AliasAnalysis::Location &MemLoc, bool isLoad,
                          BasicBlock::iterator ScanIt, BasicBlock *BB) {
 
   Value *InvariantTag = 0;
+  unsigned Limit = BlockScanLimit;
 
   // Walk backwards through the basic block, looking for dependencies.
   while (ScanIt != BB->begin()) {
     Instruction *Inst = --ScanIt;
 
+    // Limit the amount of scanning we do so we don't end up with quadratic
+    // running time on extreme testcases.  Running out of budget is treated as
+    // a clobber by the instruction we stopped at.
+    if (BlockScanLimit && !isa<DbgInfoIntrinsic>(Inst) && Limit-- == 0) {
+      ++NumBlockScanLimit;
+      return MemDepResult::getClobber(Inst);
+    }
+
     // If we're in an invariant region, no dependencies can be found before
     // we pass an invariant-begin marker.
     if (InvariantTag == Inst) {
@@ -378,6 +417,8 @@ getPointerDependencyFrom(const AliasAnalysis::Location &MemLoc, bool isLoad,
 /// getDependency - Return the instruction on which a memory operation
 /// depends.
 MemDepResult MemoryDependenceAnalysis::getDependency(Instruction *QueryInst) {
+  NamedRegionTimer T("Local Dependency Queries", MemDepTimerGroupName,
+                     TimePassesIsEnabled);
   Instruction *ScanPos = QueryInst;
   
   // Check for a cached result
@@ -463,6 +504,8 @@ const MemoryDependenceAnalysis::NonLocalDepInfo &
 MemoryDependenceAnalysis::getNonLocalCallDependency(CallSite QueryCS) {
   assert(getDependency(QueryCS.getInstruction()).isNonLocal() &&
  "getNonLocalCallDependency should only be used on calls with non-local deps!");
+  NamedRegionTimer T("Non-Local Call Queries", MemDepTimerGroupName,
+                     TimePassesIsEnabled);
   PerInstNLInfo &CacheP = NonLocalDeps[QueryCS.getInstruction()];
   NonLocalDepInfo &Cache = CacheP.first;
 
@@ -603,6 +646,8 @@ getNonLocalPointerDependency(const AliasAnalysis::Location &Loc, bool isLoad,
                              SmallVectorImpl<NonLocalDepResult> &Result) {
   assert(Loc.Ptr->getType()->isPointerTy() &&
          "Can't get pointer deps of a non-pointer!");
+  NamedRegionTimer T("Non-Local Pointer Queries", MemDepTimerGroupName,
+                     TimePassesIsEnabled);
   Result.clear();
   
   PHITransAddr Address(const_cast<Value *>(Loc.Ptr), TD);
@@ -863,6 +908,19 @@ getNonLocalPointerDepFromBB(const PHITransAddr &Pointer,
   
   while (!Worklist.empty()) {
     BasicBlock *BB = Worklist.pop_back_val();
+
+    // Bail out if this query has visited more blocks than it is allowed to.
+    // 'Visited' is shared with the recursive phi translated queries, so this
+    // bounds the whole query, not just this level of it.
+    if (BlockNumberLimit && Visited.size() > BlockNumberLimit) {
+      ++NumBlockNumberLimit;
+      // The entries we added so far are still valid for specific block
+      // queries, so keep the cache sorted, but it no longer holds the complete
+      // answer for this query.
+      SortNonLocalDepInfoCache(*Cache, NumSortedEntries);
+      CacheInfo->Pair = BBSkipFirstBlockPair();
+      return true;
+    }
     
     // Skip the first block if we have it.
     if (!SkipFirstBlock) {
@@ -96,6 +96,10 @@ STATISTIC(NumTripCountsNotComputed,
           "Number of loops without predictable loop counts");
 STATISTIC(NumBruteForceTripCountsComputed,
           "Number of loops with trip counts computed by force");
+STATISTIC(NumHugeExpressions,
+          "Number of values left unanalyzed because their SCEV was too big");
+STATISTIC(NumArenaBytes,
+          "Number of bytes allocated by the SCEV arena");
 
 static cl::opt<unsigned>
 MaxBruteForceIterations("scalar-evolution-max-iterations", cl::ReallyHidden,
@@ -104,6 +108,12 @@ MaxBruteForceIterations("scalar-evolution-max-iterations", cl::ReallyHidden,
                                  "derived loop"),
                         cl::init(100));
 
+static cl::opt<unsigned>
+HugeExprThreshold("scalar-evolution-huge-expr-threshold", cl::Hidden,
+                  cl::desc("Size of the expression tree above which a value "
+                           "is treated as an opaque SCEVUnknown"),
+                  cl::init(4096));
+
 INITIALIZE_PASS_BEGIN(ScalarEvolution, "scalar-evolution",
                 "Scalar Evolution Analysis", false, true)
 INITIALIZE_PASS_DEPENDENCY(LoopInfo)
@@ -301,7 +311,7 @@ ScalarEvolution::getConstant(const Type *Ty, uint64_t V, bool isSigned) {
 
 SCEVCastExpr::SCEVCastExpr(const FoldingSetNodeIDRef ID,
                            unsigned SCEVTy, const SCEV *op, const Type *ty)
-  : SCEV(ID, SCEVTy), Op(op), Ty(ty) {}
+  : SCEV(ID, SCEVTy, 1 + op->getExpressionSize()), Op(op), Ty(ty) {}
 
 SCEVTruncateExpr::SCEVTruncateExpr(const FoldingSetNodeIDRef ID,
                                    const SCEV *op, const Type *ty)
@@ -2476,6 +2486,15 @@ const SCEV *ScalarEvolution::getSCEV(Value *V) {
   if (I != ValueExprMap.end()) return I->second;
   const SCEV *S = createSCEV(V);
 
+  // Expressions built on top of a huge expression are at least as big, and
+  // everything ScalarEvolution does with them gets slower and uses more
+  // memory.  Cut the growth off by treating the value as opaque.  PHIs are
+  // left alone because createNodeForPHI has already recorded its result.
+  if (S->getExpressionSize() > HugeExprThreshold && !isa<PHINode>(V)) {
+    ++NumHugeExpressions;
+    S = getUnknown(V);
+  }
+
   // The process of creating a SCEV for V may have caused other SCEVs
   // to have been created, so it's necessary to insert the new entry
   // from scratch, rather than trying to remember the insert position
@@ -5983,6 +6002,7 @@ void ScalarEvolution::releaseMemory() {
   UnsignedRanges.clear();
   SignedRanges.clear();
   UniqueSCEVs.clear();
+  NumArenaBytes += SCEVAllocator.getTotalMemory();
   SCEVAllocator.Reset();
 }
 
@@ -17,6 +17,7 @@
 #include "llvm/Constants.h"
 #include "llvm/DerivedTypes.h"
 #include "llvm/InlineAsm.h"
+#include "llvm/LLVMContext.h"
 #include "llvm/Instructions.h"
 #include "llvm/Module.h"
 #include "llvm/Operator.h"
@@ -28,11 +29,18 @@ using namespace llvm;
 
 /// Run: module ::= toplevelentity*
 bool LLParser::Run() {
+  // Local values are resolved through the function's symbol table, so keep
+  // their names while parsing even if the context would discard them.
+  bool DiscardValueNames = Context.shouldDiscardValueNames();
+  Context.setDiscardValueNames(false);
+
   // Prime the lexer.
   Lex.Lex();
 
-  return ParseTopLevelEntities() ||
-         ValidateEndOfModule();
+  bool Failed = ParseTopLevelEntities() ||
+                ValidateEndOfModule();
+  Context.setDiscardValueNames(DiscardValueNames);
+  return Failed;
 }
 
 /// ValidateEndOfModule - Do final validity and sanity checks at the end of the
@@ -17,6 +17,7 @@
 #include "llvm/DerivedTypes.h"
 #include "llvm/InlineAsm.h"
 #include "llvm/IntrinsicInst.h"
+#include "llvm/LLVMContext.h"
 #include "llvm/Module.h"
 #include "llvm/Operator.h"
 #include "llvm/AutoUpgrade.h"
@@ -24,6 +25,7 @@
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/TimeValue.h"
 #include "llvm/OperandTraits.h"
 using namespace llvm;
 
@@ -368,11 +370,75 @@ const Type *BitcodeReader::getTypeByID(unsigned ID, bool isTypeTable) {
   return TypeList.back().get();
 }
 
+//===----------------------------------------------------------------------===//
+//  BitcodeReaderProfiler Class
+//===----------------------------------------------------------------------===//
+
+static uint64_t GetCurrentMicroseconds() {
+  sys::TimeValue Now = sys::TimeValue::now();
+  return uint64_t(Now.seconds()) * 1000000 + Now.microseconds();
+}
+
+BitcodeReaderProfiler::BitcodeReaderProfiler(BitcodeReadProfile &P)
+  : Profile(P), LastTime(GetCurrentMicroseconds()) {}
+
+void BitcodeReaderProfiler::charge() {
+  uint64_t Now = GetCurrentMicroseconds();
+  if (!Stack.empty()) {
+    Block &B = Stack.back();
+    B.BlockEntry->Microseconds += Now - LastTime;
+    if (B.RecordEntry)
+      B.RecordEntry->Microseconds += Now - LastTime;
+  }
+  LastTime = Now;
+}
+
+void BitcodeReaderProfiler::enterBlock(unsigned BlockID) {
+  charge();
+  Block B;
+  B.BlockEntry = &Profile.Blocks[BlockID];
+  B.BlockID = BlockID;
+  B.RecordEntry = 0;
+  ++B.BlockEntry->Count;
+  Stack.push_back(B);
+}
+
+void BitcodeReaderProfiler::exitBlock() {
+  assert(!Stack.empty() && "Block scope imbalance!");
+  charge();
+  Stack.pop_back();
+}
+
+void BitcodeReaderProfiler::startRecord(unsigned Code, bool Abbreviated) {
+  assert(!Stack.empty() && "Record outside of a block!");
+  Block &B = Stack.back();
+  B.RecordEntry = &Profile.Records[std::make_pair(B.BlockID, Code)];
+  ++B.RecordEntry->Count;
+  if (Abbreviated)
+    ++B.RecordEntry->NumAbbreviated;
+}
+
+namespace {
+  /// ProfiledBlock - Tells the reader's profiler, if it has one, that the
+  /// reader is working on the specified block while this object is alive.
+  class ProfiledBlock {
+    BitcodeReaderProfiler *Profiler;
+  public:
+    ProfiledBlock(BitcodeReaderProfiler *P, unsigned BlockID) : Profiler(P) {
+      if (Profiler) Profiler->enterBlock(BlockID);
+    }
+    ~ProfiledBlock() {
+      if (Profiler) Profiler->exitBlock();
+    }
+  };
+}
+
 //===----------------------------------------------------------------------===//
 //  Functions for parsing blocks from the bitcode file
 //===----------------------------------------------------------------------===//
 
 bool BitcodeReader::ParseAttributeBlock() {
+  ProfiledBlock PB(Profiler, bitc::PARAMATTR_BLOCK_ID);
   if (Stream.EnterSubBlock(bitc::PARAMATTR_BLOCK_ID))
     return Error("Malformed block record");
 
@@ -407,7 +473,7 @@ bool BitcodeReader::ParseAttributeBlock() {
 
     // Read a record.
     Record.clear();
-    switch (Stream.ReadRecord(Code, Record)) {
+    switch (ReadRecord(Code, Record)) {
     default:  // Default behavior: ignore.
       break;
     case bitc::PARAMATTR_CODE_ENTRY: { // ENTRY: [paramidx0, attr0, ...]
@@ -476,6 +542,7 @@ bool BitcodeReader::ParseAttributeBlock() {
 
 
 bool BitcodeReader::ParseTypeTable() {
+  ProfiledBlock PB(Profiler, bitc::TYPE_BLOCK_ID);
   if (Stream.EnterSubBlock(bitc::TYPE_BLOCK_ID))
     return Error("Malformed block record");
 
@@ -512,7 +579,7 @@ bool BitcodeReader::ParseTypeTable() {
     // Read a record.
     Record.clear();
     const Type *ResultTy = 0;
-    switch (Stream.ReadRecord(Code, Record)) {
+    switch (ReadRecord(Code, Record)) {
     default:  // Default behavior: unknown type.
       ResultTy = 0;
       break;
@@ -637,6 +704,7 @@ bool BitcodeReader::ParseTypeTable() {
 
 
 bool BitcodeReader::ParseTypeSymbolTable() {
+  ProfiledBlock PB(Profiler, bitc::TYPE_SYMTAB_BLOCK_ID);
   if (Stream.EnterSubBlock(bitc::TYPE_SYMTAB_BLOCK_ID))
     return Error("Malformed block record");
 
@@ -667,7 +735,7 @@ bool BitcodeReader::ParseTypeSymbolTable() {
 
     // Read a record.
     Record.clear();
-    switch (Stream.ReadRecord(Code, Record)) {
+    switch (ReadRecord(Code, Record)) {
     default:  // Default behavior: unknown type.
       break;
     case bitc::TST_CODE_ENTRY:    // TST_ENTRY: [typeid, namechar x N]
@@ -685,6 +753,7 @@ bool BitcodeReader::ParseTypeSymbolTable() {
 }
 
 bool BitcodeReader::ParseValueSymbolTable() {
+  ProfiledBlock PB(Profiler, bitc::VALUE_SYMTAB_BLOCK_ID);
   if (Stream.EnterSubBlock(bitc::VALUE_SYMTAB_BLOCK_ID))
     return Error("Malformed block record");
 
@@ -714,7 +783,7 @@ bool BitcodeReader::ParseValueSymbolTable() {
 
     // Read a record.
     Record.clear();
-    switch (Stream.ReadRecord(Code, Record)) {
+    switch (ReadRecord(Code, Record)) {
     default:  // Default behavior: unknown type.
       break;
     case bitc::VST_CODE_ENTRY: {  // VST_ENTRY: [valueid, namechar x N]
@@ -747,6 +816,7 @@ bool BitcodeReader::ParseValueSymbolTable() {
 bool BitcodeReader::ParseMetadata() {
   unsigned NextMDValueNo = MDValueList.size();
 
+  ProfiledBlock PB(Profiler, bitc::METADATA_BLOCK_ID);
   if (Stream.EnterSubBlock(bitc::METADATA_BLOCK_ID))
     return Error("Malformed block record");
 
@@ -777,7 +847,7 @@ bool BitcodeReader::ParseMetadata() {
     bool IsFunctionLocal = false;
     // Read a record.
     Record.clear();
-    Code = Stream.ReadRecord(Code, Record);
+    Code = ReadRecord(Code, Record);
     switch (Code) {
     default:  // Default behavior: ignore.
       break;
@@ -793,7 +863,7 @@ bool BitcodeReader::ParseMetadata() {
 
       // METADATA_NAME is always followed by METADATA_NAMED_NODE2.
       // Or METADATA_NAMED_NODE in LLVM 2.7. FIXME: Remove this in LLVM 3.0.
-      unsigned NextBitCode = Stream.ReadRecord(Code, Record);
+      unsigned NextBitCode = ReadRecord(Code, Record);
       if (NextBitCode == bitc::METADATA_NAMED_NODE) {
         LLVM2_7MetadataDetected = true;
       } else if (NextBitCode != bitc::METADATA_NAMED_NODE2)
@@ -931,6 +1001,7 @@ bool BitcodeReader::ResolveGlobalAndAliasInits() {
 }
 
 bool BitcodeReader::ParseConstants() {
+  ProfiledBlock PB(Profiler, bitc::CONSTANTS_BLOCK_ID);
   if (Stream.EnterSubBlock(bitc::CONSTANTS_BLOCK_ID))
     return Error("Malformed block record");
 
@@ -960,7 +1031,7 @@ bool BitcodeReader::ParseConstants() {
     // Read a record.
     Record.clear();
     Value *V = 0;
-    unsigned BitCode = Stream.ReadRecord(Code, Record);
+    unsigned BitCode = ReadRecord(Code, Record);
     switch (BitCode) {
     default:  // Default behavior: unknown constant
     case bitc::CST_CODE_UNDEF:     // UNDEF
@@ -1277,6 +1348,7 @@ bool BitcodeReader::RememberAndSkipFunctionBody() {
 }
 
 bool BitcodeReader::ParseModule() {
+  ProfiledBlock PB(Profiler, bitc::MODULE_BLOCK_ID);
   if (Stream.EnterSubBlock(bitc::MODULE_BLOCK_ID))
     return Error("Malformed block record");
 
@@ -1326,10 +1398,12 @@ bool BitcodeReader::ParseModule() {
         if (Stream.SkipBlock())
           return Error("Malformed block record");
         break;
-      case bitc::BLOCKINFO_BLOCK_ID:
+      case bitc::BLOCKINFO_BLOCK_ID: {
+        ProfiledBlock PB(Profiler, bitc::BLOCKINFO_BLOCK_ID);
         if (Stream.ReadBlockInfoBlock())
           return Error("Malformed BlockInfoBlock");
         break;
+      }
       case bitc::PARAMATTR_BLOCK_ID:
         if (ParseAttributeBlock())
           return true;
@@ -1375,7 +1449,7 @@ bool BitcodeReader::ParseModule() {
     }
 
     // Read a record.
-    switch (Stream.ReadRecord(Code, Record)) {
+    switch (ReadRecord(Code, Record)) {
     default: break;  // Default behavior, ignore unknown content.
     case bitc::MODULE_CODE_VERSION:  // VERSION: [version#]
       if (Record.size() < 1)
@@ -1598,10 +1672,12 @@ bool BitcodeReader::ParseBitcodeInto(Module *M) {
 
     // We only know the MODULE subblock ID.
     switch (BlockID) {
-    case bitc::BLOCKINFO_BLOCK_ID:
+    case bitc::BLOCKINFO_BLOCK_ID: {
+      ProfiledBlock PB(Profiler, bitc::BLOCKINFO_BLOCK_ID);
       if (Stream.ReadBlockInfoBlock())
         return Error("Malformed BlockInfoBlock");
       break;
+    }
     case bitc::MODULE_BLOCK_ID:
       // Reject multiple MODULE_BLOCK's in a single bitstream.
       if (TheModule)
@@ -1728,6 +1804,7 @@ bool BitcodeReader::ParseTriple(std::string &Triple) {
 
 /// ParseMetadataAttachment - Parse metadata attachments.
 bool BitcodeReader::ParseMetadataAttachment() {
+  ProfiledBlock PB(Profiler, bitc::METADATA_ATTACHMENT_ID);
   if (Stream.EnterSubBlock(bitc::METADATA_ATTACHMENT_ID))
     return Error("Malformed block record");
 
@@ -1745,7 +1822,7 @@ bool BitcodeReader::ParseMetadataAttachment() {
     }
     // Read a metadata attachment record.
     Record.clear();
-    switch (Stream.ReadRecord(Code, Record)) {
+    switch (ReadRecord(Code, Record)) {
     default:  // Default behavior: ignore.
       break;
     // FIXME: Remove in LLVM 3.0.
@@ -1774,6 +1851,7 @@ bool BitcodeReader::ParseMetadataAttachment() {
 
 /// ParseFunctionBody - Lazily parse the specified function body block.
 bool BitcodeReader::ParseFunctionBody(Function *F) {
+  ProfiledBlock PB(Profiler, bitc::FUNCTION_BLOCK_ID);
   if (Stream.EnterSubBlock(bitc::FUNCTION_BLOCK_ID))
     return Error("Malformed block record");
 
@@ -1812,6 +1890,12 @@ bool BitcodeReader::ParseFunctionBody(Function *F) {
         NextValueNo = ValueList.size();
         break;
       case bitc::VALUE_SYMTAB_BLOCK_ID:
+        // The names would just be dropped, so don't bother reading them.
+        if (Context.shouldDiscardValueNames()) {
+          if (Stream.SkipBlock())
+            return Error("Malformed block record");
+          break;
+        }
         if (ParseValueSymbolTable()) return true;
         break;
       case bitc::METADATA_ATTACHMENT_ID:
@@ -1832,7 +1916,7 @@ bool BitcodeReader::ParseFunctionBody(Function *F) {
     // Read a record.
     Record.clear();
     Instruction *I = 0;
-    unsigned BitCode = Stream.ReadRecord(Code, Record);
+    unsigned BitCode = ReadRecord(Code, Record);
     switch (BitCode) {
     default: // Default behavior: reject
       return Error("Unknown instruction");
@@ -2673,6 +2757,32 @@ Module *llvm::ParseBitcodeFile(MemoryBuffer *Buffer, LLVMContext& Context,
   return M;
 }
 
+/// ProfileBitcodeFile - Read the specified bitcode file like ParseBitcodeFile,
+/// recording the time spent on each block and record in Profile.
+Module *llvm::ProfileBitcodeFile(MemoryBuffer *Buffer, LLVMContext& Context,
+                                 BitcodeReadProfile &Profile,
+                                 std::string *ErrMsg) {
+  Module *M = new Module(Buffer->getBufferIdentifier(), Context);
+  BitcodeReader *R = new BitcodeReader(Buffer, Context);
+  M->setMaterializer(R);
+  R->setProfile(Profile);
+  if (R->ParseBitcodeInto(M)) {
+    if (ErrMsg)
+      *ErrMsg = R->getErrorString();
+
+    delete M;  // Also deletes R.
+    return 0;
+  }
+
+  // Read in the entire module, and destroy the BitcodeReader.
+  if (M->MaterializeAllPermanently(ErrMsg)) {
+    delete M;
+    return 0;
+  }
+
+  return M;
+}
+
 std::string llvm::getBitcodeTargetTriple(MemoryBuffer *Buffer,
                                          LLVMContext& Context,
                                          std::string *ErrMsg) {
@@ -20,14 +20,54 @@
 #include "llvm/OperandTraits.h"
 #include "llvm/Bitcode/BitstreamReader.h"
 #include "llvm/Bitcode/LLVMBitCodes.h"
+#include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/Support/ValueHandle.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
 #include <vector>
 
 namespace llvm {
   class MemoryBuffer;
   class LLVMContext;
   
+//===----------------------------------------------------------------------===//
+//                          BitcodeReaderProfiler Class
+//===----------------------------------------------------------------------===//
+
+/// BitcodeReaderProfiler - Charges the time the reader spends to the block
+/// and record it is working on, for ProfileBitcodeFile.
+class BitcodeReaderProfiler {
+  BitcodeReadProfile &Profile;
+
+  struct Block {
+    BitcodeReadProfile::Entry *BlockEntry;
+    unsigned BlockID;
+    /// RecordEntry - The record being handled, or null before the first one.
+    BitcodeReadProfile::Entry *RecordEntry;
+  };
+
+  /// Stack - The blocks being read, innermost last.
+  SmallVector<Block, 8> Stack;
+
+  /// LastTime - When time was last charged to the innermost block.
+  uint64_t LastTime;
+
+public:
+  explicit BitcodeReaderProfiler(BitcodeReadProfile &P);
+
+  /// charge - Charge the time since the last call to the innermost block and
+  /// the record it is handling.
+  void charge();
+
+  void enterBlock(unsigned BlockID);
+  void exitBlock();
+
+  /// startRecord - Start charging time to the specified record of the
+  /// innermost block.  The time up to the last call to charge() has already
+  /// been charged to the previous record.
+  void startRecord(unsigned Code, bool Abbreviated);
+};
+
 //===----------------------------------------------------------------------===//
 //                          BitcodeReaderValueList Class
 //===----------------------------------------------------------------------===//
@@ -179,16 +219,21 @@ class BitcodeReader : public GVMaterializer {
   /// for compatibility.
   /// FIXME: Remove in LLVM 3.0.
   bool LLVM2_7MetadataDetected;
+
+  /// Profiler - If non-null, the time spent on each block and record is
+  /// charged to this.
+  BitcodeReaderProfiler *Profiler;
   
 public:
   explicit BitcodeReader(MemoryBuffer *buffer, LLVMContext &C)
     : Context(C), TheModule(0), Buffer(buffer), BufferOwned(false),
       ErrorString(0), ValueList(C), MDValueList(C),
-      LLVM2_7MetadataDetected(false) {
+      LLVM2_7MetadataDetected(false), Profiler(0) {
     HasReversedFunctionsWithBodies = false;
   }
   ~BitcodeReader() {
     FreeState();
+    delete Profiler;
   }
   
   void FreeState();
@@ -196,6 +241,12 @@ public:
   /// setBufferOwned - If this is true, the reader will destroy the MemoryBuffer
   /// when the reader is destroyed.
   void setBufferOwned(bool Owned) { BufferOwned = Owned; }
+
+  /// setProfile - Record the time spent on each block and record in Profile.
+  void setProfile(BitcodeReadProfile &Profile) {
+    delete Profiler;
+    Profiler = new BitcodeReaderProfiler(Profile);
+  }
   
   virtual bool isMaterializable(const GlobalValue *GV) const;
   virtual bool isDematerializable(const GlobalValue *GV) const;
@@ -217,6 +268,17 @@ public:
   /// @returns true if an error occurred.
   bool ParseTriple(std::string &Triple);
 private:
+  /// ReadRecord - Read a record from Stream, telling the profiler about it if
+  /// there is one.
+  unsigned ReadRecord(unsigned AbbrevID, SmallVectorImpl<uint64_t> &Vals) {
+    if (!Profiler)
+      return Stream.ReadRecord(AbbrevID, Vals);
+    Profiler->charge();
+    unsigned Code = Stream.ReadRecord(AbbrevID, Vals);
+    Profiler->startRecord(Code, AbbrevID != bitc::UNABBREV_RECORD);
+    return Code;
+  }
+
   const Type *getTypeByID(unsigned ID, bool isTypeTable = false);
   Value *getFnValueByID(unsigned ID, const Type *Ty) {
     if (Ty == Type::getMetadataTy(Context))
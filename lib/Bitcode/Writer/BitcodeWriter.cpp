@@ -19,17 +19,37 @@
 #include "llvm/DerivedTypes.h"
 #include "llvm/InlineAsm.h"
 #include "llvm/Instructions.h"
+#include "llvm/Metadata.h"
 #include "llvm/Module.h"
 #include "llvm/Operator.h"
 #include "llvm/TypeSymbolTable.h"
 #include "llvm/ValueSymbolTable.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Support/Atomic.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Program.h"
+#include "llvm/Support/Threading.h"
+#include <algorithm>
 #include <cctype>
 using namespace llvm;
 
+static cl::opt<unsigned>
+WriterThreads("bitcode-writer-threads", cl::Hidden, cl::init(1),
+              cl::desc("Number of threads used to encode function bodies"));
+
+static cl::opt<unsigned>
+FlushThreshold("bitcode-flush-threshold", cl::Hidden, cl::init(1024 * 1024),
+               cl::desc("Number of bytes to buffer before writing bitcode out "
+                        "to a seekable file"));
+
+static cl::opt<bool>
+SizeProfile("bitcode-size-profile", cl::Hidden,
+            cl::desc("Derive extra abbreviations from the module being written "
+                     "to make the bitcode smaller"));
+
 /// These are manifest constants used by the bitcode writer. They do not need to
 /// be kept in sync with the reader, but need to be consistent within this file.
 enum {
@@ -54,7 +74,8 @@ enum {
   FUNCTION_INST_CAST_ABBREV,
   FUNCTION_INST_RET_VOID_ABBREV,
   FUNCTION_INST_RET_VAL_ABBREV,
-  FUNCTION_INST_UNREACHABLE_ABBREV
+  FUNCTION_INST_UNREACHABLE_ABBREV,
+  FUNCTION_DEBUG_LOC_ABBREV   // Only defined by -bitcode-size-profile.
 };
 
 
@@ -479,10 +500,10 @@ static uint64_t GetOptimizationFlags(const Value *V) {
   return Flags;
 }
 
-static void WriteMDNode(const MDNode *N,
-                        const ValueEnumerator &VE,
-                        BitstreamWriter &Stream,
-                        SmallVector<uint64_t, 64> &Record) {
+/// GetMDNodeRecord - Append the [ty, val] pairs describing N's operands to
+/// Record.
+static void GetMDNodeRecord(const MDNode *N, const ValueEnumerator &VE,
+                            SmallVectorImpl<uint64_t> &Record) {
   for (unsigned i = 0, e = N->getNumOperands(); i != e; ++i) {
     if (N->getOperand(i)) {
       Record.push_back(VE.getTypeID(N->getOperand(i)->getType()));
@@ -492,12 +513,174 @@ static void WriteMDNode(const MDNode *N,
       Record.push_back(0);
     }
   }
-  unsigned MDCode = N->isFunctionLocal() ? bitc::METADATA_FN_NODE2 :
-                                           bitc::METADATA_NODE2;
-  Stream.EmitRecord(MDCode, Record, 0);
+}
+
+/// WriteMDNode - Emit a METADATA_NODE2 or METADATA_FN_NODE2 record for N,
+/// using NodeAbbrev for the former if it is non-zero.
+static void WriteMDNode(const MDNode *N,
+                        const ValueEnumerator &VE,
+                        BitstreamWriter &Stream,
+                        SmallVector<uint64_t, 64> &Record,
+                        unsigned NodeAbbrev = 0) {
+  GetMDNodeRecord(N, VE, Record);
+  if (N->isFunctionLocal())
+    Stream.EmitRecord(bitc::METADATA_FN_NODE2, Record, 0);
+  else
+    Stream.EmitRecord(bitc::METADATA_NODE2, Record, NodeAbbrev);
   Record.clear();
 }
 
+namespace {
+  /// OperandStats - A histogram of the number of bits needed by the values of
+  /// one record operand, from which -bitcode-size-profile picks the cheapest
+  /// encoding for that operand.
+  class OperandStats {
+    uint64_t NumValuesOfWidth[65];
+  public:
+    OperandStats() {
+      std::fill(NumValuesOfWidth, NumValuesOfWidth+65, 0);
+    }
+
+    void addValue(uint64_t V) {
+      ++NumValuesOfWidth[V ? Log2_64(V)+1 : 0];
+    }
+
+    /// getVBRBits - Return the total size of the values when emitted as VBRs
+    /// with the specified chunk size.
+    uint64_t getVBRBits(unsigned ChunkSize) const {
+      uint64_t Bits = 0;
+      for (unsigned Width = 0; Width != 65; ++Width) {
+        unsigned NumChunks = Width ? (Width+ChunkSize-2)/(ChunkSize-1) : 1;
+        Bits += NumValuesOfWidth[Width] * NumChunks * ChunkSize;
+      }
+      return Bits;
+    }
+
+    /// getCheapestEncoding - Return the Fixed or VBR encoding that makes the
+    /// values smallest, and set Bits to their total size with it.
+    BitCodeAbbrevOp getCheapestEncoding(uint64_t &Bits) const {
+      BitCodeAbbrevOp Best(BitCodeAbbrevOp::VBR, 6);
+      Bits = getVBRBits(6);
+      for (unsigned ChunkSize = 2; ChunkSize <= 32; ++ChunkSize) {
+        uint64_t VBRBits = getVBRBits(ChunkSize);
+        if (VBRBits < Bits) {
+          Best = BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, ChunkSize);
+          Bits = VBRBits;
+        }
+      }
+
+      // Fixed fields are read 32 bits at a time at most.
+      unsigned MaxWidth = 64;
+      while (MaxWidth > 1 && !NumValuesOfWidth[MaxWidth])
+        --MaxWidth;
+      if (MaxWidth <= 32) {
+        uint64_t NumValues = 0;
+        for (unsigned Width = 0; Width != 65; ++Width)
+          NumValues += NumValuesOfWidth[Width];
+        if (NumValues * MaxWidth < Bits) {
+          Best = BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, MaxWidth);
+          Bits = NumValues * MaxWidth;
+        }
+      }
+      return Best;
+    }
+  };
+}
+
+/// GetVBR6Bits - Return the number of bits an unabbreviated record spends on
+/// V, which it emits as a VBR6.
+static unsigned GetVBR6Bits(uint64_t V) {
+  unsigned Bits = 6;
+  for (; V >= 32; V >>= 5)
+    Bits += 6;
+  return Bits;
+}
+
+/// CreateProfiledAbbrev - Return an abbreviation for NumRecords records with
+/// the specified code whose operands have the given statistics, or null if it
+/// would not make the records smaller than emitting them unabbreviated.  If
+/// IsArray is true, the records are arrays and Ops[0] describes the elements.
+static BitCodeAbbrev *CreateProfiledAbbrev(unsigned Code,
+                                           const OperandStats *Ops,
+                                           unsigned NumOps, bool IsArray,
+                                           uint64_t NumRecords) {
+  if (NumRecords == 0)
+    return 0;
+
+  // An unabbreviated record spends a VBR6 on its code, its operand count and
+  // each operand.  An array abbreviation emits the count as a VBR6 as well.
+  uint64_t UnabbrevBits = NumRecords * GetVBR6Bits(Code);
+  if (!IsArray)
+    UnabbrevBits += NumRecords * GetVBR6Bits(NumOps);
+
+  uint64_t AbbrevBits = 0;
+  BitCodeAbbrev *Abbv = new BitCodeAbbrev();
+  Abbv->Add(BitCodeAbbrevOp(Code));
+  if (IsArray)
+    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Array));
+  for (unsigned i = 0; i != NumOps; ++i) {
+    uint64_t Bits;
+    Abbv->Add(Ops[i].getCheapestEncoding(Bits));
+    AbbrevBits += Bits;
+    UnabbrevBits += Ops[i].getVBRBits(6);
+  }
+
+  if (AbbrevBits < UnabbrevBits)
+    return Abbv;
+  Abbv->dropRef();
+  return 0;
+}
+
+/// CreateMDNodeAbbrev - Return an abbreviation for the METADATA_NODE2 records
+/// WriteModuleMetadata will emit, or null if it would not make them smaller.
+static BitCodeAbbrev *CreateMDNodeAbbrev(const ValueEnumerator &VE) {
+  const ValueEnumerator::ValueList &Vals = VE.getMDValues();
+  OperandStats Elts;
+  uint64_t NumRecords = 0;
+  SmallVector<uint64_t, 64> Record;
+  for (unsigned i = 0, e = Vals.size(); i != e; ++i)
+    if (const MDNode *N = dyn_cast<MDNode>(Vals[i].first))
+      if (!N->isFunctionLocal()) {
+        GetMDNodeRecord(N, VE, Record);
+        for (unsigned j = 0, je = Record.size(); j != je; ++j)
+          Elts.addValue(Record[j]);
+        Record.clear();
+        ++NumRecords;
+      }
+  return CreateProfiledAbbrev(bitc::METADATA_NODE2, &Elts, 1, true,
+                              NumRecords);
+}
+
+/// CreateDebugLocAbbrev - Return an abbreviation for the DEBUG_LOC2 records
+/// WriteFunction will emit for the functions in M, or null if it would not
+/// make them smaller.
+static BitCodeAbbrev *CreateDebugLocAbbrev(const Module *M,
+                                           const ValueEnumerator &VE) {
+  OperandStats Ops[4];
+  uint64_t NumRecords = 0;
+  for (Module::const_iterator F = M->begin(), FE = M->end(); F != FE; ++F) {
+    DebugLoc LastDL;
+    for (Function::const_iterator BB = F->begin(), E = F->end(); BB != E; ++BB)
+      for (BasicBlock::const_iterator I = BB->begin(), E = BB->end();
+           I != E; ++I) {
+        DebugLoc DL = I->getDebugLoc();
+        if (DL.isUnknown() || DL == LastDL)
+          continue;
+
+        MDNode *Scope, *IA;
+        DL.getScopeAndInlinedAt(Scope, IA, I->getContext());
+        Ops[0].addValue(DL.getLine());
+        Ops[1].addValue(DL.getCol());
+        Ops[2].addValue(Scope ? VE.getValueID(Scope)+1 : 0);
+        Ops[3].addValue(IA ? VE.getValueID(IA)+1 : 0);
+        ++NumRecords;
+        LastDL = DL;
+      }
+  }
+  return CreateProfiledAbbrev(bitc::FUNC_CODE_DEBUG_LOC2, Ops, 4, false,
+                              NumRecords);
+}
+
 static void WriteModuleMetadata(const Module *M,
                                 const ValueEnumerator &VE,
                                 BitstreamWriter &Stream) {
@@ -505,6 +688,12 @@ static void WriteModuleMetadata(const Module *M,
   bool StartedMetadataBlock = false;
   unsigned MDSAbbrev = 0;
   SmallVector<uint64_t, 64> Record;
+
+  // The abbrev for METADATA_NODE2 is defined right before the first such
+  // record.
+  BitCodeAbbrev *NodeAbbv = SizeProfile ? CreateMDNodeAbbrev(VE) : 0;
+  unsigned NodeAbbrev = 0;
+
   for (unsigned i = 0, e = Vals.size(); i != e; ++i) {
 
     if (const MDNode *N = dyn_cast<MDNode>(Vals[i].first)) {
@@ -513,7 +702,11 @@ static void WriteModuleMetadata(const Module *M,
           Stream.EnterSubblock(bitc::METADATA_BLOCK_ID, 3);
           StartedMetadataBlock = true;
         }
-        WriteMDNode(N, VE, Stream, Record);
+        if (NodeAbbv && !N->isFunctionLocal()) {
+          NodeAbbrev = Stream.EmitAbbrev(NodeAbbv);
+          NodeAbbv = 0;
+        }
+        WriteMDNode(N, VE, Stream, Record, NodeAbbrev);
       }
     } else if (const MDString *MDS = dyn_cast<MDString>(Vals[i].first)) {
       if (!StartedMetadataBlock)  {
@@ -1206,9 +1399,11 @@ static void WriteValueSymbolTable(const ValueSymbolTable &VST,
   Stream.ExitBlock();
 }
 
-/// WriteFunction - Emit a function body to the module stream.
+/// WriteFunction - Emit a function body to the module stream.  If
+/// DebugLocAbbrev is non-zero, it is used for DEBUG_LOC2 records.
 static void WriteFunction(const Function &F, ValueEnumerator &VE,
-                          BitstreamWriter &Stream) {
+                          BitstreamWriter &Stream,
+                          unsigned DebugLocAbbrev = 0) {
   Stream.EnterSubblock(bitc::FUNCTION_BLOCK_ID, 4);
   VE.incorporateFunction(F);
 
@@ -1262,7 +1457,7 @@ static void WriteFunction(const Function &F, ValueEnumerator &VE,
         Vals.push_back(DL.getCol());
         Vals.push_back(Scope ? VE.getValueID(Scope)+1 : 0);
         Vals.push_back(IA ? VE.getValueID(IA)+1 : 0);
-        Stream.EmitRecord(bitc::FUNC_CODE_DEBUG_LOC2, Vals);
+        Stream.EmitRecord(bitc::FUNC_CODE_DEBUG_LOC2, Vals, DebugLocAbbrev);
         Vals.clear();
         
         LastDL = DL;
@@ -1319,7 +1514,10 @@ static void WriteTypeSymbolTable(const TypeSymbolTable &TST,
 }
 
 // Emit blockinfo, which defines the standard abbreviations etc.
-static void WriteBlockInfo(const ValueEnumerator &VE, BitstreamWriter &Stream) {
+/// WriteBlockInfo - Emit the BLOCKINFO block.  If DebugLocAbbv is non-null, it
+/// is added to FUNCTION_BLOCK as FUNCTION_DEBUG_LOC_ABBREV.
+static void WriteBlockInfo(const ValueEnumerator &VE, BitstreamWriter &Stream,
+                           BitCodeAbbrev *DebugLocAbbv) {
   // We only want to emit block info records for blocks that have multiple
   // instances: CONSTANTS_BLOCK, FUNCTION_BLOCK and VALUE_SYMTAB_BLOCK.  Other
   // blocks can defined their abbrevs inline.
@@ -1475,11 +1673,141 @@ static void WriteBlockInfo(const ValueEnumerator &VE, BitstreamWriter &Stream) {
                                    Abbv) != FUNCTION_INST_UNREACHABLE_ABBREV)
       llvm_unreachable("Unexpected abbrev ordering!");
   }
+  if (DebugLocAbbv) { // DEBUG_LOC2 abbrev for FUNCTION_BLOCK.
+    if (Stream.EmitBlockInfoAbbrev(bitc::FUNCTION_BLOCK_ID,
+                                   DebugLocAbbv) != FUNCTION_DEBUG_LOC_ABBREV)
+      llvm_unreachable("Unexpected abbrev ordering!");
+  }
 
   Stream.ExitBlock();
 }
 
 
+namespace {
+  /// FunctionWriterThread - The private state of one thread encoding function
+  /// blocks for WriteFunctionsInParallel.
+  struct FunctionWriterThread {
+    /// Functions, Blocks, NextFunction - Shared by all threads.  Each thread
+    /// claims the next function to encode by incrementing NextFunction, and
+    /// encodes Functions[i] into Blocks[i].
+    const std::vector<const Function*> &Functions;
+    std::vector<std::vector<unsigned char> > &Blocks;
+    volatile sys::cas_flag &NextFunction;
+    unsigned DebugLocAbbrev;
+
+    /// VE - This thread's copy of the module-level value numbering, which it
+    /// incorporates each function into in turn.
+    ValueEnumerator VE;
+
+    std::vector<unsigned char> Buffer;
+    BitstreamWriter Stream;
+
+    FunctionWriterThread(const std::vector<const Function*> &functions,
+                         std::vector<std::vector<unsigned char> > &blocks,
+                         volatile sys::cas_flag &nextFunction,
+                         unsigned debugLocAbbrev,
+                         const ValueEnumerator &ve,
+                         const BitstreamWriter &ModuleStream)
+      : Functions(functions), Blocks(blocks), NextFunction(nextFunction),
+        DebugLocAbbrev(debugLocAbbrev), VE(ve), Stream(Buffer) {
+      Stream.CopyBlockInfoFrom(ModuleStream);
+    }
+  };
+}
+
+static void EncodeFunctionBlocks(void *Arg) {
+  FunctionWriterThread &T = *static_cast<FunctionWriterThread*>(Arg);
+  while (1) {
+    unsigned i = sys::AtomicIncrement(&T.NextFunction) - 1;
+    if (i >= T.Functions.size())
+      return;
+    WriteFunction(*T.Functions[i], T.VE, T.Stream, T.DebugLocAbbrev);
+    T.Buffer.swap(T.Blocks[i]);
+  }
+}
+
+/// ResolveForwardedTypes - Call getType() on every value that encoding the
+/// body of F reads the type of.  A value whose abstract type was refined still
+/// points at the old type until getType() is first called on it, which then
+/// moves the value over to the new type, updating the reference counts of
+/// both.  Those counts are not atomic, so this must be done before threads
+/// share the values.
+static void ResolveForwardedTypes(const Function &F) {
+  SmallPtrSet<const Value*, 64> Visited;
+  SmallVector<const Value*, 64> Worklist;
+  Worklist.push_back(&F);
+  for (Function::const_arg_iterator I = F.arg_begin(), E = F.arg_end();
+       I != E; ++I)
+    Worklist.push_back(I);
+  for (Function::const_iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+    for (BasicBlock::const_iterator I = BB->begin(), E = BB->end(); I!=E; ++I) {
+      Worklist.push_back(I);
+      SmallVector<std::pair<unsigned, MDNode*>, 8> MDs;
+      I->getAllMetadataOtherThanDebugLoc(MDs);
+      for (unsigned i = 0, e = MDs.size(); i != e; ++i)
+        Worklist.push_back(MDs[i].second);
+    }
+
+  // Constants and metadata are encoded along with their operands, but the
+  // bodies of globals are not part of the function block.
+  while (!Worklist.empty()) {
+    const Value *V = Worklist.pop_back_val();
+    if (!Visited.insert(V))
+      continue;
+    (void)V->getType();
+    if (const User *U = dyn_cast<User>(V)) {
+      if (isa<Instruction>(U) || (isa<Constant>(U) && !isa<GlobalValue>(U)))
+        for (User::const_op_iterator OI = U->op_begin(), E = U->op_end();
+             OI != E; ++OI)
+          Worklist.push_back(*OI);
+    } else if (const MDNode *N = dyn_cast<MDNode>(V)) {
+      for (unsigned i = 0, e = N->getNumOperands(); i != e; ++i)
+        if (const Value *Op = N->getOperand(i))
+          Worklist.push_back(Op);
+    }
+  }
+}
+
+/// WriteFunctionsInParallel - Emit the bodies of all function definitions in
+/// M, encoding them on NumThreads threads at once.  A function block only
+/// reads the IR and the module-level part of the value numbering, so each
+/// thread gets its own copy of VE and BLOCKINFO abbrevs, and the finished
+/// blocks are emitted in module order, identical to what WriteFunction emits.
+/// Forwarded types are resolved first, as reading a value's type may write to
+/// it otherwise.
+static void WriteFunctionsInParallel(const Module *M, const ValueEnumerator &VE,
+                                     BitstreamWriter &Stream,
+                                     unsigned DebugLocAbbrev,
+                                     unsigned NumThreads) {
+  std::vector<const Function*> Functions;
+  for (Module::const_iterator I = M->begin(), E = M->end(); I != E; ++I)
+    if (!I->isDeclaration()) {
+      ResolveForwardedTypes(*I);
+      Functions.push_back(I);
+    }
+
+  if (NumThreads > Functions.size())
+    NumThreads = Functions.size();
+
+  std::vector<std::vector<unsigned char> > Blocks(Functions.size());
+  volatile sys::cas_flag NextFunction = 0;
+  std::vector<void*> Threads;
+  for (unsigned i = 0; i != NumThreads; ++i)
+    Threads.push_back(new FunctionWriterThread(Functions, Blocks, NextFunction,
+                                               DebugLocAbbrev, VE, Stream));
+
+  if (NumThreads)
+    llvm_execute_on_threads(EncodeFunctionBlocks, &Threads[0], NumThreads);
+
+  for (unsigned i = 0; i != NumThreads; ++i)
+    delete static_cast<FunctionWriterThread*>(Threads[i]);
+
+  for (unsigned i = 0, e = Functions.size(); i != e; ++i) {
+    Stream.EmitEncodedSubblock(bitc::FUNCTION_BLOCK_ID, 4, Blocks[i]);
+    std::vector<unsigned char>().swap(Blocks[i]);
+  }
+}
+
 /// WriteModule - Emit the specified module to the bitstream.
 static void WriteModule(const Module *M, BitstreamWriter &Stream) {
   Stream.EnterSubblock(bitc::MODULE_BLOCK_ID, 3);
@@ -1494,8 +1822,11 @@ static void WriteModule(const Module *M, BitstreamWriter &Stream) {
   // Analyze the module, enumerating globals, functions, etc.
   ValueEnumerator VE(M);
 
-  // Emit blockinfo, which defines the standard abbreviations etc.
-  WriteBlockInfo(VE, Stream);
+  // Emit blockinfo, which defines the standard abbreviations etc.  The size
+  // profile adds one for debug locations if that makes them smaller.
+  BitCodeAbbrev *DebugLocAbbv = SizeProfile ? CreateDebugLocAbbrev(M, VE) : 0;
+  unsigned DebugLocAbbrev = DebugLocAbbv ? FUNCTION_DEBUG_LOC_ABBREV : 0;
+  WriteBlockInfo(VE, Stream, DebugLocAbbv);
 
   // Emit information about parameter attributes.
   WriteAttributeTable(VE, Stream);
@@ -1514,9 +1845,12 @@ static void WriteModule(const Module *M, BitstreamWriter &Stream) {
   WriteModuleMetadata(M, VE, Stream);
 
   // Emit function bodies.
-  for (Module::const_iterator I = M->begin(), E = M->end(); I != E; ++I)
-    if (!I->isDeclaration())
-      WriteFunction(*I, VE, Stream);
+  if (WriterThreads > 1)
+    WriteFunctionsInParallel(M, VE, Stream, DebugLocAbbrev, WriterThreads);
+  else
+    for (Module::const_iterator I = M->begin(), E = M->end(); I != E; ++I)
+      if (!I->isDeclaration())
+        WriteFunction(*I, VE, Stream, DebugLocAbbrev);
 
   // Emit metadata.
   WriteModuleMetadataStore(M, Stream);
@@ -1645,6 +1979,23 @@ void llvm::WriteBitcodeToFile(const Module *M, raw_ostream &Out) {
   Out.write((char*)&Buffer.front(), Buffer.size());
 }
 
+/// WriteBitcodeToFile - Write the specified module to the specified file
+/// stream, streaming completed blocks out if the file supports seeking.
+void llvm::WriteBitcodeToFile(const Module *M, raw_fd_ostream &Out) {
+  if (!Out.supportsSeeking()) {
+    WriteBitcodeToFile(M, static_cast<raw_ostream&>(Out));
+    return;
+  }
+
+  std::vector<unsigned char> Buffer;
+  BitstreamWriter Stream(Buffer, &Out, FlushThreshold);
+
+  WriteBitcodeToStream(M, Stream);
+
+  // Write out whatever is left after the last flush.
+  Stream.FlushToFile();
+}
+
 /// WriteBitcodeToStream - Write the specified module to the specified output
 /// stream.
 void llvm::WriteBitcodeToStream(const Module *M, BitstreamWriter &Stream) {
@@ -1668,5 +2019,5 @@ void llvm::WriteBitcodeToStream(const Module *M, BitstreamWriter &Stream) {
   WriteModule(M, Stream);
 
   if (isMacho)
-    EmitDarwinBCTrailer(Stream, Stream.getBuffer().size());
+    EmitDarwinBCTrailer(Stream, Stream.GetBufferOffset());
 }
@@ -80,7 +80,9 @@ private:
   unsigned FirstFuncConstantID;
   unsigned FirstInstID;
   
-  ValueEnumerator(const ValueEnumerator &);  // DO NOT IMPLEMENT
+  // The implicit copy constructor is used on purpose: copying an enumerator
+  // while no function is incorporated gives an independent copy of the
+  // module-level numbering, one per thread that encodes function bodies.
   void operator=(const ValueEnumerator &);   // DO NOT IMPLEMENT
 public:
   ValueEnumerator(const Module *M);
@@ -35,7 +35,9 @@ ScheduleDAGInstrs::ScheduleDAGInstrs(MachineFunction &mf,
                                      const MachineDominatorTree &mdt)
   : ScheduleDAG(mf), MLI(mli), MDT(mdt), MFI(mf.getFrameInfo()),
     InstrItins(mf.getTarget().getInstrItineraryData()),
-    Defs(TRI->getNumRegs()), Uses(TRI->getNumRegs()), LoopRegs(MLI, MDT) {
+    LoopRegs(MLI, MDT) {
+  Defs.setUniverse(TRI->getNumRegs());
+  Uses.setUniverse(TRI->getNumRegs());
   DbgValueVec.clear();
 }
 
@@ -165,7 +167,7 @@ void ScheduleDAGInstrs::AddSchedBarrierDeps() {
       if (Reg == 0) continue;
 
       assert(TRI->isPhysicalRegister(Reg) && "Virtual register encountered!");
-      Uses[Reg].push_back(&ExitSU);
+      Uses.insert(PhysRegSUOper(&ExitSU, Reg));
     }
   } else {
     // For others, e.g. fallthrough, conditional branch, assume the exit
@@ -177,7 +179,7 @@ void ScheduleDAGInstrs::AddSchedBarrierDeps() {
              E = (*SI)->livein_end(); I != E; ++I) {    
         unsigned Reg = *I;
         if (Seen.insert(Reg))
-          Uses[Reg].push_back(&ExitSU);
+          Uses.insert(PhysRegSUOper(&ExitSU, Reg));
       }
   }
 }
@@ -263,8 +265,6 @@ void ScheduleDAGInstrs::BuildSchedGraph(AliasAnalysis *AA) {
         DanglingDebugValue[Reg] = std::make_pair((MachineInstr*)0, 0);
       }
 
-      std::vector<SUnit *> &UseList = Uses[Reg];
-      std::vector<SUnit *> &DefList = Defs[Reg];
       // Optionally add output and anti dependencies. For anti
       // dependencies we use a latency of 0 because for a multi-issue
       // target we want to allow the defining instruction to issue
@@ -273,8 +273,9 @@ void ScheduleDAGInstrs::BuildSchedGraph(AliasAnalysis *AA) {
       //       there's no cost for reusing registers.
       SDep::Kind Kind = MO.isUse() ? SDep::Anti : SDep::Output;
       unsigned AOLatency = (Kind == SDep::Anti) ? 0 : 1;
-      for (unsigned i = 0, e = DefList.size(); i != e; ++i) {
-        SUnit *DefSU = DefList[i];
+      for (Reg2SUnitsMap::iterator I = Defs.find(Reg), E = Defs.end();
+           I != E; ++I) {
+        SUnit *DefSU = I->SU;
         if (DefSU == &ExitSU)
           continue;
         if (DefSU != SU &&
@@ -283,9 +284,9 @@ void ScheduleDAGInstrs::BuildSchedGraph(AliasAnalysis *AA) {
           DefSU->addPred(SDep(SU, Kind, AOLatency, /*Reg=*/Reg));
       }
       for (const unsigned *Alias = TRI->getAliasSet(Reg); *Alias; ++Alias) {
-        std::vector<SUnit *> &DefList = Defs[*Alias];
-        for (unsigned i = 0, e = DefList.size(); i != e; ++i) {
-          SUnit *DefSU = DefList[i];
+        for (Reg2SUnitsMap::iterator I = Defs.find(*Alias), E = Defs.end();
+             I != E; ++I) {
+          SUnit *DefSU = I->SU;
           if (DefSU == &ExitSU)
             continue;
           if (DefSU != SU &&
@@ -298,8 +299,9 @@ void ScheduleDAGInstrs::BuildSchedGraph(AliasAnalysis *AA) {
       if (MO.isDef()) {
         // Add any data dependencies.
         unsigned DataLatency = SU->Latency;
-        for (unsigned i = 0, e = UseList.size(); i != e; ++i) {
-          SUnit *UseSU = UseList[i];
+        for (Reg2SUnitsMap::iterator I = Uses.find(Reg), E = Uses.end();
+             I != E; ++I) {
+          SUnit *UseSU = I->SU;
           if (UseSU == SU)
             continue;
           unsigned LDataLatency = DataLatency;
@@ -332,9 +334,9 @@ void ScheduleDAGInstrs::BuildSchedGraph(AliasAnalysis *AA) {
           UseSU->addPred(dep);
         }
         for (const unsigned *Alias = TRI->getAliasSet(Reg); *Alias; ++Alias) {
-          std::vector<SUnit *> &UseList = Uses[*Alias];
-          for (unsigned i = 0, e = UseList.size(); i != e; ++i) {
-            SUnit *UseSU = UseList[i];
+          for (Reg2SUnitsMap::iterator I = Uses.find(*Alias), E = Uses.end();
+               I != E; ++I) {
+            SUnit *UseSU = I->SU;
             if (UseSU == SU)
               continue;
             const SDep& dep = SDep(SU, SDep::Data, DataLatency, *Alias);
@@ -348,7 +350,7 @@ void ScheduleDAGInstrs::BuildSchedGraph(AliasAnalysis *AA) {
 
         // If a def is going to wrap back around to the top of the loop,
         // backschedule it.
-        if (!UnitLatencies && DefList.empty()) {
+        if (!UnitLatencies && !Defs.contains(Reg)) {
           LoopDependencies::LoopDeps::iterator I = LoopRegs.Deps.find(Reg);
           if (I != LoopRegs.Deps.end()) {
             const MachineOperand *UseMO = I->second.first;
@@ -390,12 +392,12 @@ void ScheduleDAGInstrs::BuildSchedGraph(AliasAnalysis *AA) {
           }
         }
 
-        UseList.clear();
+        Uses.eraseAll(Reg);
         if (!MO.isDead())
-          DefList.clear();
-        DefList.push_back(SU);
+          Defs.eraseAll(Reg);
+        Defs.insert(PhysRegSUOper(SU, Reg));
       } else {
-        UseList.push_back(SU);
+        Uses.insert(PhysRegSUOper(SU, Reg));
       }
     }
 
@@ -547,10 +549,8 @@ void ScheduleDAGInstrs::BuildSchedGraph(AliasAnalysis *AA) {
     }
   }
 
-  for (int i = 0, e = TRI->getNumRegs(); i != e; ++i) {
-    Defs[i].clear();
-    Uses[i].clear();
-  }
+  Defs.clear();
+  Uses.clear();
   PendingLoads.clear();
 }
 
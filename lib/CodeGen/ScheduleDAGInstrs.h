@@ -21,6 +21,7 @@
 #include "llvm/Support/Compiler.h"
 #include "llvm/Target/TargetRegisterInfo.h"
 #include "llvm/ADT/SmallSet.h"
+#include "llvm/ADT/SparseSet.h"
 #include <map>
 
 namespace llvm {
@@ -95,6 +96,17 @@ namespace llvm {
     }
   };
 
+  /// PhysRegSUOper - An SUnit defining or using a physical register, stored
+  /// in a SparseMultiSet keyed by the register.
+  struct PhysRegSUOper {
+    SUnit *SU;
+    unsigned Reg;
+
+    PhysRegSUOper(SUnit *su, unsigned R) : SU(su), Reg(R) {}
+
+    unsigned getSparseSetIndex() const { return Reg; }
+  };
+
   /// ScheduleDAGInstrs - A ScheduleDAG subclass for scheduling lists of
   /// MachineInstrs.
   class LLVM_LIBRARY_VISIBILITY ScheduleDAGInstrs : public ScheduleDAG {
@@ -106,9 +118,11 @@ namespace llvm {
     /// Defs, Uses - Remember where defs and uses of each physical register
     /// are as we iterate upward through the instructions. This is allocated
     /// here instead of inside BuildSchedGraph to avoid the need for it to be
-    /// initialized and destructed for each block.
-    std::vector<std::vector<SUnit *> > Defs;
-    std::vector<std::vector<SUnit *> > Uses;
+    /// initialized and destructed for each block. Only the registers seen in
+    /// a region are touched, and clearing them at the end is constant time.
+    typedef SparseMultiSet<PhysRegSUOper> Reg2SUnitsMap;
+    Reg2SUnitsMap Defs;
+    Reg2SUnitsMap Uses;
  
     /// DbgValueVec - Remember DBG_VALUEs that refer to a particular
     /// register.
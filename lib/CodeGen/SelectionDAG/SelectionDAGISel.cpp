@@ -73,6 +73,10 @@ EnableFastISelVerbose("fast-isel-verbose", cl::Hidden,
 static cl::opt<bool>
 EnableFastISelAbort("fast-isel-abort", cl::Hidden,
           cl::desc("Enable abort calls when \"fast\" instruction fails"));
+static cl::opt<bool>
+UseMatcherTable("use-isel-matcher-table", cl::Hidden,
+          cl::desc("Select instructions with the matcher table even if the "
+                   "selector was built with -dag-isel-direct-dispatch"));
 
 #ifndef NDEBUG
 static cl::opt<bool>
@@ -1995,28 +1999,28 @@ struct MatchScope {
   /// NodeStack - The node stack when the scope was formed.
   SmallVector<SDValue, 4> NodeStack;
 
-  /// NumRecordedNodes - The number of recorded nodes when the scope was formed.
-  unsigned NumRecordedNodes;
-
-  /// NumMatchedMemRefs - The number of matched memref entries.
-  unsigned NumMatchedMemRefs;
+  /// State - The recorded nodes, memrefs, chain and glue when the scope was
+  /// formed.
+  SelectionDAGISel::MatchState::Checkpoint State;
 
-  /// InputChain/InputGlue - The current chain/glue
-  SDValue InputChain, InputGlue;
-
-  /// HasChainNodesMatched - True if the ChainNodesMatched list is non-empty.
-  bool HasChainNodesMatched, HasGlueResultNodesMatched;
+  MatchScope(unsigned FailIndex, const SmallVectorImpl<SDValue> &NodeStack,
+             const SelectionDAGISel::MatchState &S)
+    : FailIndex(FailIndex), NodeStack(NodeStack.begin(), NodeStack.end()),
+      State(S) {}
 };
 
 }
 
-SDNode *SelectionDAGISel::
-SelectCodeCommon(SDNode *NodeToMatch, const unsigned char *MatcherTable,
-                 unsigned TableSize) {
+bool SelectionDAGISel::useMatcherTable() {
+  return UseMatcherTable;
+}
+
+bool SelectionDAGISel::SelectSpecialNode(SDNode *NodeToMatch,
+                                         SDNode *&Result) {
   // FIXME: Should these even be selected?  Handle these cases in the caller?
   switch (NodeToMatch->getOpcode()) {
   default:
-    break;
+    return false;
   case ISD::EntryToken:       // These nodes remain the same.
   case ISD::BasicBlock:
   case ISD::Register:
@@ -2038,15 +2042,265 @@ SelectCodeCommon(SDNode *NodeToMatch, const unsigned char *MatcherTable,
   case ISD::CopyToReg:
   case ISD::EH_LABEL:
     NodeToMatch->setNodeId(-1); // Mark selected.
-    return 0;
+    Result = 0;
+    return true;
   case ISD::AssertSext:
   case ISD::AssertZext:
     CurDAG->ReplaceAllUsesOfValueWith(SDValue(NodeToMatch, 0),
                                       NodeToMatch->getOperand(0));
-    return 0;
-  case ISD::INLINEASM: return Select_INLINEASM(NodeToMatch);
-  case ISD::UNDEF:     return Select_UNDEF(NodeToMatch);
+    Result = 0;
+    return true;
+  case ISD::INLINEASM:
+    Result = Select_INLINEASM(NodeToMatch);
+    return true;
+  case ISD::UNDEF:
+    Result = Select_UNDEF(NodeToMatch);
+    return true;
   }
+}
+
+void SelectionDAGISel::CaptureGlueInput(MatchState &S, SDValue N) {
+  // If the current node has an input glue, capture it in InputGlue.
+  if (N->getNumOperands() != 0 &&
+      N->getOperand(N->getNumOperands()-1).getValueType() == MVT::Glue)
+    S.InputGlue = N->getOperand(N->getNumOperands()-1);
+}
+
+bool SelectionDAGISel::IsFoldableChainNode(MatchState &S,
+                                           const SDValue *NodeStack,
+                                           unsigned StackSize) {
+  assert(StackSize > 1 && "No parent node");
+  // Verify that all intermediate nodes between the root and this one have
+  // a single use.
+  for (unsigned i = 1, e = StackSize-1; i != e; ++i)
+    if (!NodeStack[i].hasOneUse())
+      return false;
+
+  // Check to see that the target thinks this is profitable to fold and that
+  // we can fold it without inducing cycles in the graph.
+  SDValue N = NodeStack[StackSize-1];
+  SDNode *Parent = NodeStack[StackSize-2].getNode();
+  return IsProfitableToFold(N, Parent, S.NodeToMatch) &&
+         IsLegalToFold(N, Parent, S.NodeToMatch, OptLevel,
+                       true/*We validate our own chains*/);
+}
+
+void SelectionDAGISel::EmitConvertToTarget(MatchState &S, unsigned RecNo) {
+  // Convert from IMM/FPIMM to target version.
+  assert(RecNo < S.RecordedNodes.size() && "Invalid CheckSame");
+  SDValue Imm = S.RecordedNodes[RecNo].first;
+
+  if (Imm->getOpcode() == ISD::Constant) {
+    int64_t Val = cast<ConstantSDNode>(Imm)->getZExtValue();
+    Imm = CurDAG->getTargetConstant(Val, Imm.getValueType());
+  } else if (Imm->getOpcode() == ISD::ConstantFP) {
+    const ConstantFP *Val=cast<ConstantFPSDNode>(Imm)->getConstantFPValue();
+    Imm = CurDAG->getTargetConstantFP(*Val, Imm.getValueType());
+  }
+
+  S.record(Imm, S.RecordedNodes[RecNo].second);
+}
+
+bool SelectionDAGISel::EmitMergeInputChains(MatchState &S,
+                                            const unsigned *RecNos,
+                                            unsigned NumRecNos) {
+  assert(S.InputChain.getNode() == 0 &&
+         "EmitMergeInputChains should be the first chain producing node");
+  // This node gets a list of nodes we matched in the input that have
+  // chains.  We want to token factor all of the input chains to these nodes
+  // together.  However, if any of the input chains is actually one of the
+  // nodes matched in this pattern, then we have an intra-match reference.
+  // Ignore these because the newly token factored chain should not refer to
+  // the old nodes.
+  assert(NumRecNos != 0 && "Can't TF zero chains");
+
+  assert(S.ChainNodesMatched.empty() &&
+         "Should only have one EmitMergeInputChains per match");
+
+  // Read all of the chained nodes.
+  for (unsigned i = 0; i != NumRecNos; ++i) {
+    unsigned RecNo = RecNos[i];
+    assert(RecNo < S.RecordedNodes.size() && "Invalid CheckSame");
+    S.ChainNodesMatched.push_back(S.RecordedNodes[RecNo].first.getNode());
+
+    // FIXME: What if other value results of the node have uses not matched
+    // by this pattern?
+    if (S.ChainNodesMatched.back() != S.NodeToMatch &&
+        !S.RecordedNodes[RecNo].first.hasOneUse()) {
+      S.ChainNodesMatched.clear();
+      return false;
+    }
+  }
+
+  // Merge the input chains if they are not intra-pattern references.
+  S.InputChain = HandleMergeInputChains(S.ChainNodesMatched, CurDAG);
+
+  return S.InputChain.getNode() != 0;  // False if we failed to merge.
+}
+
+void SelectionDAGISel::EmitCopyToReg(MatchState &S, SDValue Val,
+                                     unsigned DestPhysReg) {
+  if (S.InputChain.getNode() == 0)
+    S.InputChain = CurDAG->getEntryNode();
+
+  S.InputChain = CurDAG->getCopyToReg(S.InputChain,
+                                      S.NodeToMatch->getDebugLoc(),
+                                      DestPhysReg, Val, S.InputGlue);
+
+  S.InputGlue = S.InputChain.getValue(1);
+}
+
+SDNode *SelectionDAGISel::
+EmitMatchedNode(MatchState &S, bool IsMorphNodeTo, unsigned TargetOpc,
+                unsigned EmitNodeInfo, const MVT::SimpleValueType *ResultVTs,
+                unsigned NumVTs, const SDValue *Operands,
+                unsigned NumOperands) {
+  SDNode *NodeToMatch = S.NodeToMatch;
+
+  // Get the result VT list.
+  SmallVector<EVT, 4> VTs;
+  for (unsigned i = 0; i != NumVTs; ++i) {
+    MVT::SimpleValueType VT = ResultVTs[i];
+    if (VT == MVT::iPTR) VT = TLI.getPointerTy().SimpleTy;
+    VTs.push_back(VT);
+  }
+
+  if (EmitNodeInfo & OPFL_Chain)
+    VTs.push_back(MVT::Other);
+  if (EmitNodeInfo & OPFL_GlueOutput)
+    VTs.push_back(MVT::Glue);
+
+  // This is hot code, so optimize the two most common cases of 1 and 2
+  // results.
+  SDVTList VTList;
+  if (VTs.size() == 1)
+    VTList = CurDAG->getVTList(VTs[0]);
+  else if (VTs.size() == 2)
+    VTList = CurDAG->getVTList(VTs[0], VTs[1]);
+  else
+    VTList = CurDAG->getVTList(VTs.data(), VTs.size());
+
+  // Get the operand list.
+  SmallVector<SDValue, 8> Ops(Operands, Operands+NumOperands);
+
+  // If there are variadic operands to add, handle them now.
+  if (EmitNodeInfo & OPFL_VariadicInfo) {
+    // Determine the start index to copy from.
+    unsigned FirstOpToCopy = getNumFixedFromVariadicInfo(EmitNodeInfo);
+    FirstOpToCopy += (EmitNodeInfo & OPFL_Chain) ? 1 : 0;
+    assert(NodeToMatch->getNumOperands() >= FirstOpToCopy &&
+           "Invalid variadic node");
+    // Copy all of the variadic operands, not including a potential glue
+    // input.
+    for (unsigned i = FirstOpToCopy, e = NodeToMatch->getNumOperands();
+         i != e; ++i) {
+      SDValue V = NodeToMatch->getOperand(i);
+      if (V.getValueType() == MVT::Glue) break;
+      Ops.push_back(V);
+    }
+  }
+
+  // If this has chain/glue inputs, add them.
+  if (EmitNodeInfo & OPFL_Chain)
+    Ops.push_back(S.InputChain);
+  if ((EmitNodeInfo & OPFL_GlueInput) && S.InputGlue.getNode() != 0)
+    Ops.push_back(S.InputGlue);
+
+  // Create the node.
+  SDNode *Res = 0;
+  if (!IsMorphNodeTo) {
+    // If this is a normal EmitNode command, just create the new node and
+    // add the results to the RecordedNodes list.
+    Res = CurDAG->getMachineNode(TargetOpc, NodeToMatch->getDebugLoc(),
+                                 VTList, Ops.data(), Ops.size());
+
+    // Add all the non-glue/non-chain results to the RecordedNodes list.
+    for (unsigned i = 0, e = VTs.size(); i != e; ++i) {
+      if (VTs[i] == MVT::Other || VTs[i] == MVT::Glue) break;
+      S.record(SDValue(Res, i), 0);
+    }
+
+  } else {
+    Res = MorphNode(NodeToMatch, TargetOpc, VTList, Ops.data(), Ops.size(),
+                    EmitNodeInfo);
+  }
+
+  // If the node had chain/glue results, update our notion of the current
+  // chain and glue.
+  if (EmitNodeInfo & OPFL_GlueOutput) {
+    S.InputGlue = SDValue(Res, VTs.size()-1);
+    if (EmitNodeInfo & OPFL_Chain)
+      S.InputChain = SDValue(Res, VTs.size()-2);
+  } else if (EmitNodeInfo & OPFL_Chain)
+    S.InputChain = SDValue(Res, VTs.size()-1);
+
+  // If the OPFL_MemRefs glue is set on this node, slap all of the
+  // accumulated memrefs onto it.
+  //
+  // FIXME: This is vastly incorrect for patterns with multiple outputs
+  // instructions that access memory and for ComplexPatterns that match
+  // loads.
+  if (EmitNodeInfo & OPFL_MemRefs) {
+    MachineSDNode::mmo_iterator MemRefs =
+      MF->allocateMemRefsArray(S.MatchedMemRefs.size());
+    std::copy(S.MatchedMemRefs.begin(), S.MatchedMemRefs.end(), MemRefs);
+    cast<MachineSDNode>(Res)
+      ->setMemRefs(MemRefs, MemRefs + S.MatchedMemRefs.size());
+  }
+
+  DEBUG(errs() << "  "
+               << (IsMorphNodeTo ? "Morphed" : "Created")
+               << " node: "; Res->dump(CurDAG); errs() << "\n");
+
+  // If this was a MorphNodeTo then we're completely done!
+  if (IsMorphNodeTo) {
+    // Update chain and glue uses.
+    UpdateChainsAndGlue(NodeToMatch, S.InputChain, S.ChainNodesMatched,
+                        S.InputGlue, S.GlueResultNodesMatched, true);
+  }
+  return Res;
+}
+
+void SelectionDAGISel::CompleteMatch(MatchState &S, const SDValue *Results,
+                                     unsigned NumResults) {
+  // The match has been completed, and any new nodes (if any) have been
+  // created.  Patch up references to the matched dag to use the newly
+  // created nodes.
+  SDNode *NodeToMatch = S.NodeToMatch;
+  for (unsigned i = 0; i != NumResults; ++i) {
+    SDValue Res = Results[i];
+
+    assert(i < NodeToMatch->getNumValues() &&
+           NodeToMatch->getValueType(i) != MVT::Other &&
+           NodeToMatch->getValueType(i) != MVT::Glue &&
+           "Invalid number of results to complete!");
+    assert((NodeToMatch->getValueType(i) == Res.getValueType() ||
+            NodeToMatch->getValueType(i) == MVT::iPTR ||
+            Res.getValueType() == MVT::iPTR ||
+            NodeToMatch->getValueType(i).getSizeInBits() ==
+                Res.getValueType().getSizeInBits()) &&
+           "invalid replacement");
+    CurDAG->ReplaceAllUsesOfValueWith(SDValue(NodeToMatch, i), Res);
+  }
+
+  // If the root node defines glue, add it to the glue nodes to update list.
+  if (NodeToMatch->getValueType(NodeToMatch->getNumValues()-1) == MVT::Glue)
+    S.GlueResultNodesMatched.push_back(NodeToMatch);
+
+  // Update chain and glue uses.
+  UpdateChainsAndGlue(NodeToMatch, S.InputChain, S.ChainNodesMatched,
+                      S.InputGlue, S.GlueResultNodesMatched, false);
+
+  assert(NodeToMatch->use_empty() &&
+         "Didn't replace all uses of the node?");
+}
+
+SDNode *SelectionDAGISel::
+SelectCodeCommon(SDNode *NodeToMatch, const unsigned char *MatcherTable,
+                 unsigned TableSize) {
+  SDNode *Result;
+  if (SelectSpecialNode(NodeToMatch, Result))
+    return Result;
 
   assert(!NodeToMatch->isMachineOpcode() && "Node already selected!");
 
@@ -2059,26 +2313,12 @@ SelectCodeCommon(SDNode *NodeToMatch, const unsigned char *MatcherTable,
   // indicates where to continue checking.
   SmallVector<MatchScope, 8> MatchScopes;
 
-  // RecordedNodes - This is the set of nodes that have been recorded by the
-  // state machine.  The second value is the parent of the node, or null if the
-  // root is recorded.
-  SmallVector<std::pair<SDValue, SDNode*>, 8> RecordedNodes;
-
-  // MatchedMemRefs - This is the set of MemRef's we've seen in the input
-  // pattern.
-  SmallVector<MachineMemOperand*, 2> MatchedMemRefs;
-
-  // These are the current input chain and glue for use when generating nodes.
-  // Various Emit operations change these.  For example, emitting a copytoreg
-  // uses and updates these.
-  SDValue InputChain, InputGlue;
-
-  // ChainNodesMatched - If a pattern matches nodes that have input/output
-  // chains, the OPC_EmitMergeInputChains operation is emitted which indicates
-  // which ones they are.  The result is captured into this list so that we can
-  // update the chain results when the pattern is complete.
-  SmallVector<SDNode*, 3> ChainNodesMatched;
-  SmallVector<SDNode*, 3> GlueResultNodesMatched;
+  // S - The nodes recorded by the state machine, the memrefs seen in the
+  // input pattern, and the current input chain and glue for use when
+  // generating nodes.
+  MatchState S(NodeToMatch);
+  SmallVectorImpl<std::pair<SDValue, SDNode*> > &RecordedNodes =
+    S.RecordedNodes;
 
   DEBUG(errs() << "ISEL: Starting pattern match on root node: ";
         NodeToMatch->dump(CurDAG);
@@ -2176,16 +2416,7 @@ SelectCodeCommon(SDNode *NodeToMatch, const unsigned char *MatcherTable,
 
       // Push a MatchScope which indicates where to go if the first child fails
       // to match.
-      MatchScope NewEntry;
-      NewEntry.FailIndex = FailIndex;
-      NewEntry.NodeStack.append(NodeStack.begin(), NodeStack.end());
-      NewEntry.NumRecordedNodes = RecordedNodes.size();
-      NewEntry.NumMatchedMemRefs = MatchedMemRefs.size();
-      NewEntry.InputChain = InputChain;
-      NewEntry.InputGlue = InputGlue;
-      NewEntry.HasChainNodesMatched = !ChainNodesMatched.empty();
-      NewEntry.HasGlueResultNodesMatched = !GlueResultNodesMatched.empty();
-      MatchScopes.push_back(NewEntry);
+      MatchScopes.push_back(MatchScope(FailIndex, NodeStack, S));
       continue;
     }
     case OPC_RecordNode: {
@@ -2193,7 +2424,7 @@ SelectCodeCommon(SDNode *NodeToMatch, const unsigned char *MatcherTable,
       SDNode *Parent = 0;
       if (NodeStack.size() > 1)
         Parent = NodeStack[NodeStack.size()-2].getNode();
-      RecordedNodes.push_back(std::make_pair(N, Parent));
+      S.record(N, Parent);
       continue;
     }
 
@@ -2205,19 +2436,15 @@ SelectCodeCommon(SDNode *NodeToMatch, const unsigned char *MatcherTable,
       if (ChildNo >= N.getNumOperands())
         break;  // Match fails if out of range child #.
 
-      RecordedNodes.push_back(std::make_pair(N->getOperand(ChildNo),
-                                             N.getNode()));
+      S.record(N->getOperand(ChildNo), N.getNode());
       continue;
     }
     case OPC_RecordMemRef:
-      MatchedMemRefs.push_back(cast<MemSDNode>(N)->getMemOperand());
+      S.MatchedMemRefs.push_back(cast<MemSDNode>(N)->getMemOperand());
       continue;
 
     case OPC_CaptureGlueInput:
-      // If the current node has an input glue, capture it in InputGlue.
-      if (N->getNumOperands() != 0 &&
-          N->getOperand(N->getNumOperands()-1).getValueType() == MVT::Glue)
-        InputGlue = N->getOperand(N->getNumOperands()-1);
+      CaptureGlueInput(S, N);
       continue;
 
     case OPC_MoveChild: {
@@ -2351,45 +2578,25 @@ SelectCodeCommon(SDNode *NodeToMatch, const unsigned char *MatcherTable,
       if (!::CheckOrImm(MatcherTable, MatcherIndex, N, *this)) break;
       continue;
 
-    case OPC_CheckFoldableChainNode: {
-      assert(NodeStack.size() != 1 && "No parent node");
-      // Verify that all intermediate nodes between the root and this one have
-      // a single use.
-      bool HasMultipleUses = false;
-      for (unsigned i = 1, e = NodeStack.size()-1; i != e; ++i)
-        if (!NodeStack[i].hasOneUse()) {
-          HasMultipleUses = true;
-          break;
-        }
-      if (HasMultipleUses) break;
-
-      // Check to see that the target thinks this is profitable to fold and that
-      // we can fold it without inducing cycles in the graph.
-      if (!IsProfitableToFold(N, NodeStack[NodeStack.size()-2].getNode(),
-                              NodeToMatch) ||
-          !IsLegalToFold(N, NodeStack[NodeStack.size()-2].getNode(),
-                         NodeToMatch, OptLevel,
-                         true/*We validate our own chains*/))
+    case OPC_CheckFoldableChainNode:
+      if (!IsFoldableChainNode(S, NodeStack.data(), NodeStack.size()))
         break;
-
       continue;
-    }
+
     case OPC_EmitInteger: {
       MVT::SimpleValueType VT =
         (MVT::SimpleValueType)MatcherTable[MatcherIndex++];
       int64_t Val = MatcherTable[MatcherIndex++];
       if (Val & 128)
         Val = GetVBR(Val, MatcherTable, MatcherIndex);
-      RecordedNodes.push_back(std::pair<SDValue, SDNode*>(
-                              CurDAG->getTargetConstant(Val, VT), (SDNode*)0));
+      S.record(CurDAG->getTargetConstant(Val, VT), 0);
       continue;
     }
     case OPC_EmitRegister: {
       MVT::SimpleValueType VT =
         (MVT::SimpleValueType)MatcherTable[MatcherIndex++];
       unsigned RegNo = MatcherTable[MatcherIndex++];
-      RecordedNodes.push_back(std::pair<SDValue, SDNode*>(
-                              CurDAG->getRegister(RegNo, VT), (SDNode*)0));
+      S.record(CurDAG->getRegister(RegNo, VT), 0);
       continue;
     }
     case OPC_EmitRegister2: {
@@ -2400,98 +2607,30 @@ SelectCodeCommon(SDNode *NodeToMatch, const unsigned char *MatcherTable,
         (MVT::SimpleValueType)MatcherTable[MatcherIndex++];
       unsigned RegNo = MatcherTable[MatcherIndex++];
       RegNo |= MatcherTable[MatcherIndex++] << 8;
-      RecordedNodes.push_back(std::pair<SDValue, SDNode*>(
-                              CurDAG->getRegister(RegNo, VT), (SDNode*)0));
+      S.record(CurDAG->getRegister(RegNo, VT), 0);
       continue;
     }
 
-    case OPC_EmitConvertToTarget:  {
-      // Convert from IMM/FPIMM to target version.
-      unsigned RecNo = MatcherTable[MatcherIndex++];
-      assert(RecNo < RecordedNodes.size() && "Invalid CheckSame");
-      SDValue Imm = RecordedNodes[RecNo].first;
-
-      if (Imm->getOpcode() == ISD::Constant) {
-        int64_t Val = cast<ConstantSDNode>(Imm)->getZExtValue();
-        Imm = CurDAG->getTargetConstant(Val, Imm.getValueType());
-      } else if (Imm->getOpcode() == ISD::ConstantFP) {
-        const ConstantFP *Val=cast<ConstantFPSDNode>(Imm)->getConstantFPValue();
-        Imm = CurDAG->getTargetConstantFP(*Val, Imm.getValueType());
-      }
-
-      RecordedNodes.push_back(std::make_pair(Imm, RecordedNodes[RecNo].second));
+    case OPC_EmitConvertToTarget:
+      EmitConvertToTarget(S, MatcherTable[MatcherIndex++]);
       continue;
-    }
 
     case OPC_EmitMergeInputChains1_0:    // OPC_EmitMergeInputChains, 1, 0
     case OPC_EmitMergeInputChains1_1: {  // OPC_EmitMergeInputChains, 1, 1
       // These are space-optimized forms of OPC_EmitMergeInputChains.
-      assert(InputChain.getNode() == 0 &&
-             "EmitMergeInputChains should be the first chain producing node");
-      assert(ChainNodesMatched.empty() &&
-             "Should only have one EmitMergeInputChains per match");
-
-      // Read all of the chained nodes.
       unsigned RecNo = Opcode == OPC_EmitMergeInputChains1_1;
-      assert(RecNo < RecordedNodes.size() && "Invalid CheckSame");
-      ChainNodesMatched.push_back(RecordedNodes[RecNo].first.getNode());
-
-      // FIXME: What if other value results of the node have uses not matched
-      // by this pattern?
-      if (ChainNodesMatched.back() != NodeToMatch &&
-          !RecordedNodes[RecNo].first.hasOneUse()) {
-        ChainNodesMatched.clear();
+      if (!EmitMergeInputChains(S, &RecNo, 1))
         break;
-      }
-
-      // Merge the input chains if they are not intra-pattern references.
-      InputChain = HandleMergeInputChains(ChainNodesMatched, CurDAG);
-
-      if (InputChain.getNode() == 0)
-        break;  // Failed to merge.
       continue;
     }
 
     case OPC_EmitMergeInputChains: {
-      assert(InputChain.getNode() == 0 &&
-             "EmitMergeInputChains should be the first chain producing node");
-      // This node gets a list of nodes we matched in the input that have
-      // chains.  We want to token factor all of the input chains to these nodes
-      // together.  However, if any of the input chains is actually one of the
-      // nodes matched in this pattern, then we have an intra-match reference.
-      // Ignore these because the newly token factored chain should not refer to
-      // the old nodes.
       unsigned NumChains = MatcherTable[MatcherIndex++];
-      assert(NumChains != 0 && "Can't TF zero chains");
-
-      assert(ChainNodesMatched.empty() &&
-             "Should only have one EmitMergeInputChains per match");
-
-      // Read all of the chained nodes.
-      for (unsigned i = 0; i != NumChains; ++i) {
-        unsigned RecNo = MatcherTable[MatcherIndex++];
-        assert(RecNo < RecordedNodes.size() && "Invalid CheckSame");
-        ChainNodesMatched.push_back(RecordedNodes[RecNo].first.getNode());
-
-        // FIXME: What if other value results of the node have uses not matched
-        // by this pattern?
-        if (ChainNodesMatched.back() != NodeToMatch &&
-            !RecordedNodes[RecNo].first.hasOneUse()) {
-          ChainNodesMatched.clear();
-          break;
-        }
-      }
-
-      // If the inner loop broke out, the match fails.
-      if (ChainNodesMatched.empty())
+      SmallVector<unsigned, 4> RecNos;
+      for (unsigned i = 0; i != NumChains; ++i)
+        RecNos.push_back(MatcherTable[MatcherIndex++]);
+      if (!EmitMergeInputChains(S, RecNos.data(), RecNos.size()))
         break;
-
-      // Merge the input chains if they are not intra-pattern references.
-      InputChain = HandleMergeInputChains(ChainNodesMatched, CurDAG);
-
-      if (InputChain.getNode() == 0)
-        break;  // Failed to merge.
-
       continue;
     }
 
@@ -2499,15 +2638,7 @@ SelectCodeCommon(SDNode *NodeToMatch, const unsigned char *MatcherTable,
       unsigned RecNo = MatcherTable[MatcherIndex++];
       assert(RecNo < RecordedNodes.size() && "Invalid CheckSame");
       unsigned DestPhysReg = MatcherTable[MatcherIndex++];
-
-      if (InputChain.getNode() == 0)
-        InputChain = CurDAG->getEntryNode();
-
-      InputChain = CurDAG->getCopyToReg(InputChain, NodeToMatch->getDebugLoc(),
-                                        DestPhysReg, RecordedNodes[RecNo].first,
-                                        InputGlue);
-
-      InputGlue = InputChain.getValue(1);
+      EmitCopyToReg(S, RecordedNodes[RecNo].first, DestPhysReg);
       continue;
     }
 
@@ -2515,8 +2646,7 @@ SelectCodeCommon(SDNode *NodeToMatch, const unsigned char *MatcherTable,
       unsigned XFormNo = MatcherTable[MatcherIndex++];
       unsigned RecNo = MatcherTable[MatcherIndex++];
       assert(RecNo < RecordedNodes.size() && "Invalid CheckSame");
-      SDValue Res = RunSDNodeXForm(RecordedNodes[RecNo].first, XFormNo);
-      RecordedNodes.push_back(std::pair<SDValue,SDNode*>(Res, (SDNode*) 0));
+      S.record(RunSDNodeXForm(RecordedNodes[RecNo].first, XFormNo), 0);
       continue;
     }
 
@@ -2527,28 +2657,9 @@ SelectCodeCommon(SDNode *NodeToMatch, const unsigned char *MatcherTable,
       unsigned EmitNodeInfo = MatcherTable[MatcherIndex++];
       // Get the result VT list.
       unsigned NumVTs = MatcherTable[MatcherIndex++];
-      SmallVector<EVT, 4> VTs;
-      for (unsigned i = 0; i != NumVTs; ++i) {
-        MVT::SimpleValueType VT =
-          (MVT::SimpleValueType)MatcherTable[MatcherIndex++];
-        if (VT == MVT::iPTR) VT = TLI.getPointerTy().SimpleTy;
-        VTs.push_back(VT);
-      }
-
-      if (EmitNodeInfo & OPFL_Chain)
-        VTs.push_back(MVT::Other);
-      if (EmitNodeInfo & OPFL_GlueOutput)
-        VTs.push_back(MVT::Glue);
-
-      // This is hot code, so optimize the two most common cases of 1 and 2
-      // results.
-      SDVTList VTList;
-      if (VTs.size() == 1)
-        VTList = CurDAG->getVTList(VTs[0]);
-      else if (VTs.size() == 2)
-        VTList = CurDAG->getVTList(VTs[0], VTs[1]);
-      else
-        VTList = CurDAG->getVTList(VTs.data(), VTs.size());
+      SmallVector<MVT::SimpleValueType, 4> VTs;
+      for (unsigned i = 0; i != NumVTs; ++i)
+        VTs.push_back((MVT::SimpleValueType)MatcherTable[MatcherIndex++]);
 
       // Get the operand list.
       unsigned NumOps = MatcherTable[MatcherIndex++];
@@ -2562,84 +2673,13 @@ SelectCodeCommon(SDNode *NodeToMatch, const unsigned char *MatcherTable,
         Ops.push_back(RecordedNodes[RecNo].first);
       }
 
-      // If there are variadic operands to add, handle them now.
-      if (EmitNodeInfo & OPFL_VariadicInfo) {
-        // Determine the start index to copy from.
-        unsigned FirstOpToCopy = getNumFixedFromVariadicInfo(EmitNodeInfo);
-        FirstOpToCopy += (EmitNodeInfo & OPFL_Chain) ? 1 : 0;
-        assert(NodeToMatch->getNumOperands() >= FirstOpToCopy &&
-               "Invalid variadic node");
-        // Copy all of the variadic operands, not including a potential glue
-        // input.
-        for (unsigned i = FirstOpToCopy, e = NodeToMatch->getNumOperands();
-             i != e; ++i) {
-          SDValue V = NodeToMatch->getOperand(i);
-          if (V.getValueType() == MVT::Glue) break;
-          Ops.push_back(V);
-        }
-      }
-
-      // If this has chain/glue inputs, add them.
-      if (EmitNodeInfo & OPFL_Chain)
-        Ops.push_back(InputChain);
-      if ((EmitNodeInfo & OPFL_GlueInput) && InputGlue.getNode() != 0)
-        Ops.push_back(InputGlue);
-
-      // Create the node.
-      SDNode *Res = 0;
-      if (Opcode != OPC_MorphNodeTo) {
-        // If this is a normal EmitNode command, just create the new node and
-        // add the results to the RecordedNodes list.
-        Res = CurDAG->getMachineNode(TargetOpc, NodeToMatch->getDebugLoc(),
-                                     VTList, Ops.data(), Ops.size());
-
-        // Add all the non-glue/non-chain results to the RecordedNodes list.
-        for (unsigned i = 0, e = VTs.size(); i != e; ++i) {
-          if (VTs[i] == MVT::Other || VTs[i] == MVT::Glue) break;
-          RecordedNodes.push_back(std::pair<SDValue,SDNode*>(SDValue(Res, i),
-                                                             (SDNode*) 0));
-        }
-
-      } else {
-        Res = MorphNode(NodeToMatch, TargetOpc, VTList, Ops.data(), Ops.size(),
-                        EmitNodeInfo);
-      }
-
-      // If the node had chain/glue results, update our notion of the current
-      // chain and glue.
-      if (EmitNodeInfo & OPFL_GlueOutput) {
-        InputGlue = SDValue(Res, VTs.size()-1);
-        if (EmitNodeInfo & OPFL_Chain)
-          InputChain = SDValue(Res, VTs.size()-2);
-      } else if (EmitNodeInfo & OPFL_Chain)
-        InputChain = SDValue(Res, VTs.size()-1);
-
-      // If the OPFL_MemRefs glue is set on this node, slap all of the
-      // accumulated memrefs onto it.
-      //
-      // FIXME: This is vastly incorrect for patterns with multiple outputs
-      // instructions that access memory and for ComplexPatterns that match
-      // loads.
-      if (EmitNodeInfo & OPFL_MemRefs) {
-        MachineSDNode::mmo_iterator MemRefs =
-          MF->allocateMemRefsArray(MatchedMemRefs.size());
-        std::copy(MatchedMemRefs.begin(), MatchedMemRefs.end(), MemRefs);
-        cast<MachineSDNode>(Res)
-          ->setMemRefs(MemRefs, MemRefs + MatchedMemRefs.size());
-      }
-
-      DEBUG(errs() << "  "
-                   << (Opcode == OPC_MorphNodeTo ? "Morphed" : "Created")
-                   << " node: "; Res->dump(CurDAG); errs() << "\n");
+      SDNode *Res = EmitMatchedNode(S, Opcode == OPC_MorphNodeTo, TargetOpc,
+                                    EmitNodeInfo, VTs.data(), VTs.size(),
+                                    Ops.data(), Ops.size());
 
       // If this was a MorphNodeTo then we're completely done!
-      if (Opcode == OPC_MorphNodeTo) {
-        // Update chain and glue uses.
-        UpdateChainsAndGlue(NodeToMatch, InputChain, ChainNodesMatched,
-                            InputGlue, GlueResultNodesMatched, true);
+      if (Opcode == OPC_MorphNodeTo)
         return Res;
-      }
-
       continue;
     }
 
@@ -2653,48 +2693,25 @@ SelectCodeCommon(SDNode *NodeToMatch, const unsigned char *MatcherTable,
           RecNo = GetVBR(RecNo, MatcherTable, MatcherIndex);
 
         assert(RecNo < RecordedNodes.size() && "Invalid CheckSame");
-        GlueResultNodesMatched.push_back(RecordedNodes[RecNo].first.getNode());
+        S.GlueResultNodesMatched.push_back(
+                                          RecordedNodes[RecNo].first.getNode());
       }
       continue;
     }
 
     case OPC_CompleteMatch: {
-      // The match has been completed, and any new nodes (if any) have been
-      // created.  Patch up references to the matched dag to use the newly
-      // created nodes.
       unsigned NumResults = MatcherTable[MatcherIndex++];
-
+      SmallVector<SDValue, 4> Results;
       for (unsigned i = 0; i != NumResults; ++i) {
         unsigned ResSlot = MatcherTable[MatcherIndex++];
         if (ResSlot & 128)
           ResSlot = GetVBR(ResSlot, MatcherTable, MatcherIndex);
 
         assert(ResSlot < RecordedNodes.size() && "Invalid CheckSame");
-        SDValue Res = RecordedNodes[ResSlot].first;
-
-        assert(i < NodeToMatch->getNumValues() &&
-               NodeToMatch->getValueType(i) != MVT::Other &&
-               NodeToMatch->getValueType(i) != MVT::Glue &&
-               "Invalid number of results to complete!");
-        assert((NodeToMatch->getValueType(i) == Res.getValueType() ||
-                NodeToMatch->getValueType(i) == MVT::iPTR ||
-                Res.getValueType() == MVT::iPTR ||
-                NodeToMatch->getValueType(i).getSizeInBits() ==
-                    Res.getValueType().getSizeInBits()) &&
-               "invalid replacement");
-        CurDAG->ReplaceAllUsesOfValueWith(SDValue(NodeToMatch, i), Res);
+        Results.push_back(RecordedNodes[ResSlot].first);
       }
 
-      // If the root node defines glue, add it to the glue nodes to update list.
-      if (NodeToMatch->getValueType(NodeToMatch->getNumValues()-1) == MVT::Glue)
-        GlueResultNodesMatched.push_back(NodeToMatch);
-
-      // Update chain and glue uses.
-      UpdateChainsAndGlue(NodeToMatch, InputChain, ChainNodesMatched,
-                          InputGlue, GlueResultNodesMatched, false);
-
-      assert(NodeToMatch->use_empty() &&
-             "Didn't replace all uses of the node?");
+      CompleteMatch(S, Results.data(), Results.size());
 
       // FIXME: We just return here, which interacts correctly with SelectRoot
       // above.  We should fix this to not return an SDNode* anymore.
@@ -2716,24 +2733,15 @@ SelectCodeCommon(SDNode *NodeToMatch, const unsigned char *MatcherTable,
       // Restore the interpreter state back to the point where the scope was
       // formed.
       MatchScope &LastScope = MatchScopes.back();
-      RecordedNodes.resize(LastScope.NumRecordedNodes);
+      S.rollback(LastScope.State);
       NodeStack.clear();
       NodeStack.append(LastScope.NodeStack.begin(), LastScope.NodeStack.end());
       N = NodeStack.back();
 
-      if (LastScope.NumMatchedMemRefs != MatchedMemRefs.size())
-        MatchedMemRefs.resize(LastScope.NumMatchedMemRefs);
       MatcherIndex = LastScope.FailIndex;
 
       DEBUG(errs() << "  Continuing at " << MatcherIndex << "\n");
 
-      InputChain = LastScope.InputChain;
-      InputGlue = LastScope.InputGlue;
-      if (!LastScope.HasChainNodesMatched)
-        ChainNodesMatched.clear();
-      if (!LastScope.HasGlueResultNodesMatched)
-        GlueResultNodesMatched.clear();
-
       // Check to see what the offset is at the new MatcherIndex.  If it is zero
       // we have reached the end of this scope, otherwise we have another child
       // in the current scope to try.
@@ -31,6 +31,7 @@
 #include "llvm/Support/Path.h"
 #include "llvm/Transforms/Utils/ValueMapper.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
 using namespace llvm;
 
 // Error - Simple wrapper function to conditionally assign to E and return true.
@@ -302,15 +303,19 @@ static bool LinkTypes(Module *Dest, const Module *Src, std::string *Err) {
     if (DelayedTypesToResolve.size() == OldSize) {
       // Attempt to resolve subelements of types.  This allows us to merge these
       // two types: { int* } and { opaque* }
-      for (unsigned i = 0, e = DelayedTypesToResolve.size(); i != e; ++i) {
+      //
+      // Keep sweeping after a success instead of going back to the main loop:
+      // types are looked up by name each time, so later entries see the
+      // refinements made by earlier ones, and restarting after every success
+      // makes linking many modules with shared abstract types quadratic.
+      // Structurally identical concrete types need none of this, since they
+      // are uniqued by the context and compare equal above.
+      for (unsigned i = 0; i != DelayedTypesToResolve.size(); ++i) {
         const std::string &Name = DelayedTypesToResolve[i];
         if (!RecursiveResolveTypes(SrcST->lookup(Name), DestST->lookup(Name))) {
           // We are making progress!
           DelayedTypesToResolve.erase(DelayedTypesToResolve.begin()+i);
-
-          // Go back to the main loop, perhaps we can resolve directly by name
-          // now...
-          break;
+          --i;
         }
       }
 
@@ -1017,12 +1022,52 @@ static bool LinkFunctionBody(Function *Dest, Function *Src,
 }
 
 
+// isReferenced - Return true if anything other than a dead constant uses V.
+static bool isReferenced(const Value *V) {
+  for (Value::const_use_iterator UI = V->use_begin(), E = V->use_end();
+       UI != E; ++UI) {
+    const User *U = *UI;
+    if (isa<Constant>(U) && !isa<GlobalValue>(U)) {
+      if (isReferenced(U))
+        return true;
+    } else {
+      return true;
+    }
+  }
+  return false;
+}
+
+// AddReferencedFunctions - Add the functions that the operands of U refer to,
+// looking through constants, to Worklist.
+static void AddReferencedFunctions(User *U, std::vector<Function*> &Worklist,
+                                   SmallPtrSet<Constant*, 32> &Visited) {
+  for (User::op_iterator OI = U->op_begin(), OE = U->op_end(); OI != OE; ++OI){
+    if (Function *F = dyn_cast<Function>(*OI)) {
+      Worklist.push_back(F);
+      continue;
+    }
+    Constant *C = dyn_cast<Constant>(*OI);
+    if (C && !isa<GlobalValue>(C) && Visited.insert(C))
+      AddReferencedFunctions(C, Worklist, Visited);
+  }
+}
+
 // LinkFunctionBodies - Link in the function bodies that are defined in the
 // source module into the DestModule.  This consists basically of copying the
-// function over and fixing up references to values.
+// function over and fixing up references to values.  In LinkReferencedBodies
+// mode, the destination functions that did not get a body because nothing
+// refers to them are added to Unlinked.
 static bool LinkFunctionBodies(Module *Dest, Module *Src,
-                               ValueToValueMapTy &ValueMap,
+                               ValueToValueMapTy &ValueMap, unsigned Mode,
+                               std::vector<Function*> &Unlinked,
                                std::string *Err) {
+  // Pending - The destination functions whose bodies can be skipped if they
+  // turn out to be unreferenced, mapped to their source function.
+  DenseMap<Function*, Function*> Pending;
+  std::vector<Function*> Worklist;
+  // Unscanned - The bodies linked unconditionally, whose references have not
+  // been followed yet.
+  SmallPtrSet<Function*, 16> Unscanned;
 
   // Loop over all of the functions in the src module, mapping them over as we
   // go
@@ -1031,12 +1076,59 @@ static bool LinkFunctionBodies(Module *Dest, Module *Src,
       Function *DF = dyn_cast<Function>(ValueMap[SF]); // Destination function
 
       // DF not external SF external?
-      if (DF && DF->isDeclaration())
+      if (DF && DF->isDeclaration()) {
+        if (Mode == Linker::LinkReferencedBodies &&
+            (DF->hasLocalLinkage() || DF->hasAvailableExternallyLinkage())) {
+          // Defer the body until we know something needs it.  Anything kept
+          // in Dest so far (global initializers, aliases, existing bodies)
+          // makes it a root.
+          Pending[DF] = SF;
+          if (isReferenced(DF))
+            Worklist.push_back(DF);
+          continue;
+        }
+
         // Only provide the function body if there isn't one already.
         if (LinkFunctionBody(DF, SF, ValueMap, Err))
           return true;
+
+        if (Mode == Linker::LinkReferencedBodies) {
+          Worklist.push_back(DF);
+          Unscanned.insert(DF);
+        }
+      }
+    }
+  }
+
+  if (Pending.empty())
+    return false;
+
+  // Link the pending bodies that are reachable from the roots, following the
+  // references made by each body as it is linked in.
+  SmallPtrSet<Constant*, 32> Visited;
+  while (!Worklist.empty()) {
+    Function *F = Worklist.back();
+    Worklist.pop_back();
+
+    // Scan each linked body once; link pending bodies on first reference.
+    DenseMap<Function*, Function*>::iterator PI = Pending.find(F);
+    if (PI != Pending.end()) {
+      Function *SF = PI->second;
+      Pending.erase(PI);
+      if (LinkFunctionBody(F, SF, ValueMap, Err))
+        return true;
+    } else if (!Unscanned.erase(F)) {
+      continue;
     }
+
+    for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+      for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I)
+        AddReferencedFunctions(I, Worklist, Visited);
   }
+
+  for (DenseMap<Function*, Function*>::iterator I = Pending.begin(),
+       E = Pending.end(); I != E; ++I)
+    Unlinked.push_back(I->first);
   return false;
 }
 
@@ -1168,7 +1260,8 @@ static bool ResolveAliases(Module *Dest) {
 // the problem.  Upon failure, the Dest module could be in a modified state, and
 // shouldn't be relied on to be consistent.
 bool
-Linker::LinkModules(Module *Dest, Module *Src, std::string *ErrorMsg) {
+Linker::LinkModules(Module *Dest, Module *Src, unsigned Mode,
+                    std::string *ErrorMsg) {
   assert(Dest != 0 && "Invalid Destination module");
   assert(Src  != 0 && "Invalid Source Module");
 
@@ -1276,7 +1369,9 @@ Linker::LinkModules(Module *Dest, Module *Src, std::string *ErrorMsg) {
   // Link in the function bodies that are defined in the source module into the
   // DestModule.  This consists basically of copying the function over and
   // fixing up references to values.
-  if (LinkFunctionBodies(Dest, Src, ValueMap, ErrorMsg)) return true;
+  std::vector<Function*> Unlinked;
+  if (LinkFunctionBodies(Dest, Src, ValueMap, Mode, Unlinked, ErrorMsg))
+    return true;
 
   // If there were any appending global variables, link them together now.
   if (LinkAppendingVars(Dest, AppendingVars, ErrorMsg)) return true;
@@ -1289,6 +1384,16 @@ Linker::LinkModules(Module *Dest, Module *Src, std::string *ErrorMsg) {
   // are properly remapped.
   LinkNamedMDNodes(Dest, Src, ValueMap);
 
+  // Drop the functions whose bodies were skipped.  This is done after linking
+  // the named metadata so that references to them from it are mapped to Dest
+  // and then cleared, rather than left pointing into Src.
+  for (unsigned i = 0, e = Unlinked.size(); i != e; ++i) {
+    Function *F = Unlinked[i];
+    F->removeDeadConstantUsers();
+    assert(F->use_empty() && "Skipped the body of a referenced function!");
+    F->eraseFromParent();
+  }
+
   // If the source library's module id is in the dependent library list of the
   // destination library, remove it since that module is now linked in.
   const std::string &modId = Src->getModuleIdentifier();
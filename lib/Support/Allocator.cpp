@@ -13,6 +13,7 @@
 
 #include "llvm/Support/Allocator.h"
 #include "llvm/Support/DataTypes.h"
+#include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/Recycler.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Memory.h"
@@ -136,6 +137,14 @@ unsigned BumpPtrAllocator::GetNumSlabs() const {
   return NumSlabs;
 }
 
+size_t BumpPtrAllocator::getTotalMemory() const {
+  size_t TotalMemory = 0;
+  for (MemSlab *Slab = CurSlab; Slab != 0; Slab = Slab->NextPtr) {
+    TotalMemory += Slab->Size;
+  }
+  return TotalMemory;
+}
+
 void BumpPtrAllocator::PrintStats() const {
   unsigned NumSlabs = 0;
   size_t TotalMemory = 0;
@@ -169,6 +178,24 @@ void MallocSlabAllocator::Deallocate(MemSlab *Slab) {
   Allocator.Deallocate(Slab);
 }
 
+MmapSlabAllocator::~MmapSlabAllocator() { }
+
+MemSlab *MmapSlabAllocator::Allocate(size_t Size) {
+  std::string ErrMsg;
+  sys::MemoryBlock Block = sys::Memory::AllocateRW(Size, HugePages, &ErrMsg);
+  if (!Block.base())
+    report_fatal_error("Unable to allocate memory slab: " + ErrMsg);
+  MemSlab *Slab = (MemSlab*)Block.base();
+  Slab->Size = Block.size();
+  Slab->NextPtr = 0;
+  return Slab;
+}
+
+void MmapSlabAllocator::Deallocate(MemSlab *Slab) {
+  sys::MemoryBlock Block(Slab, Slab->Size);
+  sys::Memory::ReleaseRW(Block);
+}
+
 void PrintRecyclerStats(size_t Size,
                         size_t Align,
                         size_t FreeListSize) {
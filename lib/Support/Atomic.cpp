@@ -16,9 +16,11 @@
 
 using namespace llvm;
 
-#if defined(_MSC_VER)
+#if defined(_WIN32)
 #include <windows.h>
 #undef MemoryFence
+#else
+#include <sched.h>
 #endif
 
 void sys::MemoryFence() {
@@ -35,6 +37,16 @@ void sys::MemoryFence() {
 #endif
 }
 
+void sys::ThreadYield() {
+#if LLVM_MULTITHREADED==0
+  return;
+#elif defined(_WIN32)
+  SwitchToThread();
+#else
+  sched_yield();
+#endif
+}
+
 sys::cas_flag sys::CompareAndSwap(volatile sys::cas_flag* ptr,
                                   sys::cas_flag new_value,
                                   sys::cas_flag old_value) {
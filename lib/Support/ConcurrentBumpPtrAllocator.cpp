@@ -0,0 +1,278 @@
+//===--- ConcurrentBumpPtrAllocator.cpp - Thread-safe bump allocator ------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the ConcurrentBumpPtrAllocator interface.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/ConcurrentBumpPtrAllocator.h"
+#include "llvm/Support/Atomic.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/ThreadLocal.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstring>
+
+using namespace llvm;
+
+/// ThreadCache - Each thread that allocates from any ConcurrentBumpPtrAllocator
+/// gets one of these, found through a single thread-local key.  Entries are
+/// direct mapped by allocator ID.  A miss costs taking the allocator's lock and
+/// searching its region list.  Allocators are numbered in the order they are
+/// created, so up to NumEntries allocators created close together never share
+/// an entry; a thread that keeps switching between two allocators whose IDs
+/// are equal modulo NumEntries takes that slow path on every switch.
+struct ConcurrentBumpPtrAllocator::ThreadCache {
+  enum { NumEntries = 8 };
+  unsigned IDs[NumEntries];
+  Region *Regions[NumEntries];
+
+  /// Next - The next cache in Caches.
+  ThreadCache *Next;
+
+  ThreadCache() : Next(0) {
+    memset(IDs, 0, sizeof(IDs));
+  }
+
+  /// List - The key every thread keeps its cache under, and the caches of all
+  /// threads.  Caches are only freed by llvm_shutdown, so no two threads ever
+  /// own regions through the same cache address.
+  struct List {
+    sys::ThreadLocal<const ThreadCache> Current;
+    sys::Mutex Lock;
+    ThreadCache *Head;
+
+    List() : Head(0) { }
+    ~List() {
+      while (ThreadCache *TC = Head) {
+        Head = TC->Next;
+        delete TC;
+      }
+    }
+  };
+  static ManagedStatic<List> Caches;
+
+  /// get - Return the calling thread's cache, creating it if need be.
+  static ThreadCache *get() {
+    if (const ThreadCache *TC = Caches->Current.get())
+      return const_cast<ThreadCache*>(TC);
+    ThreadCache *TC = new ThreadCache();
+    {
+      sys::ScopedLock L(Caches->Lock);
+      TC->Next = Caches->Head;
+      Caches->Head = TC;
+    }
+    Caches->Current.set(TC);
+    return TC;
+  }
+};
+
+ManagedStatic<ConcurrentBumpPtrAllocator::ThreadCache::List>
+ConcurrentBumpPtrAllocator::ThreadCache::Caches;
+
+/// NextID - The last ID given to an allocator.
+static volatile sys::cas_flag NextID = 0;
+
+ConcurrentBumpPtrAllocator::ConcurrentBumpPtrAllocator(size_t size,
+                                                       size_t threshold,
+                                                       SlabAllocator &allocator)
+    : SlabSize(size), SizeThreshold(threshold), Allocator(allocator),
+      Slabs(0), BigSlabs(0), FreeSlabs(0) {
+  // ID 0 marks an empty cache entry.
+  do
+    ID = sys::AtomicIncrement(&NextID);
+  while (ID == 0);
+
+  // Create the thread caches here rather than on the first, possibly
+  // concurrent, allocation.
+  (void)*ThreadCache::Caches;
+}
+
+ConcurrentBumpPtrAllocator::~ConcurrentBumpPtrAllocator() {
+  DeallocateSlabs(Slabs);
+  DeallocateSlabs(BigSlabs);
+  DeallocateSlabs(FreeSlabs);
+  for (unsigned i = 0, e = Regions.size(); i != e; ++i)
+    delete Regions[i];
+}
+
+/// DeallocateSlabs - Deallocate all memory slabs after and including this
+/// one.
+void ConcurrentBumpPtrAllocator::DeallocateSlabs(MemSlab *Slab) {
+  while (Slab) {
+    MemSlab *NextSlab = Slab->NextPtr;
+    Allocator.Deallocate(Slab);
+    Slab = NextSlab;
+  }
+}
+
+/// Reset - Free all memory allocated so far, keeping the slabs for reuse.
+void ConcurrentBumpPtrAllocator::Reset() {
+  sys::ScopedLock L(Lock);
+  while (MemSlab *Slab = Slabs) {
+    Slabs = Slab->NextPtr;
+#ifndef NDEBUG
+    // Poison the memory so stale pointers crash sooner.
+    memset(Slab + 1, 0xCD, Slab->Size - sizeof(MemSlab));
+#endif
+    Slab->NextPtr = FreeSlabs;
+    FreeSlabs = Slab;
+  }
+  DeallocateSlabs(BigSlabs);
+  BigSlabs = 0;
+
+  for (unsigned i = 0, e = Regions.size(); i != e; ++i) {
+    Regions[i]->CurPtr = Regions[i]->End = 0;
+    Regions[i]->BytesAllocated = 0;
+  }
+}
+
+/// GetRegion - Return the calling thread's region, from its cache if this
+/// allocator is still there.
+inline ConcurrentBumpPtrAllocator::Region *
+ConcurrentBumpPtrAllocator::GetRegion() {
+  const ThreadCache *TC = ThreadCache::Caches->Current.get();
+  unsigned Slot = ID % ThreadCache::NumEntries;
+  if (TC && TC->IDs[Slot] == ID)
+    return TC->Regions[Slot];
+  return FindRegion();
+}
+
+/// FindRegion - Look up the calling thread's region, giving it an empty one
+/// if it has not allocated from this allocator yet, and put it in the
+/// thread's cache.
+ConcurrentBumpPtrAllocator::Region *ConcurrentBumpPtrAllocator::FindRegion() {
+  ThreadCache *TC = ThreadCache::get();
+  Region *R = 0;
+  {
+    sys::ScopedLock L(Lock);
+    for (unsigned i = 0, e = Regions.size(); i != e; ++i)
+      if (Regions[i]->Owner == TC) {
+        R = Regions[i];
+        break;
+      }
+    if (!R) {
+      R = new Region();
+      R->CurPtr = R->End = 0;
+      R->BytesAllocated = 0;
+      R->Owner = TC;
+      Regions.push_back(R);
+    }
+  }
+  unsigned Slot = ID % ThreadCache::NumEntries;
+  TC->IDs[Slot] = ID;
+  TC->Regions[Slot] = R;
+  return R;
+}
+
+/// Allocate - Allocate space at the specified alignment.
+///
+void *ConcurrentBumpPtrAllocator::Allocate(size_t Size, size_t Alignment) {
+  Region *R = GetRegion();
+
+  // Keep track of how many bytes we've allocated.
+  R->BytesAllocated += Size;
+
+  // 0-byte alignment means 1-byte alignment.
+  if (Alignment == 0) Alignment = 1;
+
+  // Allocate the aligned space, going forwards from CurPtr.
+  char *Ptr = BumpPtrAllocator::AlignPtr(R->CurPtr, Alignment);
+
+  // Check if we can hold it.
+  if (R->End && Ptr + Size <= R->End) {
+    R->CurPtr = Ptr + Size;
+    return Ptr;
+  }
+  return AllocateSlow(R, Size, Alignment);
+}
+
+/// AllocateSlow - Allocate Size bytes that do not fit in the rest of R,
+/// either in a slab of their own or by moving R into a new slab.
+void *ConcurrentBumpPtrAllocator::AllocateSlow(Region *R, size_t Size,
+                                               size_t Alignment) {
+  // If Size is really big, allocate a separate slab for it.
+  size_t PaddedSize = Size + sizeof(MemSlab) + Alignment - 1;
+  if (PaddedSize > SizeThreshold) {
+    sys::ScopedLock L(Lock);
+    MemSlab *NewSlab = Allocator.Allocate(PaddedSize);
+    NewSlab->NextPtr = BigSlabs;
+    BigSlabs = NewSlab;
+
+    char *Ptr = BumpPtrAllocator::AlignPtr((char*)(NewSlab + 1), Alignment);
+    assert((uintptr_t)Ptr + Size <= (uintptr_t)NewSlab + NewSlab->Size);
+    return Ptr;
+  }
+
+  // Otherwise, move the region into a new slab, reusing one freed by Reset if
+  // there is one.
+  MemSlab *NewSlab;
+  {
+    sys::ScopedLock L(Lock);
+    if (FreeSlabs) {
+      NewSlab = FreeSlabs;
+      FreeSlabs = NewSlab->NextPtr;
+    } else {
+      NewSlab = Allocator.Allocate(SlabSize);
+    }
+    NewSlab->NextPtr = Slabs;
+    Slabs = NewSlab;
+  }
+  R->End = ((char*)NewSlab) + NewSlab->Size;
+  char *Ptr = BumpPtrAllocator::AlignPtr((char*)(NewSlab + 1), Alignment);
+  R->CurPtr = Ptr + Size;
+  assert(R->CurPtr <= R->End && "Unable to allocate memory!");
+  return Ptr;
+}
+
+unsigned ConcurrentBumpPtrAllocator::GetNumSlabs() const {
+  sys::ScopedLock L(Lock);
+  unsigned NumSlabs = 0;
+  for (MemSlab *Slab = Slabs; Slab != 0; Slab = Slab->NextPtr)
+    ++NumSlabs;
+  for (MemSlab *Slab = BigSlabs; Slab != 0; Slab = Slab->NextPtr)
+    ++NumSlabs;
+  return NumSlabs;
+}
+
+size_t ConcurrentBumpPtrAllocator::getTotalMemory() const {
+  sys::ScopedLock L(Lock);
+  size_t TotalMemory = 0;
+  for (MemSlab *Slab = Slabs; Slab != 0; Slab = Slab->NextPtr)
+    TotalMemory += Slab->Size;
+  for (MemSlab *Slab = BigSlabs; Slab != 0; Slab = Slab->NextPtr)
+    TotalMemory += Slab->Size;
+  for (MemSlab *Slab = FreeSlabs; Slab != 0; Slab = Slab->NextPtr)
+    TotalMemory += Slab->Size;
+  return TotalMemory;
+}
+
+size_t ConcurrentBumpPtrAllocator::getBytesAllocated() const {
+  sys::ScopedLock L(Lock);
+  size_t BytesAllocated = 0;
+  for (unsigned i = 0, e = Regions.size(); i != e; ++i)
+    BytesAllocated += Regions[i]->BytesAllocated;
+  return BytesAllocated;
+}
+
+void ConcurrentBumpPtrAllocator::PrintStats() const {
+  size_t BytesAllocated = getBytesAllocated();
+  size_t TotalMemory = getTotalMemory();
+  unsigned NumThreads;
+  {
+    sys::ScopedLock L(Lock);
+    NumThreads = Regions.size();
+  }
+
+  errs() << "\nNumber of memory regions: " << GetNumSlabs() << '\n'
+         << "Number of threads: " << NumThreads << '\n'
+         << "Bytes used: " << BytesAllocated << '\n'
+         << "Bytes allocated: " << TotalMemory << '\n'
+         << "Bytes wasted: " << (TotalMemory - BytesAllocated)
+         << " (includes alignment, etc)\n";
+}
@@ -15,11 +15,12 @@
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/ADT/SmallVector.h"
+#include "RegexDFA.h"
 #include "regex_impl.h"
 #include <string>
 using namespace llvm;
 
-Regex::Regex(StringRef regex, unsigned Flags) {
+Regex::Regex(StringRef regex, unsigned Flags) : DFA(0) {
   unsigned flags = 0;
   preg = new llvm_regex();
   preg->re_endp = regex.end();
@@ -31,6 +32,7 @@ Regex::Regex(StringRef regex, unsigned Flags) {
 }
 
 Regex::~Regex() {
+  delete DFA;
   llvm_regfree(preg);
   delete preg;
 }
@@ -61,7 +63,31 @@ bool Regex::match(StringRef String, SmallVectorImpl<StringRef> *Matches){
   pm[0].rm_so = 0;
   pm[0].rm_eo = String.size();
 
-  int rc = llvm_regexec(preg, String.data(), nmatch, pm.data(), REG_STARTEND);
+  // Regexes without back references are matched with the DFA, leaving only
+  // the subexpressions, if any are wanted, to regexec's engine.
+  if (!DFA && !error) {
+    if (size_t NumStates = llvm_regnstates(preg))
+      DFA = new RegexDFA(preg, NumStates);
+  }
+
+  int rc;
+  if (DFA) {
+    size_t Start, End;
+    if (!DFA->match(String, Matches != 0, Start, End))
+      return false;
+    if (!Matches)
+      return true;
+    if (nmatch > 1) {
+      rc = llvm_regdissect(preg, String.data(), nmatch, pm.data(),
+                           REG_STARTEND, Start, End);
+    } else {
+      pm[0].rm_so = Start;
+      pm[0].rm_eo = End;
+      rc = 0;
+    }
+  } else {
+    rc = llvm_regexec(preg, String.data(), nmatch, pm.data(), REG_STARTEND);
+  }
 
   if (rc == REG_NOMATCH)
     return false;
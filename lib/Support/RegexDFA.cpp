@@ -0,0 +1,281 @@
+//===-- RegexDFA.cpp - Lazily built DFA for llvm::Regex -------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the lazily built DFA used by llvm::Regex.
+//
+//===----------------------------------------------------------------------===//
+
+#include "RegexDFA.h"
+#include "regex_impl.h"
+#include <cassert>
+#include <cctype>
+#include <climits>
+#include <cstring>
+using namespace llvm;
+
+/// OutChar - The character the regexec engine uses for "no character",
+/// before the start and at the end of the input (OUT in regex2.h).
+static const int OutChar = CHAR_MAX + 1;
+
+/// MaxStates - Once an automaton has this many states, its states and
+/// transitions are thrown away and built again from scratch, bounding the
+/// memory used on inputs that visit a large part of the DFA.
+static const unsigned MaxStates = 1024;
+
+/// getClass - Boundaries only depend on whether a character is the start or
+/// end of the input, a newline, or a word character, so characters are
+/// collapsed into one representative of each.
+static char getClass(int C) {
+  if (C == OutChar) return 0;
+  if (C == '\n') return '\n';
+  if (C == '_' || isalnum(C & 0xff)) return 'a';
+  return ' ';
+}
+
+/// getClassChar - The representative character to hand back to the engine.
+static int getClassChar(char Class) {
+  return Class == 0 ? OutChar : Class;
+}
+
+/// contains - Whether Str occurs in String, using memchr to skip to each
+/// occurrence of its first character.
+static bool contains(StringRef String, StringRef Str) {
+  if (Str.size() > String.size())
+    return false;
+  const char *P = String.data();
+  const char *Last = String.data() + String.size() - Str.size();
+  while (P <= Last) {
+    P = static_cast<const char*>(memchr(P, Str[0], Last - P + 1));
+    if (!P)
+      return false;
+    if (memcmp(P + 1, Str.data() + 1, Str.size() - 1) == 0)
+      return true;
+    ++P;
+  }
+  return false;
+}
+
+RegexDFA::Automaton::Automaton(const llvm_regex *preg, size_t numRegexStates,
+                               bool restart, bool deferFlush)
+  : Preg(preg), NumRegexStates(numRegexStates), Restart(restart),
+    DeferFlush(deferFlush), NeedsFlush(false), StartSet(numRegexStates, 0) {
+  llvm_regstates(Preg, &StartSet[0]);
+}
+
+void RegexDFA::Automaton::flush() {
+  IDs.clear();
+  Keys.clear();
+  Trans.clear();
+  AtEnd.clear();
+  IsStart.clear();
+  IsEmpty.clear();
+  NeedsFlush = false;
+}
+
+void RegexDFA::Automaton::flushKeeping(unsigned *const *States,
+                                       unsigned NumStates) {
+  std::vector<std::string> Kept;
+  for (unsigned i = 0; i != NumStates; ++i)
+    Kept.push_back(Keys[*States[i]]);
+  flush();
+  for (unsigned i = 0; i != NumStates; ++i)
+    *States[i] = getState(Kept[i]);
+}
+
+unsigned RegexDFA::Automaton::getState(const std::string &Key) {
+  StringMap<unsigned>::iterator I = IDs.find(Key);
+  if (I != IDs.end())
+    return I->second;
+
+  unsigned ID = Keys.size();
+  StringMapEntry<unsigned> &Entry = IDs.GetOrCreateValue(Key, ID);
+  Keys.push_back(Entry.getKey());
+  Trans.resize(Trans.size() + 256, ~0U);
+  AtEnd.push_back(-1);
+
+  StringRef Set(Key.data(), NumRegexStates);
+  IsStart.push_back(Set == StartSet);
+  IsEmpty.push_back(Set.find_first_not_of('\0') == StringRef::npos);
+  return ID;
+}
+
+unsigned RegexDFA::Automaton::getStartState(int Prev) {
+  return getState(StartSet + getClass(Prev));
+}
+
+unsigned RegexDFA::Automaton::computeNext(unsigned S, unsigned char C) {
+  std::string Key = Keys[S];
+  std::string From = Key;
+  std::string To = Restart ? StartSet : std::string(NumRegexStates, 0);
+  bool Match = llvm_regadvance(Preg, &From[0],
+                               getClassChar(Key[NumRegexStates]),
+                               (int)(char)C, &To[0]);
+  To += getClass((int)(char)C);
+
+  // Start over if the automaton has grown too big.  The caller only holds on
+  // to S, so renumbering is safe once S has been added back.  A caller that
+  // holds on to more flushes between characters instead.
+  if (Keys.size() >= MaxStates && !IDs.count(To)) {
+    if (DeferFlush) {
+      NeedsFlush = true;
+    } else {
+      flush();
+      S = getState(Key);
+    }
+  }
+
+  unsigned T = (getState(To) << 1) | Match;
+  Trans[S*256 + C] = T;
+  return T;
+}
+
+bool RegexDFA::Automaton::matchesAtEnd(unsigned S) {
+  if (AtEnd[S] < 0) {
+    std::string From = Keys[S];
+    AtEnd[S] = llvm_regadvance(Preg, &From[0],
+                               getClassChar(From[NumRegexStates]),
+                               OutChar, 0) != 0;
+  }
+  return AtEnd[S];
+}
+
+RegexDFA::RegexDFA(const llvm_regex *preg, size_t NumRegexStates)
+  : FirstEnd(preg, NumRegexStates, true, false),
+    Longest(preg, NumRegexStates, false, true), Step(0) {
+  size_t MustLen;
+  if (const char *MustStr = llvm_regmust(preg, &MustLen))
+    Must = StringRef(MustStr, MustLen);
+}
+
+bool RegexDFA::match(StringRef String, bool Span, size_t &Start,
+                     size_t &End) {
+  const unsigned char *Str =
+    reinterpret_cast<const unsigned char*>(String.data());
+  size_t Size = String.size();
+
+  // Like regexec, skip the scan if the input lacks a required string.
+  if (!Must.empty() && !contains(String, Must))
+    return false;
+
+  // First find where the earliest-ending match ends, remembering the last
+  // position before that at which no match was under way.  The leftmost
+  // match cannot start before it.
+  unsigned S = FirstEnd.getStartState(OutChar);
+  size_t Cold = 0;
+  bool Found = false;
+  for (size_t i = 0; ; ++i) {
+    if (FirstEnd.isStart(S))
+      Cold = i;
+    if (i == Size) {
+      Found = FirstEnd.matchesAtEnd(S);
+      break;
+    }
+    S = FirstEnd.getNext(S, Str[i], Found);
+    if (Found)
+      break;
+  }
+  if (!Found || !Span)
+    return Found;
+
+  // Then find the leftmost match, and the longest from there, in a single
+  // pass.  A thread is started at each position until some thread matches;
+  // threads that reach the same state have the same future, so only the
+  // earliest started survives.  Once a thread matches, the threads started
+  // after it can no longer win and are dropped, and once no thread started
+  // before it is left, only the match itself needs extending.
+  Threads.clear();
+  ++Step;
+  bool HaveMatch = false;
+  size_t i = Cold;
+  for (; !HaveMatch || !Threads.empty(); ++i) {
+    if (!HaveMatch) {
+      int Prev = i == 0 ? OutChar : (int)(char)Str[i-1];
+      S = Longest.getStartState(Prev);
+      if (!Longest.isEmpty(S) && !isSeen(S)) {
+        setSeen(S);
+        Threads.push_back(Thread(S, i));
+      }
+    }
+
+    if (i == Size) {
+      // Threads are in order of their start, and all started before the
+      // current match, so the first to match at the end wins.
+      for (unsigned t = 0, e = Threads.size(); t != e; ++t)
+        if (Longest.matchesAtEnd(Threads[t].State)) {
+          Start = Threads[t].Start;
+          End = Size;
+          return true;
+        }
+      Threads.clear();
+      break;
+    }
+
+    unsigned char C = Str[i];
+    bool Match;
+    if (HaveMatch && !Longest.isEmpty(S)) {
+      S = Longest.getNext(S, C, Match);
+      if (Match)
+        End = i;
+    }
+
+    ++Step;
+    unsigned Live = 0;
+    for (unsigned t = 0, e = Threads.size(); t != e; ++t) {
+      unsigned T = Longest.getNext(Threads[t].State, C, Match);
+      if (Match) {
+        // The earliest thread to match replaces any match found before.
+        HaveMatch = true;
+        Start = Threads[t].Start;
+        End = i;
+        S = T;
+        break;
+      }
+      if (Longest.isEmpty(T) || isSeen(T))
+        continue;
+      setSeen(T);
+      Threads[Live].State = T;
+      Threads[Live++].Start = Threads[t].Start;
+    }
+    Threads.resize(Live, Thread(0, 0));
+
+    if (Longest.needsFlush()) {
+      std::vector<unsigned*> States;
+      for (unsigned t = 0, e = Threads.size(); t != e; ++t)
+        States.push_back(&Threads[t].State);
+      States.push_back(&S);
+      Longest.flushKeeping(&States[0], States.size());
+      Seen.clear();
+      for (unsigned t = 0, e = Threads.size(); t != e; ++t)
+        setSeen(Threads[t].State);
+    }
+  }
+
+  if (!HaveMatch) {
+    assert(0 && "DFA found a match end but no match");
+    return false;
+  }
+
+  // Extend the match as far as it goes.
+  for (; !Longest.isEmpty(S); ++i) {
+    if (i == Size) {
+      if (Longest.matchesAtEnd(S))
+        End = Size;
+      break;
+    }
+    bool Match;
+    S = Longest.getNext(S, Str[i], Match);
+    if (Match)
+      End = i;
+    if (Longest.needsFlush()) {
+      unsigned *States[] = { &S };
+      Longest.flushKeeping(States, 1);
+    }
+  }
+  return true;
+}
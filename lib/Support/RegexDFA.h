@@ -0,0 +1,145 @@
+//===-- RegexDFA.h - Lazily built DFA for llvm::Regex -----------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares RegexDFA, the matching engine Regex uses for regexes
+// without back references.  It runs the same two scans over the input as the
+// regexec engine, but caches each transition between sets of regex states the
+// first time it is computed, so each input character costs a table lookup
+// instead of a walk over every state of the regex.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SUPPORT_REGEXDFA_H
+#define LLVM_SUPPORT_REGEXDFA_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include <string>
+#include <vector>
+
+struct llvm_regex;
+
+namespace llvm {
+
+class RegexDFA {
+  /// Automaton - The DFA for one of the two scans.  Each state is a set of
+  /// regex states together with the class of the character before it, which
+  /// decides the line and word boundaries seen by the next transition.
+  class Automaton {
+    const llvm_regex *Preg;
+    size_t NumRegexStates;
+
+    /// Restart - Whether a new match may begin at every character, as when
+    /// looking for the first place a match ends.
+    bool Restart;
+
+    /// DeferFlush - Whether the caller holds on to several states at once.
+    /// If so, growing too big only sets NeedsFlush, and the caller calls
+    /// flushKeeping between characters.
+    bool DeferFlush, NeedsFlush;
+
+    /// StartSet - The regex states at the beginning of a match.
+    std::string StartSet;
+
+    /// IDs - Maps the key of each DFA state to its number.  Keys are the state
+    /// set, one byte per regex state, followed by the previous character's
+    /// class.
+    StringMap<unsigned> IDs;
+    std::vector<StringRef> Keys;
+
+    /// Trans - 256 entries per state: ~0U if not yet computed, otherwise the
+    /// next state shifted left by one, with the low bit set if a match ends
+    /// before the character.
+    std::vector<unsigned> Trans;
+
+    /// AtEnd - Per state, 1 if a match ends at the end of the input, 0 if
+    /// not, -1 if not yet computed.
+    std::vector<signed char> AtEnd;
+
+    /// IsStart/IsEmpty - Per state, whether its set is StartSet or empty.
+    std::vector<bool> IsStart, IsEmpty;
+
+    unsigned getState(const std::string &Key);
+    void flush();
+
+  public:
+    Automaton(const llvm_regex *preg, size_t numRegexStates, bool restart,
+              bool deferFlush);
+
+    /// getStartState - The state at the start of a match which follows the
+    /// character Prev, or OUT at the start of the input.
+    unsigned getStartState(int Prev);
+
+    /// getNext - Return the state after consuming C from state S, setting
+    /// Match if a match ends just before C.  Unless flushes are deferred,
+    /// this may renumber all states.
+    unsigned getNext(unsigned S, unsigned char C, bool &Match) {
+      unsigned T = Trans[S*256 + C];
+      if (T == ~0U)
+        T = computeNext(S, C);
+      Match = T & 1;
+      return T >> 1;
+    }
+    unsigned computeNext(unsigned S, unsigned char C);
+
+    /// matchesAtEnd - Whether a match ends at the end of the input in state S.
+    bool matchesAtEnd(unsigned S);
+
+    bool isStart(unsigned S) const { return IsStart[S]; }
+    bool isEmpty(unsigned S) const { return IsEmpty[S]; }
+    unsigned getNumStates() const { return Keys.size(); }
+
+    /// needsFlush - Whether a deferred flush is due.
+    bool needsFlush() const { return NeedsFlush; }
+
+    /// flushKeeping - Throw away all states but the NumStates ones pointed
+    /// to by States, which are renumbered in place.
+    void flushKeeping(unsigned *const *States, unsigned NumStates);
+  };
+
+  Automaton FirstEnd, Longest;
+
+  /// Thread - A candidate match in the Longest scan: its state, and the
+  /// position it started at.
+  struct Thread {
+    unsigned State;
+    size_t Start;
+    Thread(unsigned state, size_t start) : State(state), Start(start) {}
+  };
+  std::vector<Thread> Threads;
+
+  /// Seen - Per Longest state, the Step at which a thread last reached it,
+  /// so that only the earliest started thread in each state is kept.
+  std::vector<size_t> Seen;
+  size_t Step;
+
+  bool isSeen(unsigned S) const { return S < Seen.size() && Seen[S] == Step; }
+  void setSeen(unsigned S) {
+    if (S >= Seen.size())
+      Seen.resize(S + 1, 0);
+    Seen[S] = Step;
+  }
+
+  /// Must - A string every match contains, if the regex has one.
+  StringRef Must;
+
+public:
+  /// RegexDFA - preg must be compiled and free of back references, so that
+  /// llvm_regnstates returns the nonzero NumRegexStates.
+  RegexDFA(const llvm_regex *preg, size_t NumRegexStates);
+
+  /// match - Return true if String contains a match.  If Span is true, also
+  /// set Start and End to the offsets of the match regexec would report: the
+  /// leftmost, and of those the longest.
+  bool match(StringRef String, bool Span, size_t &Start, size_t &End);
+};
+
+}
+
+#endif
@@ -10,7 +10,32 @@
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/APInt.h"
 #include "llvm/ADT/OwningPtr.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MathExtras.h"
 #include <bitset>
+#include <cstring>
+
+// The searches below use SSE2 where the compiler targets it, which it always
+// does on x86-64.  The SSE4.2 string instructions are used when the compiler
+// targets them, or when it can build a function for them and the CPU running
+// the code turns out to have them.
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HAVE_SSE2_SEARCH 1
+#endif
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#define HAVE_SSE42_SEARCH 1
+#define SSE42_FUNCTION
+#elif defined(HAVE_SSE2_SEARCH) && defined(__GNUC__) && \
+      !defined(__clang__) && \
+      (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#include <nmmintrin.h>
+#define HAVE_SSE42_SEARCH 1
+#define SSE42_FUNCTION __attribute__((target("sse4.2")))
+#endif
 
 using namespace llvm;
 
@@ -129,6 +154,61 @@ unsigned StringRef::edit_distance(llvm::StringRef Other,
 //===----------------------------------------------------------------------===//
 
 
+#ifdef HAVE_SSE42_SEARCH
+static bool DetectSSE42() {
+#ifdef __SSE4_2__
+  return true;
+#else
+  StringMap<bool> Features;
+  return sys::getHostCPUFeatures(Features) && Features.lookup("sse42");
+#endif
+}
+
+/// hasSSE42 - Whether the SSE4.2 string instructions can be used.
+static bool hasSSE42() {
+  static const bool HasSSE42 = DetectSSE42();
+  return HasSSE42;
+}
+#endif
+
+/// SearchForward - Return the first index I in [From, Length - N] at which
+/// Needle occurs in Data, or npos.  N is at least 2 and at most Length.
+static size_t SearchForward(const char *Data, size_t Length, size_t From,
+                            const char *Needle, size_t N) {
+  size_t E = Length - N + 1;
+  size_t I = From;
+#ifdef HAVE_SSE2_SEARCH
+  // Test 16 positions at a time for a match of the needle's first and last
+  // characters, and compare the rest only at positions where both match.
+  __m128i First = _mm_set1_epi8(Needle[0]);
+  __m128i Last = _mm_set1_epi8(Needle[N-1]);
+  for (; I + 16 <= E; I += 16) {
+    __m128i BlockFirst = _mm_loadu_si128((const __m128i*)(Data + I));
+    __m128i BlockLast = _mm_loadu_si128((const __m128i*)(Data + I + N - 1));
+    unsigned Mask = _mm_movemask_epi8(
+      _mm_and_si128(_mm_cmpeq_epi8(First, BlockFirst),
+                    _mm_cmpeq_epi8(Last, BlockLast)));
+    while (Mask) {
+      unsigned Bit = CountTrailingZeros_32(Mask);
+      if (memcmp(Data + I + Bit + 1, Needle + 1, N - 2) == 0)
+        return I + Bit;
+      Mask &= Mask - 1;
+    }
+  }
+#endif
+  // Skip to each occurrence of the first character.
+  while (I < E) {
+    const char *P = (const char*)memchr(Data + I, Needle[0], E - I);
+    if (!P)
+      return StringRef::npos;
+    I = P - Data;
+    if (memcmp(P + 1, Needle + 1, N - 1) == 0)
+      return I;
+    ++I;
+  }
+  return StringRef::npos;
+}
+
 /// find - Search for the first string \arg Str in the string.
 ///
 /// \return - The index of the first occurence of \arg Str, or npos if not
@@ -137,10 +217,15 @@ size_t StringRef::find(StringRef Str, size_t From) const {
   size_t N = Str.size();
   if (N > Length)
     return npos;
-  for (size_t e = Length - N + 1, i = min(From, e); i != e; ++i)
-    if (substr(i, N).equals(Str))
-      return i;
-  return npos;
+  if (N == 0)
+    return From <= Length ? From : npos;
+  if (From >= Length)
+    return npos;
+  if (N == 1) {
+    const char *P = (const char*)memchr(Data + From, Str[0], Length - From);
+    return P ? P - Data : npos;
+  }
+  return SearchForward(Data, Length, From, Str.data(), N);
 }
 
 /// rfind - Search for the last string \arg Str in the string.
@@ -151,25 +236,92 @@ size_t StringRef::rfind(StringRef Str) const {
   size_t N = Str.size();
   if (N > Length)
     return npos;
-  for (size_t i = Length - N + 1, e = 0; i != e;) {
-    --i;
-    if (substr(i, N).equals(Str))
-      return i;
+  if (N == 0)
+    return Length;
+  size_t I = Length - N + 1;
+#ifdef HAVE_SSE2_SEARCH
+  // As in SearchForward, but taking 16 positions at a time from the end.
+  __m128i First = _mm_set1_epi8(Str[0]);
+  __m128i Last = _mm_set1_epi8(Str[N-1]);
+  for (; I >= 16; I -= 16) {
+    const char *Block = Data + I - 16;
+    __m128i BlockFirst = _mm_loadu_si128((const __m128i*)Block);
+    __m128i BlockLast = _mm_loadu_si128((const __m128i*)(Block + N - 1));
+    unsigned Mask = _mm_movemask_epi8(
+      _mm_and_si128(_mm_cmpeq_epi8(First, BlockFirst),
+                    _mm_cmpeq_epi8(Last, BlockLast)));
+    while (Mask) {
+      unsigned Bit = 31 - CountLeadingZeros_32(Mask);
+      if (memcmp(Block + Bit, Str.data(), N) == 0)
+        return I - 16 + Bit;
+      Mask &= ~(1U << Bit);
+    }
+  }
+#endif
+  while (I != 0) {
+    --I;
+    if (Data[I] == Str[0] && memcmp(Data + I, Str.data(), N) == 0)
+      return I;
   }
   return npos;
 }
 
+#ifdef HAVE_SSE42_SEARCH
+/// FindFirstOfSSE42 - Look for the first character at or after I in Data
+/// that is in Chars, or that is not if Negate is set, 16 characters at a
+/// time.  Return true with I set to its index if it is found, otherwise false
+/// with I set to where the remaining characters, too few for a whole block,
+/// start.  Chars has at most 16 characters.
+SSE42_FUNCTION
+static bool FindFirstOfSSE42(const char *Data, size_t Length, size_t &I,
+                             StringRef Chars, bool Negate) {
+  char Buf[16] = { 0 };
+  memcpy(Buf, Chars.data(), Chars.size());
+  __m128i Set = _mm_loadu_si128((const __m128i*)Buf);
+  int SetLen = Chars.size();
+  for (; I + 16 <= Length; I += 16) {
+    __m128i Block = _mm_loadu_si128((const __m128i*)(Data + I));
+    int Idx = Negate ?
+      _mm_cmpestri(Set, SetLen, Block, 16,
+                   _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY |
+                   _SIDD_NEGATIVE_POLARITY | _SIDD_LEAST_SIGNIFICANT) :
+      _mm_cmpestri(Set, SetLen, Block, 16,
+                   _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY |
+                   _SIDD_LEAST_SIGNIFICANT);
+    if (Idx != 16) {
+      I += Idx;
+      return true;
+    }
+  }
+  return false;
+}
+#endif
+
 /// find_first_of - Find the first character in the string that is in \arg
 /// Chars, or npos if not found.
 ///
 /// Note: O(size() + Chars.size())
 StringRef::size_type StringRef::find_first_of(StringRef Chars,
                                               size_t From) const {
+  if (From >= Length)
+    return npos;
+  if (Chars.size() == 1) {
+    const char *P = (const char*)memchr(Data + From, Chars[0], Length - From);
+    return P ? P - Data : npos;
+  }
+
+  size_type i = From;
+#ifdef HAVE_SSE42_SEARCH
+  if (!Chars.empty() && Chars.size() <= 16 && hasSSE42() &&
+      FindFirstOfSSE42(Data, Length, i, Chars, false))
+    return i;
+#endif
+
   std::bitset<1 << CHAR_BIT> CharBits;
   for (size_type i = 0; i != Chars.size(); ++i)
     CharBits.set((unsigned char)Chars[i]);
 
-  for (size_type i = min(From, Length), e = Length; i != e; ++i)
+  for (size_type e = Length; i != e; ++i)
     if (CharBits.test((unsigned char)Data[i]))
       return i;
   return npos;
@@ -178,7 +330,17 @@ StringRef::size_type StringRef::find_first_of(StringRef Chars,
 /// find_first_not_of - Find the first character in the string that is not
 /// \arg C or npos if not found.
 StringRef::size_type StringRef::find_first_not_of(char C, size_t From) const {
-  for (size_type i = min(From, Length), e = Length; i != e; ++i)
+  size_type i = min(From, Length), e = Length;
+#ifdef HAVE_SSE2_SEARCH
+  __m128i Char = _mm_set1_epi8(C);
+  for (; i + 16 <= e; i += 16) {
+    __m128i Block = _mm_loadu_si128((const __m128i*)(Data + i));
+    unsigned Mask = _mm_movemask_epi8(_mm_cmpeq_epi8(Char, Block)) ^ 0xFFFF;
+    if (Mask)
+      return i + CountTrailingZeros_32(Mask);
+  }
+#endif
+  for (; i != e; ++i)
     if (Data[i] != C)
       return i;
   return npos;
@@ -190,11 +352,21 @@ StringRef::size_type StringRef::find_first_not_of(char C, size_t From) const {
 /// Note: O(size() + Chars.size())
 StringRef::size_type StringRef::find_first_not_of(StringRef Chars,
                                                   size_t From) const {
+  if (From >= Length)
+    return npos;
+
+  size_type i = From;
+#ifdef HAVE_SSE42_SEARCH
+  if (!Chars.empty() && Chars.size() <= 16 && hasSSE42() &&
+      FindFirstOfSSE42(Data, Length, i, Chars, true))
+    return i;
+#endif
+
   std::bitset<1 << CHAR_BIT> CharBits;
   for (size_type i = 0; i != Chars.size(); ++i)
     CharBits.set((unsigned char)Chars[i]);
 
-  for (size_type i = min(From, Length), e = Length; i != e; ++i)
+  for (size_type e = Length; i != e; ++i)
     if (!CharBits.test((unsigned char)Data[i]))
       return i;
   return npos;
@@ -227,9 +399,10 @@ size_t StringRef::count(StringRef Str) const {
   size_t N = Str.size();
   if (N > Length)
     return 0;
-  for (size_t i = 0, e = Length - N + 1; i != e; ++i)
-    if (substr(i, N).equals(Str))
-      ++Count;
+  if (N == 0)
+    return Length + 1;
+  for (size_t i = find(Str); i != npos; i = find(Str, i + 1))
+    ++Count;
   return Count;
 }
 
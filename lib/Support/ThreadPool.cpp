@@ -0,0 +1,279 @@
+//===-- ThreadPool.cpp - Work-stealing thread pool ------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements ThreadPool and TaskGroup.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Config/config.h"
+#include <cassert>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+using namespace llvm;
+
+unsigned ThreadPool::getDefaultNumThreads() {
+#if defined(HAVE_UNISTD_H) && defined(_SC_NPROCESSORS_ONLN)
+  long N = sysconf(_SC_NPROCESSORS_ONLN);
+  if (N > 0)
+    return N;
+#endif
+  return 1;
+}
+
+void ThreadPool::async(TaskFn Fn, void *Data) {
+  spawn(Fn, Data, *AsyncTasks);
+}
+
+void ThreadPool::wait() {
+  waitFor(*AsyncTasks);
+}
+
+#if defined(LLVM_MULTITHREADED) && defined(HAVE_PTHREAD_H)
+#include "llvm/Support/ThreadLocal.h"
+#include <deque>
+#include <pthread.h>
+
+namespace {
+  struct Task {
+    ThreadPool::TaskFn Fn;
+    void *Data;
+    TaskGroup *Group;
+  };
+
+  /// WorkQueue - The tasks waiting on one worker, or on the shared queue.
+  struct WorkQueue {
+    pthread_mutex_t Lock;
+    std::deque<Task> Tasks;
+
+    WorkQueue() { ::pthread_mutex_init(&Lock, 0); }
+    ~WorkQueue() { ::pthread_mutex_destroy(&Lock); }
+
+    void push(const Task &T) {
+      ::pthread_mutex_lock(&Lock);
+      Tasks.push_back(T);
+      ::pthread_mutex_unlock(&Lock);
+    }
+
+    /// pop - Take the newest task, or the oldest one if FIFO is set.
+    bool pop(Task &T, bool FIFO) {
+      ::pthread_mutex_lock(&Lock);
+      bool Found = !Tasks.empty();
+      if (Found) {
+        if (FIFO) {
+          T = Tasks.front();
+          Tasks.pop_front();
+        } else {
+          T = Tasks.back();
+          Tasks.pop_back();
+        }
+      }
+      ::pthread_mutex_unlock(&Lock);
+      return Found;
+    }
+  };
+}
+
+struct ThreadPool::Impl {
+  /// Queues - One per worker, then the shared queue for other threads.
+  std::vector<WorkQueue*> Queues;
+  std::vector<pthread_t> Threads;
+
+  /// Self - The index of the current thread's queue if it is a worker.
+  struct Worker {
+    Impl *Pool;
+    unsigned Index;
+  };
+  std::vector<Worker> Workers;
+  sys::ThreadLocal<const Worker> Self;
+
+  /// Queued - The number of tasks in all the queues together.  Threads only
+  /// go to sleep when it is zero.
+  volatile sys::cas_flag Queued;
+
+  /// Sleepers - The number of threads waiting on Wake.  Whoever queues a task
+  /// or finishes the last task of a group bumps a counter first, then wakes
+  /// the sleepers if there are any; a thread going to sleep bumps Sleepers
+  /// first, then checks those counters, so one of the two sees the other.
+  volatile sys::cas_flag Sleepers;
+  pthread_mutex_t SleepLock;
+  pthread_cond_t Wake;
+  bool Stopping;
+
+  /// NextVictim - Where threads outside the pool start looking for tasks.
+  volatile sys::cas_flag NextVictim;
+
+  explicit Impl(unsigned NumThreads)
+    : Queues(NumThreads + 1), Workers(NumThreads), Queued(0), Sleepers(0),
+      Stopping(false), NextVictim(0) {
+    for (unsigned i = 0, e = Queues.size(); i != e; ++i)
+      Queues[i] = new WorkQueue();
+    ::pthread_mutex_init(&SleepLock, 0);
+    ::pthread_cond_init(&Wake, 0);
+  }
+
+  ~Impl() {
+    for (unsigned i = 0, e = Queues.size(); i != e; ++i)
+      delete Queues[i];
+    ::pthread_cond_destroy(&Wake);
+    ::pthread_mutex_destroy(&SleepLock);
+  }
+
+  unsigned getNumWorkers() const { return Workers.size(); }
+
+  /// getSelf - The current thread's queue index, or getNumWorkers() if it is
+  /// not one of this pool's workers.
+  unsigned getSelf() {
+    const Worker *W = Self.get();
+    return W ? W->Index : getNumWorkers();
+  }
+
+  void wakeSleepers() {
+    if (Sleepers == 0)
+      return;
+    ::pthread_mutex_lock(&SleepLock);
+    ::pthread_cond_broadcast(&Wake);
+    ::pthread_mutex_unlock(&SleepLock);
+  }
+
+  void push(const Task &T) {
+    // Count the task before it becomes visible, so that Queued never drops
+    // below the number of tasks threads can find.
+    sys::AtomicIncrement(&Queued);
+    Queues[getSelf()]->push(T);
+    wakeSleepers();
+  }
+
+  /// runOne - Run a task from the current thread's own queue, from the shared
+  /// queue, or stolen from another worker.  Return false if none was found.
+  bool runOne(unsigned SelfIdx) {
+    unsigned N = getNumWorkers();
+    Task T;
+    bool Found = false;
+    if (SelfIdx != N)
+      Found = Queues[SelfIdx]->pop(T, false);
+    if (!Found)
+      Found = Queues[N]->pop(T, true);
+    if (!Found) {
+      unsigned Start = SelfIdx != N ? SelfIdx + 1
+                                    : sys::AtomicIncrement(&NextVictim);
+      for (unsigned i = 0; i != N && !Found; ++i)
+        Found = Queues[(Start + i) % N]->pop(T, true);
+    }
+    if (!Found)
+      return false;
+
+    sys::AtomicDecrement(&Queued);
+    T.Fn(T.Data);
+    if (sys::AtomicDecrement(&T.Group->Pending) == 0)
+      wakeSleepers();
+    return true;
+  }
+
+  /// sleep - Block until a task is queued, or until Pending, if given, drops
+  /// to zero, or until the pool is stopping.
+  void sleep(volatile sys::cas_flag *Pending) {
+    ::pthread_mutex_lock(&SleepLock);
+    sys::AtomicIncrement(&Sleepers);
+    while (Queued == 0 && !Stopping && (!Pending || *Pending != 0))
+      ::pthread_cond_wait(&Wake, &SleepLock);
+    sys::AtomicDecrement(&Sleepers);
+    ::pthread_mutex_unlock(&SleepLock);
+  }
+
+  void workerLoop(Worker *W) {
+    Self.set(W);
+    unsigned SelfIdx = W->Index;
+    for (;;) {
+      if (runOne(SelfIdx))
+        continue;
+      ::pthread_mutex_lock(&SleepLock);
+      bool Stop = Stopping && Queued == 0;
+      ::pthread_mutex_unlock(&SleepLock);
+      if (Stop)
+        break;
+      sleep(0);
+    }
+  }
+
+  static void *startWorker(void *Arg) {
+    Worker *W = static_cast<Worker*>(Arg);
+    W->Pool->workerLoop(W);
+    return 0;
+  }
+};
+
+ThreadPool::ThreadPool(unsigned numThreads)
+  : NumThreads(numThreads ? numThreads : getDefaultNumThreads()),
+    AsyncTasks(new TaskGroup(*this)) {
+  TheImpl = new Impl(NumThreads);
+  TheImpl->Threads.reserve(NumThreads);
+  for (unsigned i = 0; i != NumThreads; ++i) {
+    Impl::Worker &W = TheImpl->Workers[i];
+    W.Pool = TheImpl;
+    W.Index = i;
+    pthread_t Thread;
+    if (::pthread_create(&Thread, 0, &Impl::startWorker, &W) == 0)
+      TheImpl->Threads.push_back(Thread);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  wait();
+  delete AsyncTasks;
+
+  ::pthread_mutex_lock(&TheImpl->SleepLock);
+  TheImpl->Stopping = true;
+  ::pthread_cond_broadcast(&TheImpl->Wake);
+  ::pthread_mutex_unlock(&TheImpl->SleepLock);
+  for (unsigned i = 0, e = TheImpl->Threads.size(); i != e; ++i)
+    ::pthread_join(TheImpl->Threads[i], 0);
+  delete TheImpl;
+}
+
+void ThreadPool::spawn(TaskFn Fn, void *Data, TaskGroup &Group) {
+  sys::AtomicIncrement(&Group.Pending);
+  Task T = { Fn, Data, &Group };
+  TheImpl->push(T);
+}
+
+void ThreadPool::waitFor(TaskGroup &Group) {
+  unsigned SelfIdx = TheImpl->getSelf();
+  while (Group.Pending != 0) {
+    if (!TheImpl->runOne(SelfIdx))
+      TheImpl->sleep(&Group.Pending);
+  }
+}
+
+#else
+
+// Without threads, tasks run as soon as they are spawned.
+
+struct ThreadPool::Impl {};
+
+ThreadPool::ThreadPool(unsigned)
+  : TheImpl(0), NumThreads(1), AsyncTasks(new TaskGroup(*this)) {
+}
+
+ThreadPool::~ThreadPool() {
+  delete AsyncTasks;
+}
+
+void ThreadPool::spawn(TaskFn Fn, void *Data, TaskGroup &) {
+  Fn(Data);
+}
+
+void ThreadPool::waitFor(TaskGroup &Group) {
+  assert(Group.Pending == 0 && "Tasks run when spawned!");
+}
+
+#endif
@@ -16,6 +16,7 @@
 #include "llvm/Support/Mutex.h"
 #include "llvm/Config/config.h"
 #include <cassert>
+#include <vector>
 
 using namespace llvm;
 
@@ -103,6 +104,42 @@ void llvm::llvm_execute_on_thread(void (*Fn)(void*), void *UserData,
   ::pthread_attr_destroy(&Attr);
 }
 
+void llvm::llvm_execute_on_threads(void (*Fn)(void*), void *const *UserData,
+                                   unsigned NumThreads,
+                                   unsigned RequestedStackSize) {
+  std::vector<ThreadInfo> Info(NumThreads);
+  std::vector<pthread_t> Threads(NumThreads);
+  std::vector<bool> Started(NumThreads);
+  pthread_attr_t Attr;
+  bool HaveAttr = ::pthread_attr_init(&Attr) == 0;
+
+  if (HaveAttr && RequestedStackSize != 0 &&
+      ::pthread_attr_setstacksize(&Attr, RequestedStackSize) != 0) {
+    ::pthread_attr_destroy(&Attr);
+    HaveAttr = false;
+  }
+
+  for (unsigned i = 0; i != NumThreads; ++i) {
+    Info[i].UserFn = Fn;
+    Info[i].UserData = UserData[i];
+    Started[i] = HaveAttr &&
+      ::pthread_create(&Threads[i], &Attr, ExecuteOnThread_Dispatch,
+                       &Info[i]) == 0;
+  }
+
+  // Run anything we failed to start a thread for on this one.
+  for (unsigned i = 0; i != NumThreads; ++i)
+    if (!Started[i])
+      Fn(UserData[i]);
+
+  for (unsigned i = 0; i != NumThreads; ++i)
+    if (Started[i])
+      ::pthread_join(Threads[i], 0);
+
+  if (HaveAttr)
+    ::pthread_attr_destroy(&Attr);
+}
+
 #else
 
 // No non-pthread implementation, currently.
@@ -113,4 +150,12 @@ void llvm::llvm_execute_on_thread(void (*Fn)(void*), void *UserData,
   Fn(UserData);
 }
 
+void llvm::llvm_execute_on_threads(void (*Fn)(void*), void *const *UserData,
+                                   unsigned NumThreads,
+                                   unsigned RequestedStackSize) {
+  (void) RequestedStackSize;
+  for (unsigned i = 0; i != NumThreads; ++i)
+    Fn(UserData[i]);
+}
+
 #endif
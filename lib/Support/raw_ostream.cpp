@@ -544,6 +544,15 @@ uint64_t raw_fd_ostream::seek(uint64_t off) {
   return pos;
 }
 
+bool raw_fd_ostream::supportsSeeking() {
+  // Devices such as /dev/null accept lseek without actually moving, so only
+  // trust regular files.
+  struct stat statbuf;
+  if (fstat(FD, &statbuf) != 0 || !S_ISREG(statbuf.st_mode))
+    return false;
+  return ::lseek(FD, 0, SEEK_CUR) != (off_t)-1;
+}
+
 size_t raw_fd_ostream::preferred_buffer_size() const {
 #if !defined(_MSC_VER) && !defined(__MINGW32__) && !defined(__minix)
   // Windows and Minix have no st_blksize.
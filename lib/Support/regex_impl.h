@@ -99,6 +99,12 @@ size_t	llvm_regerror(int, const llvm_regex_t *, char *, size_t);
 int	llvm_regexec(const llvm_regex_t *, const char *, size_t, 
                      llvm_regmatch_t [], int);
 void	llvm_regfree(llvm_regex_t *);
+int	llvm_regdissect(const llvm_regex_t *, const char *, size_t,
+                        llvm_regmatch_t [], int, size_t, size_t);
+size_t	llvm_regnstates(const llvm_regex_t *);
+const char *llvm_regmust(const llvm_regex_t *, size_t *);
+void	llvm_regstates(const llvm_regex_t *, char *);
+int	llvm_regadvance(const llvm_regex_t *, char *, int, int, char *);
 size_t  llvm_strlcpy(char *dst, const char *src, size_t siz);
 
 #ifdef __cplusplus
@@ -156,7 +156,155 @@ llvm_regexec(const llvm_regex_t *preg, const char *string, size_t nmatch,
 	eflags = GOODFLAGS(eflags);
 
 	if (g->nstates <= (long)(CHAR_BIT*sizeof(states1)) && !(eflags&REG_LARGE))
-		return(smatcher(g, string, nmatch, pmatch, eflags));
+		return(smatcher(g, string, nmatch, pmatch, eflags, NULL, NULL));
 	else
-		return(lmatcher(g, string, nmatch, pmatch, eflags));
+		return(lmatcher(g, string, nmatch, pmatch, eflags, NULL, NULL));
+}
+
+/*
+ - llvm_regdissect - fill in subexpression matches for a known match
+ *
+ * The match must be the one llvm_regexec would find in the same string,
+ * given as offsets from string in so and eo.  Only valid for regexes
+ * without back references.
+ */
+int				/* 0 success */
+llvm_regdissect(const llvm_regex_t *preg, const char *string, size_t nmatch,
+                llvm_regmatch_t pmatch[], int eflags, size_t so, size_t eo)
+{
+	struct re_guts *g = preg->re_g;
+
+	if (preg->re_magic != MAGIC1 || g->magic != MAGIC2)
+		return(REG_BADPAT);
+	if (g->iflags&REGEX_BAD || g->backrefs)
+		return(REG_BADPAT);
+	eflags = GOODFLAGS(eflags);
+
+	if (g->nstates <= (long)(CHAR_BIT*sizeof(states1)) && !(eflags&REG_LARGE))
+		return(smatcher(g, string, nmatch, pmatch, eflags,
+				string + so, string + eo));
+	else
+		return(lmatcher(g, string, nmatch, pmatch, eflags,
+				string + so, string + eo));
+}
+
+/*
+ - dfastep - step(), using the representation llvm_regexec would pick
+ *
+ * The two representations do not agree in every corner case (the small one
+ * passes bef by value, for instance), so use the one matcher() would use.
+ */
+static void
+dfastep(struct re_guts *g, char *bef, int ch, char *aft)
+{
+	const sopno startst = g->firststate+1;
+	const sopno stopst = g->laststate;
+	unsigned long sbef = 0, saft = 0;
+	sopno i;
+
+	if (g->nstates > (long)(CHAR_BIT*sizeof(states1))) {
+		lstep(g, startst, stopst, bef, ch, aft);
+		return;
+	}
+
+	for (i = 0; i < g->nstates; i++) {
+		if (bef[i])
+			sbef |= (unsigned long)1 << i;
+		if (aft[i])
+			saft |= (unsigned long)1 << i;
+	}
+	saft = sstep(g, startst, stopst, (states1)sbef, ch, (states1)saft);
+	for (i = 0; i < g->nstates; i++)
+		aft[i] = (saft >> i) & 1;
+}
+
+/*
+ - llvm_regnstates - size of a state set, or 0 if there are back references
+ *
+ * Regexes with back references cannot be matched on state sets alone.
+ */
+size_t
+llvm_regnstates(const llvm_regex_t *preg)
+{
+	struct re_guts *g = preg->re_g;
+
+	if (g->backrefs)
+		return(0);
+	return(g->nstates);
+}
+
+/*
+ - llvm_regmust - the string every match contains, or NULL if none is known
+ */
+const char *
+llvm_regmust(const llvm_regex_t *preg, size_t *len)
+{
+	struct re_guts *g = preg->re_g;
+
+	*len = g->mlen;
+	return(g->must);
+}
+
+/*
+ - llvm_regstates - initialize st to the states at the start of a match
+ *
+ * State sets handed to llvm_regstates and llvm_regadvance hold one char per
+ * state, re_g->nstates chars long.
+ */
+void
+llvm_regstates(const llvm_regex_t *preg, char *st)
+{
+	struct re_guts *g = preg->re_g;
+
+	memset(st, 0, g->nstates);
+	st[g->firststate+1] = 1;
+	dfastep(g, st, NOTHING, st);
+}
+
+/*
+ - llvm_regadvance - move the state set st over character c
+ *
+ * This is one iteration of the loop in fast() and slow(): lastc is the
+ * character before c, or OUT at the start of the string, and c is OUT at
+ * the end of it.  st is updated for any line and word boundary between
+ * lastc and c.  If c is not OUT, the states reached by consuming c are
+ * then added to aft, which the caller initializes to the states to restart
+ * from at each character (or to no states).  Returns nonzero if a match
+ * ends before c.
+ */
+int
+llvm_regadvance(const llvm_regex_t *preg, char *st, int lastc, int c,
+                char *aft)
+{
+	struct re_guts *g = preg->re_g;
+	int flagch = '\0';
+	int i = 0;
+
+	/* is there an EOL and/or BOL between lastc and c? */
+	if ((lastc == '\n' && g->cflags&REG_NEWLINE) || lastc == OUT) {
+		flagch = BOL;
+		i = g->nbol;
+	}
+	if ((c == '\n' && g->cflags&REG_NEWLINE) || c == OUT) {
+		flagch = (flagch == BOL) ? BOLEOL : EOL;
+		i += g->neol;
+	}
+	for (; i > 0; i--)
+		dfastep(g, st, flagch, st);
+
+	/* how about a word boundary? */
+	if ( (flagch == BOL || (lastc != OUT && !ISWORD(lastc))) &&
+				(c != OUT && ISWORD(c)) ) {
+		flagch = BOW;
+	}
+	if ( (lastc != OUT && ISWORD(lastc)) &&
+			(flagch == EOL || (c != OUT && !ISWORD(c))) ) {
+		flagch = EOW;
+	}
+	if (flagch == BOW || flagch == EOW)
+		dfastep(g, st, flagch, st);
+
+	if (c != OUT)
+		dfastep(g, st, c, aft);
+	return(st[g->laststate] != 0);
 }
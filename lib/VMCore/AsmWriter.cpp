@@ -2081,9 +2081,34 @@ void AssemblyWriter::printMDNodeBody(const MDNode *Node) {
 //                       External Interface declarations
 //===----------------------------------------------------------------------===//
 
+namespace {
+  /// BufferWhilePrinting - formatted_raw_ostream inherits the buffering of the
+  /// stream it wraps.  When that is errs() or dbgs(), as for -print-after-all,
+  /// every token the writer emits would be a separate write to the terminal
+  /// or file.  Give the formatted stream a buffer of its own while printing,
+  /// and make it unbuffered again afterwards: the formatted stream hands its
+  /// buffer size back to the wrapped stream when it goes away, and errs()
+  /// must stay unbuffered so diagnostics are out before a crash.
+  class BufferWhilePrinting {
+    formatted_raw_ostream &OS;
+    bool WasUnbuffered;
+  public:
+    explicit BufferWhilePrinting(formatted_raw_ostream &os)
+      : OS(os), WasUnbuffered(!os.GetBufferSize()) {
+      if (WasUnbuffered)
+        OS.SetBuffered();
+    }
+    ~BufferWhilePrinting() {
+      if (WasUnbuffered)
+        OS.SetUnbuffered();   // Flushes the buffer first.
+    }
+  };
+}
+
 void Module::print(raw_ostream &ROS, AssemblyAnnotationWriter *AAW) const {
   SlotTracker SlotTable(this);
   formatted_raw_ostream OS(ROS);
+  BufferWhilePrinting Buffering(OS);
   AssemblyWriter W(OS, SlotTable, this, AAW);
   W.printModule(this);
 }
@@ -2109,6 +2134,7 @@ void Value::print(raw_ostream &ROS, AssemblyAnnotationWriter *AAW) const {
     return;
   }
   formatted_raw_ostream OS(ROS);
+  BufferWhilePrinting Buffering(OS);
   if (const Instruction *I = dyn_cast<Instruction>(this)) {
     const Function *F = I->getParent() ? I->getParent()->getParent() : 0;
     SlotTracker SlotTable(F);
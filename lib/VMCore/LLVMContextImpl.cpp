@@ -35,6 +35,7 @@ LLVMContextImpl::LLVMContextImpl(LLVMContext &C)
     AlwaysOpaqueTy(new OpaqueType(C)) {
   InlineAsmDiagHandler = 0;
   InlineAsmDiagContext = 0;
+  DiscardValueNames = false;
       
   // Make sure the AlwaysOpaqueTy stays alive as long as the Context.
   AlwaysOpaqueTy->addRef();
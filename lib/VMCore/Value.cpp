@@ -166,6 +166,11 @@ void Value::setName(const Twine &NewName) {
   if (NewName.isTriviallyEmpty() && !hasName())
     return;
 
+  // Don't bother naming local values if the context drops their names.
+  if (!hasName() && !isa<GlobalValue>(this) &&
+      getContext().shouldDiscardValueNames())
+    return;
+
   SmallString<256> NameData;
   StringRef NameRef = NewName.toStringRef(NameData);
 
@@ -0,0 +1,47 @@
+; RUN: llvm-as < %s | cat > %t.memory.bc
+; RUN: llvm-as < %s -o %t.flushed.bc -bitcode-flush-threshold=4
+; RUN: cmp %t.memory.bc %t.flushed.bc
+; RUN: llvm-as < %s -o %t.parallel.bc -bitcode-flush-threshold=4 -bitcode-writer-threads=2
+; RUN: cmp %t.memory.bc %t.parallel.bc
+; RUN: llvm-dis < %t.flushed.bc | FileCheck %s
+
+; Writing to a file flushes the buffer every time a block is exited and the
+; threshold is reached.  With a tiny threshold every block is written out as
+; soon as it is finished, and the size fields of the enclosing blocks have to
+; be backpatched in the file.  The result must match the bitcode built in
+; memory, which is what is written to a pipe.
+
+%pair = type { i32, double }
+
+@g = global i32 0
+@p = global %pair { i32 1, double 2.5 }
+
+; CHECK: define i32 @f1
+define i32 @f1(i32 %x) {
+entry:
+  %a = add i32 %x, 42
+  store i32 %a, i32* @g, !foo !0
+  ret i32 %a
+}
+
+; CHECK: define double @f2
+define double @f2(%pair* %p) {
+  %q = getelementptr %pair* %p, i32 0, i32 1
+  %d = load double* %q
+  %r = fmul double %d, 3.5
+  ret double %r
+}
+
+; CHECK: define void @f3
+define void @f3(i1 %c) {
+entry:
+  br i1 %c, label %t, label %f
+t:
+  %v = call i32 @f1(i32 7)
+  br label %f
+f:
+  ret void
+}
+
+!0 = metadata !{i32 1, metadata !"node"}
+!named = !{!0}
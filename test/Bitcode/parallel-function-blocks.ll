@@ -0,0 +1,44 @@
+; RUN: llvm-as < %s > %t.serial.bc
+; RUN: llvm-as -bitcode-writer-threads=3 < %s > %t.parallel.bc
+; RUN: cmp %t.serial.bc %t.parallel.bc
+; RUN: llvm-dis < %t.parallel.bc | FileCheck %s
+
+; Function blocks encoded on several threads must be spliced back into the
+; module in order, byte for byte the same as the serial writer's output.
+
+@g = global i32 0
+
+; CHECK: define i32 @f1
+define i32 @f1(i32 %x) {
+entry:
+  %a = add i32 %x, 42
+  store i32 %a, i32* @g, !foo !0
+  ret i32 %a
+}
+
+; CHECK: define i8* @f2
+define i8* @f2(i1 %c) {
+entry:
+  br i1 %c, label %t, label %f
+t:
+  ret i8* blockaddress(@f2, %f)
+f:
+  ret i8* null
+}
+
+; CHECK: define double @f3
+define double @f3(double %d) {
+  %r = fmul double %d, 3.5
+  ret double %r
+}
+
+declare void @ext()
+
+; CHECK: define void @f4
+define void @f4() {
+  call void @ext()
+  %v = call i32 @f1(i32 7)
+  ret void
+}
+
+!0 = metadata !{i32 1}
@@ -0,0 +1,20 @@
+; RUN: llvm-as < %s | llvm-bcanalyzer -profile-reader |& FileCheck %s
+
+; CHECK: Reader Profile:
+; CHECK: Total read time:
+; CHECK: Block ID #12 (FUNCTION_BLOCK):
+; CHECK-NEXT: Num Instances: 2
+; CHECK: Percent Abbrevs:
+; CHECK: Record Read Times:
+; CHECK: INST_BINOP
+
+define i32 @f(i32 %x) {
+  %a = add i32 %x, 1
+  %b = mul i32 %a, %x
+  ret i32 %b
+}
+
+define i32 @g(i32 %x) {
+  %a = call i32 @f(i32 %x)
+  ret i32 %a
+}
@@ -0,0 +1,35 @@
+; RUN: llvm-as -bitcode-size-profile < %s | llvm-bcanalyzer -dump |& FileCheck %s -check-prefix=BC
+; RUN: llvm-as -bitcode-size-profile < %s | llvm-dis > %t.profile.ll
+; RUN: llvm-as < %s | llvm-dis > %t.default.ll
+; RUN: diff %t.default.ll %t.profile.ll
+
+; The size profile abbreviates DEBUG_LOC2 and METADATA_NODE2 records with
+; encodings picked from the module's own values; the reader must not notice.
+
+; BC: <METADATA_BLOCK
+; BC: <METADATA_NODE2 abbrevid=
+; BC: <FUNCTION_BLOCK
+; BC: <DEBUG_LOC2 abbrevid=
+
+define i32 @f(i32 %x) {
+entry:
+  %a = add i32 %x, 1, !dbg !0
+  %b = mul i32 %a, 3, !dbg !1
+  %c = sub i32 %b, %x, !dbg !2
+  ret i32 %c, !dbg !3
+}
+
+define i32 @g(i32 %x) {
+entry:
+  %a = add i32 %x, 2, !dbg !4
+  ret i32 %a, !dbg !5
+}
+
+!0 = metadata !{i32 10, i32 3, metadata !6, null}
+!1 = metadata !{i32 11, i32 5, metadata !6, null}
+!2 = metadata !{i32 12, i32 7, metadata !6, null}
+!3 = metadata !{i32 13, i32 3, metadata !6, null}
+!4 = metadata !{i32 20, i32 3, metadata !7, null}
+!5 = metadata !{i32 21, i32 3, metadata !7, null}
+!6 = metadata !{i32 524334, i32 0, metadata !"f"}
+!7 = metadata !{i32 524334, i32 0, metadata !"g"}
@@ -0,0 +1,51 @@
+; Test that testing several candidates at once gives the same reduction as
+; testing them one by one.
+;
+; RUN: bugpoint -load %llvmshlibdir/BugpointPasses%shlibext %s -output-prefix %t-serial -bugpoint-crashcalls -silence-passes > /dev/null
+; RUN: bugpoint -load %llvmshlibdir/BugpointPasses%shlibext %s -output-prefix %t -bugpoint-crashcalls -silence-passes -reduce-jobs=4 > /dev/null
+; RUN: llvm-dis < %t-serial-reduced-simplified.bc > %t-serial.ll
+; RUN: llvm-dis < %t-reduced-simplified.bc > %t.ll
+; RUN: diff %t-serial.ll %t.ll
+; RUN: FileCheck %s < %t.ll
+; REQUIRES: loadable_module
+
+; CHECK-NOT: @g
+; CHECK: define void @test
+; CHECK: call void @foo()
+; CHECK-NEXT: ret void
+; CHECK-NOT: define
+
+@g1 = global i32 1
+@g2 = global i32 2
+@g3 = global i32 3
+@g4 = global i32 4
+@g5 = global i32 5
+
+declare void @foo()
+
+define i32 @f1() { ret i32 1 }
+define i32 @f2() { ret i32 2 }
+define i32 @f3() { ret i32 3 }
+define i32 @f4() { ret i32 4 }
+define i32 @f5() { ret i32 5 }
+define i32 @f6() { ret i32 6 }
+define i32 @f7() { ret i32 7 }
+
+define void @test(i32* %p) {
+  store i32 1, i32* %p
+  %a = load i32* @g1
+  store i32 %a, i32* @g2
+  br label %b1
+b1:
+  %b = load i32* @g3
+  store i32 %b, i32* @g4
+  call void @foo()
+  br label %b2
+b2:
+  store i32 5, i32* @g5
+  ret void
+}
+
+define i32 @f8() { ret i32 8 }
+define i32 @f9() { ret i32 9 }
+define i32 @f10() { ret i32 10 }
@@ -0,0 +1,77 @@
+; REQUIRES: dagisel_direct_dispatch
+; RUN: llc < %s -march=x86-64 > %t.direct.s
+; RUN: llc < %s -march=x86-64 -use-isel-matcher-table > %t.table.s
+; RUN: diff %t.table.s %t.direct.s
+; RUN: llc < %s -march=x86-64 -O0 > %t.direct-O0.s
+; RUN: llc < %s -march=x86-64 -O0 -use-isel-matcher-table > %t.table-O0.s
+; RUN: diff %t.table-O0.s %t.direct-O0.s
+; RUN: llc < %s -march=x86 -mattr=+sse2 > %t.direct-32.s
+; RUN: llc < %s -march=x86 -mattr=+sse2 -use-isel-matcher-table > %t.table-32.s
+; RUN: diff %t.table-32.s %t.direct-32.s
+
+; The selector compiled with -dag-isel-direct-dispatch must pick the same
+; instructions as the matcher table it was compiled from.
+
+@g = global i32 0
+@arr = global [16 x i32] zeroinitializer
+
+define i32 @arith(i32 %a, i32 %b) nounwind {
+  %x = add i32 %a, 7
+  %y = sub i32 %x, %b
+  %z = mul i32 %y, 100000
+  %s = shl i32 %z, 3
+  %t = lshr i32 %s, %b
+  %u = and i32 %t, 255
+  %v = xor i32 %u, -1
+  ret i32 %v
+}
+
+define i64 @memory(i64* %p, i64 %i) nounwind {
+  %q = getelementptr i64* %p, i64 %i
+  %r = getelementptr i64* %q, i64 4
+  %x = load i64* %r
+  %y = add i64 %x, 1
+  store i64 %y, i64* %q
+  %a = getelementptr [16 x i32]* @arr, i64 0, i64 %i
+  %b = load i32* %a
+  %c = load i32* @g
+  %d = add i32 %b, %c
+  store i32 %d, i32* @g
+  %e = sext i32 %d to i64
+  %f = add i64 %e, %y
+  ret i64 %f
+}
+
+define i32 @control(i32 %a, i32 %b) nounwind {
+entry:
+  %c = icmp slt i32 %a, %b
+  br i1 %c, label %less, label %more
+less:
+  %m = select i1 %c, i32 %a, i32 %b
+  %n = call i32 @arith(i32 %m, i32 3)
+  ret i32 %n
+more:
+  %d = icmp ugt i32 %a, 10
+  %e = zext i1 %d to i32
+  ret i32 %e
+}
+
+define double @float(double %x, float %y) nounwind {
+  %z = fpext float %y to double
+  %a = fmul double %x, %z
+  %b = fadd double %a, 1.5
+  %c = fdiv double %b, %x
+  %d = fptosi double %c to i32
+  %e = sitofp i32 %d to double
+  ret double %e
+}
+
+define <4 x float> @vector(<4 x float> %a, <4 x float> %b, <4 x i32> %c) nounwind {
+  %x = fadd <4 x float> %a, %b
+  %y = fmul <4 x float> %x, %a
+  %z = shufflevector <4 x float> %y, <4 x float> %b, <4 x i32> <i32 0, i32 4, i32 1, i32 5>
+  %i = add <4 x i32> %c, %c
+  %j = bitcast <4 x i32> %i to <4 x float>
+  %k = fsub <4 x float> %z, %j
+  ret <4 x float> %k
+}
@@ -0,0 +1,46 @@
+; RUN: echo "" | llvm-as -o %t.1.bc
+; RUN: llvm-as %s -o %t.2.bc
+; RUN: llvm-link -only-needed %t.1.bc %t.2.bc -S | FileCheck %s
+; RUN: llvm-link %t.1.bc %t.2.bc -S | FileCheck %s -check-prefix=ALL
+
+@fp = global void ()* @from_global
+
+; CHECK: define void @root
+define void @root() {
+  call void @used()
+  ret void
+}
+
+; CHECK: define internal void @used
+define internal void @used() {
+  call void @used2()
+  ret void
+}
+
+; CHECK: define internal void @used2
+define internal void @used2() {
+  ret void
+}
+
+; CHECK: define internal void @from_global
+define internal void @from_global() {
+  ret void
+}
+
+; CHECK-NOT: @dead
+; CHECK-NOT: @ae_dead
+; ALL: define internal void @dead
+define internal void @dead() {
+  call void @dead2()
+  ret void
+}
+
+; ALL: define internal void @dead2
+define internal void @dead2() {
+  ret void
+}
+
+; ALL: define available_externally void @ae_dead
+define available_externally void @ae_dead() {
+  ret void
+}
@@ -0,0 +1,39 @@
+; RUN: llvm-as < %s > %t1.bc
+; RUN: echo {%T = type \{ i32, i32 \} @t = global %T zeroinitializer} | llvm-as > %t2.bc
+; RUN: llvm-link %t1.bc %t2.bc -o %t.serial.bc
+; RUN: llvm-link %t1.bc %t2.bc -bitcode-writer-threads=4 -o %t.parallel.bc
+; RUN: cmp %t.serial.bc %t.parallel.bc
+; RUN: llvm-dis < %t.parallel.bc | FileCheck %s
+
+; Linking resolves the opaque %T to the struct in the second module, so the
+; values below are left pointing at a forwarded type.  Encoding their
+; functions on several threads must not race to update its reference count.
+
+%T = type opaque
+
+; CHECK: define %T* @f1(%T* %p)
+define %T* @f1(%T* %p) {
+  %b = bitcast %T* %p to i8*
+  %q = bitcast i8* %b to %T*
+  ret %T* %q
+}
+
+; CHECK: define %T* @f2(%T* %p, i1 %c)
+define %T* @f2(%T* %p, i1 %c) {
+  %q = select i1 %c, %T* %p, %T* null
+  ret %T* %q
+}
+
+; CHECK: define %T* @f3()
+define %T* @f3() {
+  %q = call %T* @f1(%T* null)
+  %r = call %T* @f2(%T* %q, i1 true)
+  ret %T* %r
+}
+
+; CHECK: define void @f4(%T** %pp)
+define void @f4(%T** %pp) {
+  %p = load %T** %pp
+  store %T* %p, %T** %pp
+  ret void
+}
@@ -0,0 +1,29 @@
+; RUN: opt < %s -basicaa -gvn -S | FileCheck %s
+; RUN: opt < %s -basicaa -gvn -memdep-block-scan-limit=2 -S \
+; RUN:   | FileCheck %s -check-prefix=LIMIT
+
+; When the scan runs out of budget memdep reports a clobber, so the second
+; load is only removed when the whole block may be scanned.
+
+define i32 @test(i32* %P) nounwind {
+entry:
+  %A = alloca i32
+  %B = alloca i32
+  %C = alloca i32
+  %v1 = load i32* %P
+  store i32 0, i32* %A
+  store i32 0, i32* %B
+  store i32 0, i32* %C
+  %v2 = load i32* %P
+  %r = add i32 %v1, %v2
+  ret i32 %r
+; CHECK: @test
+; CHECK: load i32* %P
+; CHECK-NOT: load
+; CHECK: ret i32
+
+; LIMIT: @test
+; LIMIT: %v1 = load i32* %P
+; LIMIT: %v2 = load i32* %P
+; LIMIT: ret i32
+}
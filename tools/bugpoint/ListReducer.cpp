@@ -0,0 +1,104 @@
+//===- ListReducer.cpp - Speculative testing support for ListReducer ------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the child process support ListReducer uses to test
+// several candidate lists at the same time.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ListReducer.h"
+#include "llvm/Config/config.h"
+#include "llvm/Support/CommandLine.h"
+#ifdef LLVM_ON_UNIX
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+using namespace llvm;
+
+unsigned llvm::ReductionJobs;
+
+static cl::opt<unsigned, true>
+ReductionJobsOpt("reduce-jobs", cl::location(ReductionJobs), cl::init(1),
+                 cl::value_desc("N"),
+                 cl::desc("Number of candidate reductions to test at the same "
+                          "time (default is 1)"));
+
+bool llvm::RunSpeculatively(int (*Fn)(void *Data, unsigned Idx), void *Data,
+                            unsigned N, std::vector<int> &Results) {
+#ifdef LLVM_ON_UNIX
+  // Don't let the children inherit (and print a second time) buffered output.
+  outs().flush();
+  errs().flush();
+
+  // Each child sends its result back through a pipe rather than its exit
+  // status, so that a child that crashes or is killed cannot pass for one
+  // that returned a result.
+  std::vector<pid_t> Children(N, -1);
+  std::vector<int> Pipes(N, -1);
+  for (unsigned i = 1; i != N; ++i) {
+    int FDs[2];
+    if (pipe(FDs) == -1)
+      continue;
+    pid_t Child = fork();
+    if (Child == 0) {
+      close(FDs[0]);
+      // Only the parent reports progress; it repeats the test of the
+      // candidate it accepts.
+      int DevNull = open("/dev/null", O_WRONLY);
+      if (DevNull != -1) {
+        dup2(DevNull, 1);
+        dup2(DevNull, 2);
+      }
+      int Result = Fn(Data, i);
+      ssize_t Written;
+      do
+        Written = write(FDs[1], &Result, sizeof(Result));
+      while (Written == -1 && errno == EINTR);
+      // Skip the parent's atexit handlers and static destructors.
+      _exit(Written == sizeof(Result) ? 0 : 1);
+    }
+    close(FDs[1]);
+    if (Child == -1) {
+      close(FDs[0]);
+      continue;
+    }
+    Children[i] = Child;
+    Pipes[i] = FDs[0];
+  }
+
+  Results.assign(N, -1);
+  Results[0] = Fn(Data, 0);
+
+  for (unsigned i = 1; i != N; ++i) {
+    if (Children[i] == -1)
+      continue;
+    int Result;
+    ssize_t Read;
+    do
+      Read = read(Pipes[i], &Result, sizeof(Result));
+    while (Read == -1 && errno == EINTR);
+    close(Pipes[i]);
+
+    int Status;
+    pid_t Waited;
+    do
+      Waited = waitpid(Children[i], &Status, 0);
+    while (Waited == -1 && errno == EINTR);
+    if (Read == sizeof(Result) && Waited == Children[i] &&
+        WIFEXITED(Status) && WEXITSTATUS(Status) == 0)
+      Results[i] = Result;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
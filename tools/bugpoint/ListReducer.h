@@ -25,6 +25,19 @@ namespace llvm {
   
   extern bool BugpointIsInterrupted;
 
+  /// ReductionJobs - The number of candidate lists ListReducer may test at the
+  /// same time (-reduce-jobs).  One means the reduction is entirely serial.
+  extern unsigned ReductionJobs;
+
+  /// RunSpeculatively - Call Fn(Data, i) for each i in [0, N), all at the same
+  /// time: i == 0 in this process, and every other i in a child process of its
+  /// own.  Store what each call returns in Results[i].  A child that cannot be
+  /// started, or that dies before it reports a result, gets -1.  Returns false
+  /// without running anything if child processes are not supported on this
+  /// host.
+  bool RunSpeculatively(int (*Fn)(void *Data, unsigned Idx), void *Data,
+                        unsigned N, std::vector<int> &Results);
+
 template<typename ElTy>
 struct ListReducer {
   enum TestResult {
@@ -45,6 +58,53 @@ struct ListReducer {
                             std::vector<ElTy> &Kept,
                             std::string &Error) = 0;
 
+private:
+  struct SpeculativeTests {
+    ListReducer *Reducer;
+    std::vector<std::vector<ElTy> > *Prefixes;
+    std::vector<std::vector<ElTy> > *Kepts;
+    std::string *Error;
+  };
+
+  static int runSpeculativeTest(void *Data, unsigned Idx) {
+    SpeculativeTests &ST = *static_cast<SpeculativeTests*>(Data);
+    std::string ChildError;
+    return ST.Reducer->doTest((*ST.Prefixes)[Idx], (*ST.Kepts)[Idx],
+                              Idx == 0 ? *ST.Error : ChildError);
+  }
+
+  // testSpeculatively - Test the (Prefixes[0], Kepts[0]) candidate in this
+  // process, and the others in child processes at the same time.  Store
+  // the result of the first test in Result, and set NumSkipped to how many of
+  // the candidates after it gave a result that leaves the list alone:
+  // NoFailure, plus KeepPrefix if PrefixIsFailure is false.
+  //
+  // If the first candidate leaves the list alone as well, the caller skips
+  // it and the ones counted, and tests the next candidate itself, so the
+  // side effects of every test that is accepted happen in this process and
+  // the final list is the same as the one the serial reduction produces.
+  // Returns false, without testing anything, if speculation is not possible.
+  //
+  bool testSpeculatively(std::vector<std::vector<ElTy> > &Prefixes,
+                         std::vector<std::vector<ElTy> > &Kepts,
+                         bool PrefixIsFailure, std::string &Error,
+                         TestResult &Result, unsigned &NumSkipped) {
+    SpeculativeTests ST = { this, &Prefixes, &Kepts, &Error };
+    std::vector<int> Results;
+    if (!RunSpeculatively(runSpeculativeTest, &ST, Prefixes.size(), Results))
+      return false;
+
+    Result = TestResult(Results[0]);
+    for (NumSkipped = 0; NumSkipped + 1 != Results.size(); ++NumSkipped) {
+      int R = Results[NumSkipped + 1];
+      if (R != NoFailure && (PrefixIsFailure || R != KeepPrefix))
+        break;
+    }
+    return true;
+  }
+
+public:
+
   // reduceList - This function attempts to reduce the length of the specified
   // list while still maintaining the "test" property.  This is the core of the
   // "work" that bugpoint does.
@@ -112,11 +172,55 @@ Backjump:
         NumOfIterationsWithoutProgress = 0;
       }
       
+      // With several jobs, test this split while child processes test the
+      // ones that the following NoFailure outcomes would lead to, and skip
+      // straight past the splits that do not reproduce the failure.
+      // Speculation stops before the next shuffle, which has to happen in
+      // order.
+      std::vector<ElTy> Prefix, Suffix;
+      TestResult Result = NoFailure;
+      bool Tested = false;
+      if (ReductionJobs > 1) {
+        std::vector<std::vector<ElTy> > Prefixes, Suffixes;
+        for (unsigned Top = MidTop, N = NumOfIterationsWithoutProgress;
+             Top > 1 && Prefixes.size() < ReductionJobs; Top /= 2, ++N) {
+          if (!Prefixes.empty() && ShufflingEnabled && N > MaxIterations)
+            break;
+          Prefixes.push_back(std::vector<ElTy>(TheList.begin(),
+                                               TheList.begin()+Top/2));
+          Suffixes.push_back(std::vector<ElTy>(TheList.begin()+Top/2,
+                                               TheList.end()));
+        }
+        unsigned NumSkipped;
+        if (Prefixes.size() > 1 &&
+            testSpeculatively(Prefixes, Suffixes, true, Error, Result,
+                              NumSkipped)) {
+          if (Result == NoFailure) {
+            // Skip this split and the ones shown not to reproduce the
+            // failure.  If that leaves a split that was tested, test it again
+            // below for its side effects.
+            for (unsigned i = 0; i != NumSkipped + 1; ++i) {
+              MidTop /= 2;
+              NumOfIterationsWithoutProgress++;
+            }
+            if (NumSkipped + 1 == Prefixes.size())
+              continue;
+          } else {
+            Prefix.swap(Prefixes[0]);
+            Suffix.swap(Suffixes[0]);
+            Tested = true;
+          }
+        }
+      }
+
       unsigned Mid = MidTop / 2;
-      std::vector<ElTy> Prefix(TheList.begin(), TheList.begin()+Mid);
-      std::vector<ElTy> Suffix(TheList.begin()+Mid, TheList.end());
+      if (!Tested) {
+        Prefix.assign(TheList.begin(), TheList.begin()+Mid);
+        Suffix.assign(TheList.begin()+Mid, TheList.end());
+        Result = doTest(Prefix, Suffix, Error);
+      }
 
-      switch (doTest(Prefix, Suffix, Error)) {
+      switch (Result) {
       case KeepSuffix:
         // The property still holds.  We can just drop the prefix elements, and
         // shorten the list to the "kept" elements.
@@ -174,10 +278,46 @@ Backjump:
             return true;
           }
           
-          std::vector<ElTy> TestList(TheList);
-          TestList.erase(TestList.begin()+i);
+          // Try removing the next few interior elements on their own at the
+          // same time, and move on to the first one that can go.
+          std::vector<ElTy> TestList;
+          TestResult Result = NoFailure;
+          bool Tested = false;
+          if (ReductionJobs > 1) {
+            std::vector<std::vector<ElTy> > Empties, TestLists;
+            for (unsigned j = i; j < TheList.size()-1 &&
+                                 TestLists.size() < ReductionJobs; ++j) {
+              Empties.push_back(EmptyList);
+              TestLists.push_back(TheList);
+              TestLists.back().erase(TestLists.back().begin()+j);
+            }
+            unsigned NumSkipped;
+            if (TestLists.size() > 1 &&
+                testSpeculatively(Empties, TestLists, false, Error, Result,
+                                  NumSkipped)) {
+              if (Result == KeepSuffix || !Error.empty()) {
+                TestList.swap(TestLists[0]);
+                Tested = true;
+              } else {
+                // Element i has to stay, and so do the ones after it that
+                // were shown to.  Test the next one again below, for its
+                // side effects.
+                i += NumSkipped + 1;
+                if (NumSkipped + 1 == TestLists.size()) {
+                  --i;
+                  continue;
+                }
+              }
+            }
+          }
+
+          if (!Tested) {
+            TestList = TheList;
+            TestList.erase(TestList.begin()+i);
+            Result = doTest(EmptyList, TestList, Error);
+          }
 
-          if (doTest(EmptyList, TestList, Error) == KeepSuffix) {
+          if (Result == KeepSuffix) {
             // We can trim down the list!
             TheList.swap(TestList);
             --i;  // Don't skip an element of the list
@@ -27,6 +27,8 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
 #include "llvm/ADT/OwningPtr.h"
 #include "llvm/Analysis/Verifier.h"
 #include "llvm/Bitcode/BitstreamReader.h"
@@ -50,6 +52,16 @@ static cl::opt<std::string>
 
 static cl::opt<bool> Dump("dump", cl::desc("Dump low level bitcode trace"));
 
+static cl::opt<bool>
+  ProfileReader("profile-reader",
+                cl::desc("Time the bitcode reader on each block and record "
+                         "kind"));
+
+static cl::opt<std::string>
+  BaselineFilename("baseline", cl::value_desc("filename"),
+                   cl::desc("Report how the size of each block changed "
+                            "relative to this bitcode file"));
+
 //===----------------------------------------------------------------------===//
 // Bitcode specific analysis.
 //===----------------------------------------------------------------------===//
@@ -317,6 +329,9 @@ struct PerBlockIDStats {
 
 static std::map<unsigned, PerBlockIDStats> BlockIDStats;
 
+/// BaselineStats - The per-block statistics of the -baseline file.
+static std::map<unsigned, PerBlockIDStats> BaselineStats;
+
 
 
 /// Error - All bitcode analysis errors go through this function, making this a
@@ -479,14 +494,110 @@ static void PrintSize(uint64_t Bits) {
 }
 
 
-/// AnalyzeBitcode - Analyze the bitcode file specified by InputFilename.
-static int AnalyzeBitcode() {
-  // Read the input file.
-  OwningPtr<MemoryBuffer> MemBuf;
+/// PrintReaderProfile - Read the module in MemBuf with the bitcode reader, and
+/// print how long it spent on each block and record kind.
+static bool PrintReaderProfile(MemoryBuffer *MemBuf,
+                               BitstreamReader &StreamFile) {
+  LLVMContext Context;
+  BitcodeReadProfile Profile;
+  std::string ErrorMsg;
+  Module *M = ProfileBitcodeFile(MemBuf, Context, Profile, &ErrorMsg);
+  if (!M)
+    return Error("Error reading bitcode: " + ErrorMsg);
+  delete M;
+
+  typedef std::map<unsigned, BitcodeReadProfile::Entry>::iterator block_iterator;
+  typedef std::map<std::pair<unsigned, unsigned>,
+                   BitcodeReadProfile::Entry>::iterator record_iterator;
+
+  uint64_t TotalTime = 0;
+  for (block_iterator I = Profile.Blocks.begin(), E = Profile.Blocks.end();
+       I != E; ++I)
+    TotalTime += I->second.Microseconds;
+
+  errs() << "Reader Profile:\n";
+  errs() << "    Total read time: " << format("%.3fms", TotalTime/1000.0)
+         << "\n\n";
+
+  for (block_iterator I = Profile.Blocks.begin(), E = Profile.Blocks.end();
+       I != E; ++I) {
+    unsigned BlockID = I->first;
+    errs() << "  Block ID #" << BlockID;
+    if (const char *BlockName = GetBlockName(BlockID, StreamFile))
+      errs() << " (" << BlockName << ")";
+    errs() << ":\n";
+    errs() << "      Num Instances: " << I->second.Count << "\n";
+    errs() << "          Read Time: "
+           << format("%.3fms", I->second.Microseconds/1000.0);
+    if (TotalTime)
+      errs() << format(" (%2.4f%%)", I->second.Microseconds*100.0/TotalTime);
+    errs() << "\n";
 
+    // Collect this block's records, most expensive first.
+    std::vector<std::pair<uint64_t, unsigned> > TimePairs; // <time,code>
+    uint64_t NumRecords = 0, NumAbbreviated = 0;
+    for (record_iterator RI =
+           Profile.Records.lower_bound(std::make_pair(BlockID, 0U)),
+         RE = Profile.Records.end(); RI != RE && RI->first.first == BlockID;
+         ++RI) {
+      TimePairs.push_back(std::make_pair(RI->second.Microseconds,
+                                         RI->first.second));
+      NumRecords += RI->second.Count;
+      NumAbbreviated += RI->second.NumAbbreviated;
+    }
+    if (NumRecords)
+      errs() << "    Percent Abbrevs: "
+             << format("%2.4f%%", NumAbbreviated*100.0/NumRecords) << "\n";
+    errs() << "\n";
+
+    if (NoHistogram || TimePairs.empty())
+      continue;
+    std::stable_sort(TimePairs.begin(), TimePairs.end());
+    std::reverse(TimePairs.begin(), TimePairs.end());
+
+    errs() << "\tRecord Read Times:\n";
+    fprintf(stderr, "\t\t  Count  Time(us)    %% Abv  Record Kind\n");
+    for (unsigned i = 0, e = TimePairs.size(); i != e; ++i) {
+      unsigned Code = TimePairs[i].second;
+      const BitcodeReadProfile::Entry &RecStats =
+        Profile.Records[std::make_pair(BlockID, Code)];
+      fprintf(stderr, "\t\t%7llu %9llu ", (unsigned long long)RecStats.Count,
+              (unsigned long long)RecStats.Microseconds);
+      if (RecStats.NumAbbreviated)
+        fprintf(stderr, "%7.2f  ",
+                (double)RecStats.NumAbbreviated/RecStats.Count*100);
+      else
+        fprintf(stderr, "         ");
+
+      if (const char *CodeName = GetCodeName(Code, BlockID, StreamFile))
+        fprintf(stderr, "%s\n", CodeName);
+      else
+        fprintf(stderr, "UnknownCode%d\n", Code);
+    }
+    errs() << "\n";
+  }
+  return false;
+}
+
+/// PrintSizeChange - Print how NewBits compares to the -baseline size OldBits.
+static void PrintSizeChange(uint64_t OldBits, uint64_t NewBits) {
+  errs() << "      Baseline Size: ";
+  PrintSize(OldBits);
+  int64_t Delta = (int64_t)NewBits - (int64_t)OldBits;
+  errs() << " (" << (Delta >= 0 ? "+" : "") << Delta << "b";
+  if (OldBits)
+    errs() << ", " << format("%+.2f%%", Delta * 100.0 / OldBits);
+  errs() << ")\n";
+}
+
+/// OpenBitcodeFile - Read Filename into MemBuf and point StreamFile at the
+/// bitstream it contains.
+static bool OpenBitcodeFile(const std::string &Filename,
+                            OwningPtr<MemoryBuffer> &MemBuf,
+                            BitstreamReader &StreamFile) {
   if (error_code ec =
-        MemoryBuffer::getFileOrSTDIN(InputFilename.c_str(), MemBuf))
-    return Error("Error reading '" + InputFilename + "': " + ec.message());
+        MemoryBuffer::getFileOrSTDIN(Filename.c_str(), MemBuf))
+    return Error("Error reading '" + Filename + "': " + ec.message());
 
   if (MemBuf->getBufferSize() & 3)
     return Error("Bitcode stream should be a multiple of 4 bytes in length");
@@ -500,7 +611,56 @@ static int AnalyzeBitcode() {
     if (SkipBitcodeWrapperHeader(BufPtr, EndBufPtr))
       return Error("Invalid bitcode wrapper header");
 
-  BitstreamReader StreamFile(BufPtr, EndBufPtr);
+  StreamFile.init(BufPtr, EndBufPtr);
+  return false;
+}
+
+/// ReadBaselineStats - Gather the per-block statistics of the -baseline file
+/// into BaselineStats, and its size in bits into BaselineBits.
+static bool ReadBaselineStats(uint64_t &BaselineBits) {
+  OwningPtr<MemoryBuffer> MemBuf;
+  BitstreamReader StreamFile;
+  if (OpenBitcodeFile(BaselineFilename, MemBuf, StreamFile))
+    return true;
+  BaselineBits = (StreamFile.getLastChar()-StreamFile.getFirstChar())*CHAR_BIT;
+
+  BitstreamCursor Stream(StreamFile);
+  for (unsigned i = 0; i != 4; ++i)   // Skip the signature.
+    Stream.Read(8);
+
+  // Don't dump the baseline file.
+  bool SavedDump = Dump;
+  Dump = false;
+  while (!Stream.AtEndOfStream()) {
+    if (Stream.ReadCode() != bitc::ENTER_SUBBLOCK) {
+      Dump = SavedDump;
+      return Error("Invalid record at top-level of baseline");
+    }
+    if (ParseBlock(Stream, 0)) {
+      Dump = SavedDump;
+      return true;
+    }
+  }
+  Dump = SavedDump;
+
+  BaselineStats.swap(BlockIDStats);
+  return false;
+}
+
+/// AnalyzeBitcode - Analyze the bitcode file specified by InputFilename.
+static int AnalyzeBitcode() {
+  uint64_t BaselineBits = 0;
+  if (!BaselineFilename.empty() && ReadBaselineStats(BaselineBits))
+    return true;
+
+  // Read the input file.
+  OwningPtr<MemoryBuffer> MemBuf;
+  BitstreamReader StreamFile;
+  if (OpenBitcodeFile(InputFilename, MemBuf, StreamFile))
+    return true;
+
+  const unsigned char *BufPtr = StreamFile.getFirstChar();
+  const unsigned char *EndBufPtr = StreamFile.getLastChar();
   BitstreamCursor Stream(StreamFile);
   StreamFile.CollectBlockInfoNames();
 
@@ -541,6 +701,8 @@ static int AnalyzeBitcode() {
   errs() << "         Total size: ";
   PrintSize(BufferSizeBits);
   errs() << "\n";
+  if (!BaselineFilename.empty())
+    PrintSizeChange(BaselineBits, BufferSizeBits);
   errs() << "        Stream type: ";
   switch (CurStreamType) {
   default: assert(0 && "Unknown bitstream type");
@@ -566,6 +728,8 @@ static int AnalyzeBitcode() {
     errs() << "\n";
     double pct = (Stats.NumBits * 100.0) / BufferSizeBits;
     errs() << "    Percent of file: " << format("%2.4f%%", pct) << "\n";
+    if (!BaselineFilename.empty())
+      PrintSizeChange(BaselineStats[I->first].NumBits, Stats.NumBits);
     if (Stats.NumInstances > 1) {
       errs() << "       Average Size: ";
       PrintSize(Stats.NumBits/(double)Stats.NumInstances);
@@ -620,6 +784,22 @@ static int AnalyzeBitcode() {
 
     }
   }
+
+  // Mention the blocks that only the baseline has.
+  for (std::map<unsigned, PerBlockIDStats>::iterator I = BaselineStats.begin(),
+       E = BaselineStats.end(); I != E; ++I) {
+    if (BlockIDStats.count(I->first) || !I->second.NumInstances)
+      continue;
+    errs() << "  Block ID #" << I->first;
+    if (const char *BlockName = GetBlockName(I->first, StreamFile))
+      errs() << " (" << BlockName << ")";
+    errs() << ": only in baseline\n";
+    PrintSizeChange(I->second.NumBits, 0);
+    errs() << "\n";
+  }
+
+  if (ProfileReader && PrintReaderProfile(MemBuf.get(), StreamFile))
+    return true;
   return 0;
 }
 
@@ -0,0 +1,217 @@
+//===- llvm/unittest/ADT/ConcurrentDenseMapTest.cpp - Concurrent map tests ===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+#include "llvm/ADT/ConcurrentDenseMap.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+typedef ConcurrentDenseMap<unsigned, unsigned> MapTy;
+
+TEST(ConcurrentDenseMapTest, EmptyMap) {
+  MapTy Map;
+  EXPECT_EQ(0u, Map.size());
+  EXPECT_TRUE(Map.empty());
+  EXPECT_EQ(0u, Map.count(1));
+  EXPECT_EQ(0u, Map.lookup(1));
+  EXPECT_FALSE(Map.erase(1));
+}
+
+TEST(ConcurrentDenseMapTest, InsertLookupErase) {
+  MapTy Map;
+  EXPECT_TRUE(Map.insert(std::make_pair(1u, 10u)));
+  EXPECT_FALSE(Map.insert(std::make_pair(1u, 20u)));
+  EXPECT_EQ(1u, Map.size());
+  EXPECT_EQ(1u, Map.count(1));
+  EXPECT_EQ(10u, Map.lookup(1));
+
+  unsigned Val = 0;
+  EXPECT_TRUE(Map.lookup(1, Val));
+  EXPECT_EQ(10u, Val);
+  EXPECT_FALSE(Map.lookup(2, Val));
+
+  EXPECT_TRUE(Map.erase(1));
+  EXPECT_FALSE(Map.erase(1));
+  EXPECT_EQ(0u, Map.size());
+  EXPECT_EQ(0u, Map.count(1));
+
+  // Erased keys can be inserted again.
+  EXPECT_TRUE(Map.insert(std::make_pair(1u, 30u)));
+  EXPECT_EQ(30u, Map.lookup(1));
+}
+
+// The DenseMapInfo empty and tombstone keys are ordinary keys here.
+TEST(ConcurrentDenseMapTest, ReservedKeys) {
+  MapTy Map;
+  unsigned EmptyKey = DenseMapInfo<unsigned>::getEmptyKey();
+  unsigned TombstoneKey = DenseMapInfo<unsigned>::getTombstoneKey();
+  EXPECT_TRUE(Map.insert(std::make_pair(EmptyKey, 1u)));
+  EXPECT_TRUE(Map.insert(std::make_pair(TombstoneKey, 2u)));
+  EXPECT_EQ(1u, Map.lookup(EmptyKey));
+  EXPECT_EQ(2u, Map.lookup(TombstoneKey));
+}
+
+TEST(ConcurrentDenseMapTest, Rehash) {
+  MapTy Map(16);
+  for (unsigned i = 0; i != 10000; ++i)
+    EXPECT_TRUE(Map.insert(std::make_pair(i, i * 2)));
+  EXPECT_EQ(10000u, Map.size());
+  for (unsigned i = 0; i != 10000; ++i)
+    EXPECT_EQ(i * 2, Map.lookup(i));
+
+  // Erasing and inserting over and over rehashes away the erased entries
+  // rather than growing the table further.
+  for (unsigned i = 0; i != 100000; ++i) {
+    EXPECT_TRUE(Map.erase(i % 100));
+    EXPECT_TRUE(Map.insert(std::make_pair(i % 100, i)));
+  }
+  EXPECT_EQ(10000u, Map.size());
+  for (unsigned i = 0; i != 100; ++i)
+    EXPECT_EQ(99900 + i, Map.lookup(i));
+  size_t Size = Map.getMemorySize();
+  Map.reclaim();
+  EXPECT_GT(Size, Map.getMemorySize());
+
+  MapTy Fresh(16);
+  for (unsigned i = 0; i != 10000; ++i)
+    Fresh.insert(std::make_pair(i, i));
+  Fresh.reclaim();
+  EXPECT_GE(2 * Fresh.getMemorySize(), Map.getMemorySize());
+}
+
+struct InsertRange {
+  MapTy *Map;
+  unsigned Begin, End;
+  volatile sys::cas_flag *Inserted, *Missing;
+
+  static void run(void *Arg) {
+    InsertRange *R = static_cast<InsertRange*>(Arg);
+    for (unsigned i = R->Begin; i != R->End; ++i) {
+      if (R->Map->insert(std::make_pair(i, i + 1)))
+        sys::AtomicIncrement(R->Inserted);
+      if (R->Map->lookup(i) != i + 1)
+        sys::AtomicIncrement(R->Missing);
+    }
+  }
+};
+
+// Several threads insert overlapping ranges of keys into a map that starts
+// out small, so that they race on the same buckets and on rehashing.
+TEST(ConcurrentDenseMapTest, ConcurrentInsert) {
+  MapTy Map(16);
+  volatile sys::cas_flag Inserted = 0, Missing = 0;
+  std::vector<InsertRange> Ranges;
+  for (unsigned i = 0; i != 16; ++i) {
+    InsertRange R = { &Map, (i % 4) * 5000, (i % 4) * 5000 + 10000,
+                      &Inserted, &Missing };
+    Ranges.push_back(R);
+  }
+
+  ThreadPool Pool(4);
+  TaskGroup G(Pool);
+  for (unsigned i = 0, e = Ranges.size(); i != e; ++i)
+    G.spawn(&InsertRange::run, &Ranges[i]);
+  G.wait();
+
+  EXPECT_EQ(25000u, Inserted);
+  EXPECT_EQ(0u, Missing);
+  EXPECT_EQ(25000u, Map.size());
+  for (unsigned i = 0; i != 25000; ++i)
+    EXPECT_EQ(i + 1, Map.lookup(i));
+}
+
+// A mix of lookups and inserts on random keys, as a map shared by several
+// threads sees it.  Each thread does NumOps operations on NumKeys keys, one
+// in 16 of them an insert.
+struct MixedOps {
+  enum { NumOps = 2000000, NumKeys = 200000 };
+
+  MapTy *Map;
+  DenseMap<unsigned, unsigned> *LockedMap;
+  sys::Mutex *Lock;
+  unsigned Seed, Found;
+
+  static void runConcurrent(void *Arg) {
+    MixedOps *M = static_cast<MixedOps*>(Arg);
+    unsigned X = M->Seed;
+    for (unsigned i = 0; i != NumOps; ++i) {
+      X = X * 1103515245 + 12345;
+      unsigned Key = (X >> 8) % NumKeys;
+      if ((X >> 4) % 16 == 0)
+        M->Map->insert(std::make_pair(Key, Key));
+      else if (M->Map->count(Key))
+        ++M->Found;
+    }
+  }
+
+  static void runLocked(void *Arg) {
+    MixedOps *M = static_cast<MixedOps*>(Arg);
+    unsigned X = M->Seed;
+    for (unsigned i = 0; i != NumOps; ++i) {
+      X = X * 1103515245 + 12345;
+      unsigned Key = (X >> 8) % NumKeys;
+      sys::ScopedLock L(*M->Lock);
+      if ((X >> 4) % 16 == 0)
+        M->LockedMap->insert(std::make_pair(Key, Key));
+      else if (M->LockedMap->count(Key))
+        ++M->Found;
+    }
+  }
+};
+
+double getWallTime() {
+  return TimeRecord::getCurrentTime(false).getWallTime();
+}
+
+// Compare the map against a DenseMap behind a mutex, for 1 to 8
+// threads.  Disabled by default; run it with --gtest_also_run_disabled_tests.
+TEST(ConcurrentDenseMapTest, DISABLED_Contention) {
+  for (unsigned NumThreads = 1; NumThreads <= 8; NumThreads *= 2) {
+    ThreadPool Pool(NumThreads);
+    double Times[2];
+    unsigned Sizes[2];
+    for (unsigned Locked = 0; Locked != 2; ++Locked) {
+      MapTy Map;
+      DenseMap<unsigned, unsigned> LockedMap;
+      sys::Mutex Lock;
+      std::vector<MixedOps> Ops;
+      for (unsigned i = 0; i != NumThreads; ++i) {
+        MixedOps M = { &Map, &LockedMap, &Lock, i + 1, 0 };
+        Ops.push_back(M);
+      }
+
+      double Start = getWallTime();
+      {
+        TaskGroup G(Pool);
+        for (unsigned i = 0; i != NumThreads; ++i)
+          G.spawn(Locked ? &MixedOps::runLocked : &MixedOps::runConcurrent,
+                  &Ops[i]);
+      }
+      Times[Locked] = getWallTime() - Start;
+      Sizes[Locked] = Locked ? LockedMap.size() : Map.size();
+    }
+    // Both runs insert the same keys.
+    EXPECT_EQ(Sizes[1], Sizes[0]);
+
+    outs() << format("%u threads: Mutex+DenseMap %.3fs, ", NumThreads,
+                     Times[1])
+           << format("ConcurrentDenseMap %.3fs\n", Times[0]);
+  }
+}
+
+}
@@ -0,0 +1,347 @@
+//===------ ADT/SparseSetTest.cpp - SparseSet unit tests -  -----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/SparseSet.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+
+typedef SparseSet<unsigned> USet;
+
+// Empty set tests.
+TEST(SparseSetTest, EmptySet) {
+  USet Set;
+  EXPECT_TRUE(Set.empty());
+  EXPECT_TRUE(Set.begin() == Set.end());
+  EXPECT_EQ(0u, Set.size());
+
+  Set.setUniverse(10);
+
+  // Lookups on empty set.
+  EXPECT_TRUE(Set.find(0) == Set.end());
+  EXPECT_TRUE(Set.find(9) == Set.end());
+
+  // Same thing on a const reference.
+  const USet &CSet = Set;
+  EXPECT_TRUE(CSet.empty());
+  EXPECT_TRUE(CSet.begin() == CSet.end());
+  EXPECT_EQ(0u, CSet.size());
+  EXPECT_TRUE(CSet.find(0) == CSet.end());
+  USet::const_iterator I = CSet.find(5);
+  EXPECT_TRUE(I == CSet.end());
+}
+
+// Single entry set tests.
+TEST(SparseSetTest, SingleEntrySet) {
+  USet Set;
+  Set.setUniverse(10);
+  std::pair<USet::iterator, bool> IP = Set.insert(5);
+  EXPECT_TRUE(IP.second);
+  EXPECT_TRUE(IP.first == Set.begin());
+
+  EXPECT_FALSE(Set.empty());
+  EXPECT_FALSE(Set.begin() == Set.end());
+  EXPECT_TRUE(Set.begin() + 1 == Set.end());
+  EXPECT_EQ(1u, Set.size());
+
+  EXPECT_TRUE(Set.find(0) == Set.end());
+  EXPECT_TRUE(Set.find(9) == Set.end());
+
+  EXPECT_FALSE(Set.count(0));
+  EXPECT_TRUE(Set.count(5));
+
+  // Redundant insert.
+  IP = Set.insert(5);
+  EXPECT_FALSE(IP.second);
+  EXPECT_TRUE(IP.first == Set.begin());
+
+  // Erase non-existent element.
+  EXPECT_FALSE(Set.erase(1));
+  EXPECT_EQ(1u, Set.size());
+  EXPECT_EQ(5u, *Set.begin());
+
+  // Erase iterator.
+  USet::iterator I = Set.find(5);
+  EXPECT_TRUE(I == Set.begin());
+  I = Set.erase(I);
+  EXPECT_TRUE(I == Set.end());
+  EXPECT_TRUE(Set.empty());
+}
+
+// Multiple entry set tests.
+TEST(SparseSetTest, MultipleEntrySet) {
+  USet Set;
+  Set.setUniverse(10);
+
+  Set.insert(5);
+  Set.insert(3);
+  Set.insert(2);
+  Set.insert(1);
+  Set.insert(4);
+  EXPECT_EQ(5u, Set.size());
+
+  // Without deletions, iteration order == insertion order.
+  USet::const_iterator I = Set.begin();
+  EXPECT_EQ(5u, *I);
+  ++I;
+  EXPECT_EQ(3u, *I);
+  ++I;
+  EXPECT_EQ(2u, *I);
+  ++I;
+  EXPECT_EQ(1u, *I);
+  ++I;
+  EXPECT_EQ(4u, *I);
+  ++I;
+  EXPECT_TRUE(I == Set.end());
+
+  // Redundant insert.
+  std::pair<USet::iterator, bool> IP = Set.insert(3);
+  EXPECT_FALSE(IP.second);
+  EXPECT_TRUE(IP.first == Set.begin() + 1);
+
+  // Erase last element by key.
+  EXPECT_TRUE(Set.erase(4));
+  EXPECT_EQ(4u, Set.size());
+  EXPECT_FALSE(Set.count(4));
+  EXPECT_FALSE(Set.erase(4));
+  EXPECT_EQ(4u, Set.size());
+  EXPECT_FALSE(Set.count(4));
+
+  // Erase first element by key.
+  EXPECT_TRUE(Set.count(5));
+  EXPECT_TRUE(Set.find(5) == Set.begin());
+  EXPECT_TRUE(Set.erase(5));
+  EXPECT_EQ(3u, Set.size());
+  EXPECT_FALSE(Set.count(5));
+  EXPECT_FALSE(Set.erase(5));
+  EXPECT_EQ(3u, Set.size());
+  EXPECT_FALSE(Set.count(5));
+
+  Set.insert(6);
+  Set.insert(7);
+  EXPECT_EQ(5u, Set.size());
+
+  // Erase last element by iterator.
+  I = Set.erase(Set.end() - 1);
+  EXPECT_TRUE(I == Set.end());
+  EXPECT_EQ(4u, Set.size());
+
+  // Erase second element by iterator.
+  I = Set.erase(Set.begin() + 1);
+  EXPECT_TRUE(I == Set.begin() + 1);
+
+  // Clear and resize the universe.
+  Set.clear();
+  EXPECT_FALSE(Set.count(5));
+  Set.setUniverse(1000);
+
+  // Add more than 256 elements.
+  for (unsigned i = 100; i != 800; ++i)
+    Set.insert(i);
+
+  for (unsigned i = 0; i != 10; ++i)
+    Set.erase(i);
+
+  for (unsigned i = 100; i != 800; ++i)
+    EXPECT_TRUE(Set.count(i));
+
+  EXPECT_FALSE(Set.count(99));
+  EXPECT_FALSE(Set.count(800));
+  EXPECT_EQ(700u, Set.size());
+}
+
+struct Alt {
+  unsigned Value;
+  explicit Alt(unsigned x) : Value(x) {}
+  unsigned getSparseSetIndex() const { return Value - 1000; }
+};
+
+TEST(SparseSetTest, AltStructSet) {
+  typedef SparseSet<Alt> ASet;
+  ASet Set;
+  Set.setUniverse(10);
+  Set.insert(Alt(1005));
+
+  ASet::iterator I = Set.find(5);
+  ASSERT_TRUE(I == Set.begin());
+  EXPECT_EQ(1005u, I->Value);
+
+  Set.insert(Alt(1006));
+  Set.insert(Alt(1006));
+  I = Set.erase(Set.begin());
+  ASSERT_TRUE(I == Set.begin());
+  EXPECT_EQ(1006u, I->Value);
+
+  EXPECT_FALSE(Set.erase(5));
+  EXPECT_TRUE(Set.erase(6));
+}
+
+typedef SparseMultiSet<unsigned> UMultiSet;
+
+// Empty multiset tests.
+TEST(SparseMultiSetTest, EmptySet) {
+  UMultiSet Set;
+  EXPECT_TRUE(Set.empty());
+  EXPECT_EQ(0u, Set.size());
+
+  Set.setUniverse(10);
+
+  // Lookups on empty set.
+  EXPECT_TRUE(Set.find(0) == Set.end());
+  EXPECT_TRUE(Set.find(9) == Set.end());
+  EXPECT_FALSE(Set.contains(0));
+  EXPECT_EQ(0u, Set.count(3));
+
+  // Same thing on a const reference.
+  const UMultiSet &CSet = Set;
+  EXPECT_TRUE(CSet.empty());
+  EXPECT_EQ(0u, CSet.size());
+  EXPECT_TRUE(CSet.find(0) == CSet.end());
+}
+
+// Values with the same key come back in insertion order, and erasing from
+// any position in the list keeps the others.
+TEST(SparseMultiSetTest, MultipleEntrySet) {
+  UMultiSet Set;
+  Set.setUniverse(10);
+
+  Set.insert(1);
+  Set.insert(3);
+  Set.insert(1);
+  Set.insert(1);
+  Set.insert(4);
+  EXPECT_EQ(5u, Set.size());
+  EXPECT_EQ(3u, Set.count(1));
+  EXPECT_EQ(1u, Set.count(3));
+  EXPECT_EQ(0u, Set.count(2));
+  EXPECT_TRUE(Set.contains(4));
+
+  // Erase the middle one of three.
+  UMultiSet::iterator I = Set.find(1);
+  ++I;
+  I = Set.erase(I);
+  ASSERT_TRUE(I != Set.end());
+  EXPECT_EQ(2u, Set.count(1));
+
+  // Erase the tail, then add a new tail.
+  I = Set.erase(I);
+  EXPECT_TRUE(I == Set.end());
+  EXPECT_EQ(1u, Set.count(1));
+  Set.insert(1);
+  EXPECT_EQ(2u, Set.count(1));
+
+  // Erase the head.
+  I = Set.erase(Set.find(1));
+  EXPECT_TRUE(I == Set.find(1));
+  EXPECT_EQ(1u, Set.count(1));
+  I = Set.erase(I);
+  EXPECT_TRUE(I == Set.end());
+  EXPECT_FALSE(Set.contains(1));
+  EXPECT_EQ(2u, Set.size());
+
+  // Holes left by erasing are reused.
+  for (unsigned i = 0; i != 4; ++i)
+    Set.insert(7);
+  EXPECT_EQ(4u, Set.count(7));
+  EXPECT_EQ(6u, Set.size());
+
+  Set.eraseAll(7);
+  EXPECT_FALSE(Set.contains(7));
+  EXPECT_TRUE(Set.contains(3));
+  EXPECT_TRUE(Set.contains(4));
+  EXPECT_EQ(2u, Set.size());
+
+  Set.clear();
+  EXPECT_TRUE(Set.empty());
+  EXPECT_FALSE(Set.contains(3));
+}
+
+struct RegUse {
+  unsigned Reg, Order;
+  RegUse(unsigned R, unsigned O) : Reg(R), Order(O) {}
+  unsigned getSparseSetIndex() const { return Reg; }
+};
+
+// More than 256 entries, so that finding the head of a list has to step over
+// stale sparse entries, with the lists erased and rebuilt in between.
+TEST(SparseMultiSetTest, ManyEntries) {
+  typedef SparseMultiSet<RegUse> UseSet;
+  UseSet Set;
+  Set.setUniverse(100);
+
+  for (unsigned i = 0; i != 1000; ++i)
+    Set.insert(RegUse(i % 100, i));
+  EXPECT_EQ(1000u, Set.size());
+
+  for (unsigned Reg = 0; Reg != 100; Reg += 2)
+    Set.eraseAll(Reg);
+  EXPECT_EQ(500u, Set.size());
+  for (unsigned i = 0; i != 500; ++i)
+    Set.insert(RegUse(i % 50 * 2, 1000 + i));
+
+  for (unsigned Reg = 0; Reg != 100; ++Reg) {
+    unsigned Expected = Reg % 2 ? Reg : 1000 + Reg / 2;
+    unsigned Step = Reg % 2 ? 100 : 50;
+    unsigned N = 0;
+    for (UseSet::iterator I = Set.find(Reg), E = Set.end(); I != E; ++I) {
+      EXPECT_EQ(Reg, I->Reg);
+      EXPECT_EQ(Expected, I->Order);
+      Expected += Step;
+      ++N;
+    }
+    EXPECT_EQ(10u, N);
+  }
+}
+
+// Erase the tail of a list whose head is further along the stride than the
+// tail, which sits in a reused slot.
+TEST(SparseMultiSetTest, EraseTailInReusedSlot) {
+  typedef SparseMultiSet<RegUse> UseSet;
+  UseSet Set;
+  Set.setUniverse(10);
+
+  for (unsigned i = 0; i != 300; ++i)
+    Set.insert(RegUse(1, i));
+  // The head of register 5 lands in slot 300, which is 44 mod 256.
+  Set.insert(RegUse(5, 300));
+
+  // Free slot 44 from the middle of register 1's list, and reuse it for the
+  // tail of register 5.
+  UseSet::iterator I = Set.find(1);
+  for (unsigned i = 0; i != 44; ++i)
+    ++I;
+  EXPECT_EQ(44u, I->Order);
+  I = Set.erase(I);
+  EXPECT_EQ(45u, I->Order);
+  Set.insert(RegUse(5, 301));
+  EXPECT_EQ(2u, Set.count(5));
+
+  I = Set.find(5);
+  ++I;
+  EXPECT_EQ(301u, I->Order);
+  I = Set.erase(I);
+  EXPECT_TRUE(I == Set.end());
+  EXPECT_EQ(1u, Set.count(5));
+  EXPECT_EQ(300u, Set.size());
+
+  Set.insert(RegUse(5, 302));
+  EXPECT_EQ(301u, Set.size());
+  EXPECT_EQ(2u, Set.count(5));
+  I = Set.find(5);
+  EXPECT_EQ(300u, I->Order);
+  ++I;
+  EXPECT_EQ(302u, I->Order);
+  ++I;
+  EXPECT_TRUE(I == Set.end());
+  EXPECT_EQ(299u, Set.count(1));
+}
+
+} // namespace
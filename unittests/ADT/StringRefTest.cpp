@@ -10,7 +10,13 @@
 #include "gtest/gtest.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
+#include <bitset>
+#include <climits>
 using namespace llvm;
 
 namespace llvm {
@@ -256,6 +262,41 @@ TEST(StringRefTest, Find) {
   EXPECT_EQ(StringRef::npos, Str.find_first_not_of("hello"));
 }
 
+// Strings long enough for the searches to go through whole 16-character
+// blocks, with matches at each position relative to the block boundaries.
+TEST(StringRefTest, FindLong) {
+  std::string Storage(100, 'a');
+  for (unsigned Pos = 0; Pos != 95; ++Pos) {
+    std::string S = Storage;
+    S.replace(Pos, 5, "bxcyd");
+    StringRef Str(S);
+    EXPECT_EQ(Pos, Str.find("bxcyd"));
+    EXPECT_EQ(Pos, Str.find("bx"));
+    EXPECT_EQ(Pos, Str.find("bxcyd", Pos));
+    EXPECT_EQ(StringRef::npos, Str.find("bxcyd", Pos + 1));
+    EXPECT_EQ(StringRef::npos, Str.find("bxcyz"));
+    EXPECT_EQ(Pos, Str.rfind("bxcyd"));
+    EXPECT_EQ(Pos + 3, Str.rfind("yd"));
+    EXPECT_EQ(1U, Str.count("bxcyd"));
+    EXPECT_EQ(Pos, Str.find_first_of("dcb"));
+    EXPECT_EQ(Pos + 1, Str.find_first_of("zyxwvutsrqponmlk"));
+    EXPECT_EQ(Pos, Str.find_first_of("zyxwvutsrqponmlkjihgfedcb"));
+    EXPECT_EQ(Pos + 2, Str.find_first_of("c", Pos));
+    EXPECT_EQ(Pos, Str.find_first_not_of('a'));
+    EXPECT_EQ(Pos, Str.find_first_not_of("a"));
+    EXPECT_EQ(Pos + 1, Str.find_first_not_of("ab"));
+  }
+
+  StringRef Str(Storage);
+  EXPECT_EQ(0U, Str.find("aaa"));
+  EXPECT_EQ(97U, Str.rfind("aaa"));
+  EXPECT_EQ(StringRef::npos, Str.find_first_not_of('a'));
+  EXPECT_EQ(StringRef::npos, Str.find_first_not_of("a"));
+  EXPECT_EQ(StringRef::npos, Str.find_first_of("bc"));
+  EXPECT_EQ(40U, Str.find("", 40));
+  EXPECT_EQ(100U, Str.rfind(""));
+}
+
 TEST(StringRefTest, Count) {
   StringRef Str("hello");
   EXPECT_EQ(2U, Str.count('l'));
@@ -279,4 +320,156 @@ TEST(StringRefTest, Misc) {
   EXPECT_EQ("hello", OS.str());
 }
 
+// The scalar searches and hash StringRef used before they were vectorized,
+// for the benchmark below to compare against.
+size_t scalarFind(StringRef S, StringRef Str) {
+  size_t N = Str.size();
+  if (N > S.size())
+    return StringRef::npos;
+  for (size_t i = 0, e = S.size() - N + 1; i != e; ++i)
+    if (S.substr(i, N).equals(Str))
+      return i;
+  return StringRef::npos;
+}
+
+size_t scalarRFind(StringRef S, StringRef Str) {
+  size_t N = Str.size();
+  if (N > S.size())
+    return StringRef::npos;
+  for (size_t i = S.size() - N + 1; i != 0;) {
+    --i;
+    if (S.substr(i, N).equals(Str))
+      return i;
+  }
+  return StringRef::npos;
+}
+
+size_t scalarCount(StringRef S, StringRef Str) {
+  size_t Count = 0;
+  size_t N = Str.size();
+  if (N > S.size())
+    return 0;
+  for (size_t i = 0, e = S.size() - N + 1; i != e; ++i)
+    if (S.substr(i, N).equals(Str))
+      ++Count;
+  return Count;
+}
+
+size_t scalarFindFirstOf(StringRef S, StringRef Chars, size_t From) {
+  std::bitset<1 << CHAR_BIT> CharBits;
+  for (size_t i = 0; i != Chars.size(); ++i)
+    CharBits.set((unsigned char)Chars[i]);
+  for (size_t i = std::min(From, S.size()), e = S.size(); i != e; ++i)
+    if (CharBits.test((unsigned char)S[i]))
+      return i;
+  return StringRef::npos;
+}
+
+unsigned bernsteinHash(StringRef Str) {
+  unsigned Result = 0;
+  for (unsigned i = 0, e = Str.size(); i != e; ++i)
+    Result = Result * 33 + Str[i];
+  return Result;
+}
+
+size_t find(StringRef S, StringRef A) { return S.find(A); }
+size_t rfind(StringRef S, StringRef A) { return S.rfind(A); }
+size_t count(StringRef S, StringRef A) { return S.count(A); }
+size_t findFirstOf(StringRef S, StringRef A) { return S.find_first_of(A); }
+size_t scalarFindFirstOf(StringRef S, StringRef A) {
+  return scalarFindFirstOf(S, A, 0);
+}
+
+// Count the characters in A by finding each in turn, as a lexer would.
+size_t findEachOf(StringRef S, StringRef A) {
+  size_t N = 0;
+  for (size_t I = S.find_first_of(A); I != StringRef::npos;
+       I = S.find_first_of(A, I + 1))
+    ++N;
+  return N;
+}
+size_t scalarFindEachOf(StringRef S, StringRef A) {
+  size_t N = 0;
+  for (size_t I = scalarFindFirstOf(S, A, 0); I != StringRef::npos;
+       I = scalarFindFirstOf(S, A, I + 1))
+    ++N;
+  return N;
+}
+
+struct Search {
+  const char *Name;
+  size_t (*Fn)(StringRef, StringRef);
+  size_t (*ScalarFn)(StringRef, StringRef);
+  const char *Arg;
+};
+
+double getWallTime() {
+  return TimeRecord::getCurrentTime(false).getWallTime();
+}
+
+// The searches and HashString on 1MB of x86 assembly text, against the scalar
+// code they replaced.  Disabled by default; run it with
+// --gtest_also_run_disabled_tests.
+TEST(StringRefTest, DISABLED_Throughput) {
+  std::string Storage;
+  std::vector<std::string> Identifiers;
+  for (unsigned i = 0; Storage.size() < (1 << 20); ++i) {
+    std::string Label = "LBB" + utostr(i / 8) + "_" + utostr(i % 8);
+    Storage += "." + Label + ":\n"
+               "\tmovq\t%rsp, %rbp\n"
+               "\tleaq\t8(%rdi), %rsi\n"
+               "\tcmpq\t%rdx, %rcx\n"
+               "\tcallq\t_foo\n"
+               "\tjne\t." + Label + "\n";
+    Identifiers.push_back(Label);
+    Identifiers.push_back("tmp" + utostr(i));
+  }
+  StringRef Text(Storage);
+
+  static const Search Searches[] = {
+    { "find(\"vmovaps\"), absent", find, scalarFind, "vmovaps" },
+    { "find(\"\\tret\"), absent", find, scalarFind, "\tret" },
+    { "rfind(\"vmovaps\"), absent", rfind, scalarRFind, "vmovaps" },
+    { "count(\"callq\")", count, scalarCount, "callq" },
+    { "find_first_of(\"#;!\"), absent", findFirstOf, scalarFindFirstOf,
+      "#;!" },
+    { "find_first_of(\",\\n\") loop", findEachOf, scalarFindEachOf, ",\n" }
+  };
+
+  const unsigned Reps = 20;
+  for (unsigned i = 0; i != array_lengthof(Searches); ++i) {
+    const Search &S = Searches[i];
+    size_t Result = 0, ScalarResult = 0;
+    double Start = getWallTime();
+    for (unsigned Rep = 0; Rep != Reps; ++Rep)
+      ScalarResult = S.ScalarFn(Text, S.Arg);
+    double ScalarTime = (getWallTime() - Start) / Reps;
+    Start = getWallTime();
+    for (unsigned Rep = 0; Rep != Reps; ++Rep)
+      Result = S.Fn(Text, S.Arg);
+    double Time = (getWallTime() - Start) / Reps;
+    EXPECT_EQ(ScalarResult, Result);
+    outs() << S.Name
+           << format(": scalar %.3fms, now %.3fms\n", ScalarTime * 1000,
+                     Time * 1000);
+  }
+
+  unsigned Sum = 0, ScalarSum = 0;
+  double Start = getWallTime();
+  for (unsigned Rep = 0; Rep != Reps; ++Rep)
+    for (unsigned i = 0, e = Identifiers.size(); i != e; ++i)
+      ScalarSum += bernsteinHash(Identifiers[i]);
+  double ScalarTime = (getWallTime() - Start) / Reps;
+  Start = getWallTime();
+  for (unsigned Rep = 0; Rep != Reps; ++Rep)
+    for (unsigned i = 0, e = Identifiers.size(); i != e; ++i)
+      Sum += HashString(Identifiers[i]);
+  double Time = (getWallTime() - Start) / Reps;
+  outs() << "HashString, " << Identifiers.size() << " identifiers"
+         << format(": Bernstein %.3fms, MurmurHash2 %.3fms\n",
+                   ScalarTime * 1000, Time * 1000);
+  // Keep the hashes from being optimized away.
+  EXPECT_NE(0U, Sum | ScalarSum);
+}
+
 } // end anonymous namespace
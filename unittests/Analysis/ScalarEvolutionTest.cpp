@@ -78,5 +78,47 @@ TEST(ScalarEvolutionsTest, SCEVUnknownRAUW) {
   SE.releaseMemory();
 }
 
+TEST(ScalarEvolutionsTest, ExpressionSize) {
+  LLVMContext Context;
+  Module M("world", Context);
+
+  const Type *Ty = Type::getInt32Ty(Context);
+  std::vector<const Type *> Params(2, Ty);
+  const FunctionType *FTy = FunctionType::get(Type::getVoidTy(Context),
+                                              Params, false);
+  Function *F = cast<Function>(M.getOrInsertFunction("f", FTy));
+  BasicBlock *BB = BasicBlock::Create(Context, "entry", F);
+  ReturnInst::Create(Context, 0, BB);
+
+  Function::arg_iterator AI = F->arg_begin();
+  Value *V0 = AI++;
+  Value *V1 = AI;
+
+  PassManager PM;
+  ScalarEvolution &SE = *new ScalarEvolution();
+  PM.add(&SE);
+  PM.run(M);
+
+  const SCEV *S0 = SE.getSCEV(V0);
+  const SCEV *S1 = SE.getSCEV(V1);
+  EXPECT_EQ(1u, S0->getExpressionSize());
+
+  // (V0 + V1) is one add node over two leaves.
+  const SCEV *Sum = SE.getAddExpr(S0, S1);
+  EXPECT_EQ(3u, Sum->getExpressionSize());
+
+  // Shared subexpressions are counted once per use.
+  const SCEV *Div = SE.getUDivExpr(Sum, Sum);
+  EXPECT_EQ(7u, Div->getExpressionSize());
+
+  const SCEV *Trunc = SE.getTruncateExpr(Div, Type::getInt8Ty(Context));
+  EXPECT_EQ(8u, Trunc->getExpressionSize());
+
+  // Everything above lives in the arena.
+  EXPECT_LT(0u, SE.getMemoryUsage());
+
+  SE.releaseMemory();
+}
+
 }  // end anonymous namespace
 }  // end namespace llvm
@@ -0,0 +1,113 @@
+//===- llvm/unittest/AsmParser/LLLexerTest.cpp - LLLexer tests ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "../lib/AsmParser/LLLexer.h"
+#include "llvm/Instruction.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Type.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+
+class LLLexerTest : public testing::Test {
+protected:
+  LLVMContext Context;
+  SourceMgr SM;
+  SMDiagnostic Err;
+
+  /// lex - Lex all of Text, returning how many tokens it holds.
+  unsigned lex(StringRef Text) {
+    MemoryBuffer *Buf = MemoryBuffer::getMemBuffer(Text, "<string>");
+    SM.AddNewSourceBuffer(Buf, SMLoc());
+    LLLexer L(Buf, SM, Err, Context);
+    unsigned NumTokens = 0;
+    for (lltok::Kind K = L.Lex(); K != lltok::Eof; K = L.Lex()) {
+      EXPECT_NE(lltok::Error, K);
+      ++NumTokens;
+    }
+    return NumTokens;
+  }
+};
+
+TEST_F(LLLexerTest, Keywords) {
+  MemoryBuffer *Buf = MemoryBuffer::getMemBuffer(
+    "define float fadd store getelementptr i32 label entry: sext\n",
+    "<string>");
+  SM.AddNewSourceBuffer(Buf, SMLoc());
+  LLLexer L(Buf, SM, Err, Context);
+
+  EXPECT_EQ(lltok::kw_define, L.Lex());
+  EXPECT_EQ(lltok::Type, L.Lex());
+  EXPECT_EQ(Type::getFloatTy(Context), L.getTyVal());
+  EXPECT_EQ(lltok::kw_fadd, L.Lex());
+  EXPECT_EQ(unsigned(Instruction::FAdd), L.getUIntVal());
+  EXPECT_EQ(lltok::kw_store, L.Lex());
+  EXPECT_EQ(unsigned(Instruction::Store), L.getUIntVal());
+  EXPECT_EQ(lltok::kw_getelementptr, L.Lex());
+  EXPECT_EQ(unsigned(Instruction::GetElementPtr), L.getUIntVal());
+  EXPECT_EQ(lltok::Type, L.Lex());
+  EXPECT_EQ((const Type*)Type::getInt32Ty(Context), L.getTyVal());
+  EXPECT_EQ(lltok::Type, L.Lex());
+  EXPECT_EQ(Type::getLabelTy(Context), L.getTyVal());
+  EXPECT_EQ(lltok::LabelStr, L.Lex());
+  EXPECT_EQ("entry", L.getStrVal());
+  // The old spelling of signext, at the end of a line.
+  EXPECT_EQ(lltok::kw_signext, L.Lex());
+  EXPECT_EQ(lltok::Eof, L.Lex());
+}
+
+// Lexing throughput on a large generated module.  Disabled by default; run
+// it with --gtest_also_run_disabled_tests.
+TEST_F(LLLexerTest, DISABLED_Throughput) {
+  SmallString<256> Func;
+  std::string Text;
+  for (unsigned i = 0; Text.size() < (16 << 20); ++i) {
+    Func.clear();
+    raw_svector_ostream OS(Func);
+    OS << "define i32 @f" << i << "(i32 %a, i32* %p) nounwind {\n"
+       << "entry:\n"
+       << "  %x = add nsw i32 %a, " << i << "\n"
+       << "  %y = load i32* %p, align 4\n"
+       << "  %c = icmp slt i32 %x, %y\n"
+       << "  br i1 %c, label %then, label %else\n"
+       << "then:\n"
+       << "  %g = getelementptr inbounds i32* %p, i64 1\n"
+       << "  store i32 %x, i32* %g, align 4\n"
+       << "  ret i32 %x\n"
+       << "else:\n"
+       << "  %z = call i32 @f0(i32 %y, i32* %p) ; recurse\n"
+       << "  ret i32 %z\n"
+       << "}\n\n";
+    Text += OS.str();
+  }
+
+  double Best = 0;
+  unsigned NumTokens = 0;
+  for (unsigned Run = 0; Run != 5; ++Run) {
+    double Start = TimeRecord::getCurrentTime(true).getWallTime();
+    NumTokens = lex(Text);
+    double Time = TimeRecord::getCurrentTime(false).getWallTime() - Start;
+    if (Run == 0 || Time < Best)
+      Best = Time;
+  }
+  double MB = Text.size() / 1048576.0;
+  outs() << "Lexed " << NumTokens << " tokens, "
+         << format("%.1f MB in %.3fs: %.1f MB/s\n", MB, Best, MB / Best);
+}
+
+}  // anonymous namespace
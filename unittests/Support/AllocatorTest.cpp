@@ -8,9 +8,13 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Support/Allocator.h"
+#include "llvm/Support/ConcurrentBumpPtrAllocator.h"
+#include "llvm/Support/ThreadPool.h"
 
 #include "gtest/gtest.h"
 #include <cstdlib>
+#include <cstring>
+#include <vector>
 
 using namespace llvm;
 
@@ -140,4 +144,127 @@ TEST(AllocatorTest, TestBigAlignment) {
   EXPECT_LE(Ptr + 3000, ((uintptr_t)Slab) + Slab->Size);
 }
 
+// Allocate from the concurrent allocator on one thread: small allocations
+// share a slab, big ones get their own, and Reset keeps the slabs for reuse.
+TEST(AllocatorTest, ConcurrentBasics) {
+  ConcurrentBumpPtrAllocator Alloc(4096, 4096);
+  int *a = Alloc.Allocate<int>();
+  int *b = Alloc.Allocate<int>(10);
+  *a = 1;
+  b[9] = 2;
+  EXPECT_EQ(1, *a);
+  EXPECT_EQ(2, b[9]);
+  EXPECT_EQ(1U, Alloc.GetNumSlabs());
+
+  uintptr_t c = (uintptr_t)Alloc.Allocate(1, 128);
+  EXPECT_EQ(0U, c & 127);
+
+  Alloc.Allocate(10000, 0);
+  EXPECT_EQ(2U, Alloc.GetNumSlabs());
+  // At most 4035 bytes are left in the first slab, wherever it lies.
+  Alloc.Allocate(4050, 0);
+  EXPECT_EQ(3U, Alloc.GetNumSlabs());
+  EXPECT_EQ(sizeof(int) * 11 + 1 + 10000 + 4050, Alloc.getBytesAllocated());
+
+  size_t Total = Alloc.getTotalMemory();
+  Alloc.Reset();
+  EXPECT_EQ(0U, Alloc.GetNumSlabs());
+  EXPECT_EQ(0U, Alloc.getBytesAllocated());
+  Alloc.Allocate(3000, 0);
+  Alloc.Allocate(3000, 0);
+  EXPECT_EQ(2U, Alloc.GetNumSlabs());
+  EXPECT_GE(Total, Alloc.getTotalMemory());
+}
+
+struct FillTask {
+  ConcurrentBumpPtrAllocator *Alloc;
+  unsigned char Byte;
+  std::vector<unsigned char*> Blocks;
+
+  static void run(void *Arg) {
+    FillTask *T = static_cast<FillTask*>(Arg);
+    for (unsigned i = 0; i != 2000; ++i) {
+      // Mostly small blocks, with the odd one above the threshold.
+      size_t Size = i % 100 == 0 ? 5000 : 1 + i % 64;
+      unsigned char *P = (unsigned char*)T->Alloc->Allocate(Size, 8);
+      memset(P, T->Byte, Size);
+      T->Blocks.push_back(P);
+    }
+  }
+};
+
+// Allocate from several threads at once, filling each block with a byte
+// that identifies its thread; no block may be overwritten by another thread.
+TEST(AllocatorTest, ConcurrentThreads) {
+  ConcurrentBumpPtrAllocator Alloc(4096, 4096);
+  std::vector<FillTask> Tasks(8);
+  {
+    ThreadPool Pool(4);
+    TaskGroup G(Pool);
+    for (unsigned i = 0; i != Tasks.size(); ++i) {
+      Tasks[i].Alloc = &Alloc;
+      Tasks[i].Byte = i + 1;
+      G.spawn(&FillTask::run, &Tasks[i]);
+    }
+  }
+
+  size_t Bytes = 0;
+  for (unsigned t = 0; t != Tasks.size(); ++t) {
+    for (unsigned i = 0; i != 2000; ++i) {
+      size_t Size = i % 100 == 0 ? 5000 : 1 + i % 64;
+      unsigned char *P = Tasks[t].Blocks[i];
+      EXPECT_EQ(0U, (uintptr_t)P & 7);
+      for (size_t j = 0; j != Size; ++j)
+        ASSERT_EQ(Tasks[t].Byte, P[j]);
+      Bytes += Size;
+    }
+  }
+  EXPECT_EQ(Bytes, Alloc.getBytesAllocated());
+  EXPECT_LE(Bytes, Alloc.getTotalMemory());
+}
+
+// Keep more allocators alive at once than there are thread-local keys, and
+// allocate from them in turn so their thread cache entries keep colliding.
+// Each must still find its own region rather than starting a new one.
+TEST(AllocatorTest, ConcurrentManyAllocators) {
+  std::vector<ConcurrentBumpPtrAllocator*> Allocs;
+  for (unsigned i = 0; i != 2000; ++i)
+    Allocs.push_back(new ConcurrentBumpPtrAllocator(4096, 4096));
+  for (unsigned Round = 0; Round != 3; ++Round)
+    for (unsigned i = 0; i != Allocs.size(); ++i)
+      *Allocs[i]->Allocate<unsigned>() = i;
+  for (unsigned i = 0; i != Allocs.size(); ++i) {
+    EXPECT_EQ(1U, Allocs[i]->GetNumSlabs());
+    EXPECT_EQ(3 * sizeof(unsigned), Allocs[i]->getBytesAllocated());
+    delete Allocs[i];
+  }
+}
+
+// An allocator created where a destroyed one lived must not pick up the old
+// allocator's region from the thread cache.
+TEST(AllocatorTest, ConcurrentSameAddress) {
+  for (unsigned i = 0; i != 3; ++i) {
+    ConcurrentBumpPtrAllocator Alloc(4096, 4096);
+    Alloc.Allocate(100, 1);
+    EXPECT_EQ(1U, Alloc.GetNumSlabs());
+    EXPECT_EQ(100U, Alloc.getBytesAllocated());
+  }
+}
+
+// Slabs mapped with sys::Memory, with and without huge pages.  Huge page
+// slabs may be big enough to hold both allocations.
+TEST(AllocatorTest, MmapSlabs) {
+  for (unsigned Huge = 0; Huge != 2; ++Huge) {
+    MmapSlabAllocator SlabAlloc(Huge);
+    ConcurrentBumpPtrAllocator Alloc(65536, 65536, SlabAlloc);
+    char *P = (char*)Alloc.Allocate(1000, 16);
+    memset(P, 1, 1000);
+    char *Q = (char*)Alloc.Allocate(100000, 16);
+    memset(Q, 2, 100000);
+    EXPECT_EQ(1, P[999]);
+    EXPECT_EQ(2, Q[99999]);
+    EXPECT_LE(101000U, Alloc.getTotalMemory());
+  }
+}
+
 }  // anonymous namespace
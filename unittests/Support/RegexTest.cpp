@@ -9,7 +9,12 @@
 
 #include "gtest/gtest.h"
 #include "llvm/Support/Regex.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "../lib/Support/regex_impl.h"
 #include <cstring>
 
 using namespace llvm;
@@ -91,4 +96,141 @@ TEST_F(RegexTest, Substitution) {
   EXPECT_EQ(Error, "invalid backreference string '100'");
 }
 
+TEST_F(RegexTest, LeftmostLongest) {
+  SmallVector<StringRef, 4> Matches;
+
+  // The leftmost match wins even if a later one ends first.
+  Regex r1("b+c|ab+cd");
+  EXPECT_TRUE(r1.match("xabbbcd", &Matches));
+  EXPECT_EQ("abbbcd", Matches[0].str());
+
+  // Of the matches starting there, the longest wins.
+  Regex r2("(a|ab)(c|bcd)");
+  EXPECT_TRUE(r2.match("zabcd", &Matches));
+  EXPECT_EQ(3u, Matches.size());
+  EXPECT_EQ("abcd", Matches[0].str());
+  EXPECT_EQ("a", Matches[1].str());
+  EXPECT_EQ("bcd", Matches[2].str());
+}
+
+TEST_F(RegexTest, Boundaries) {
+  SmallVector<StringRef, 2> Matches;
+
+  Regex r1("^b.*$", Regex::Newline);
+  EXPECT_TRUE(r1.match("a\nbcd\ne", &Matches));
+  EXPECT_EQ("bcd", Matches[0].str());
+  EXPECT_FALSE(Regex("^b.*$").match("a\nbcd\ne"));
+
+  Regex r2("[[:<:]]ab[[:>:]]");
+  EXPECT_FALSE(r2.match("cab abc"));
+  StringRef Str("cab ab, abc");
+  EXPECT_TRUE(r2.match(Str, &Matches));
+  EXPECT_EQ(Str.data() + 4, Matches[0].data());
+  EXPECT_TRUE(r2.match("ab"));
+
+  Regex r3("B[0-9]", Regex::IgnoreCase);
+  EXPECT_TRUE(r3.match("ab1", &Matches));
+  EXPECT_EQ("b1", Matches[0].str());
+}
+
+TEST_F(RegexTest, LongInputs) {
+  // Patterns whose naive evaluation is slow on long inputs.  The inputs hold
+  // every string the patterns require, so the prescreen cannot reject them.
+  std::string Input(20000, 'a');
+  EXPECT_FALSE(Regex("(a|aa)*b$").match(Input + "ba"));
+  EXPECT_FALSE(Regex("a*a*a*a*a*a*a*c$").match(Input + "ca"));
+  Input += 'b';
+  SmallVector<StringRef, 2> Matches;
+  EXPECT_TRUE(Regex("(a|aa)*b").match(Input, &Matches));
+  EXPECT_EQ(Input.size(), Matches[0].size());
+
+  // Every start before the match begins a partial match that fails only at
+  // the end, which takes quadratic time if each start is tried in turn.
+  EXPECT_TRUE(Regex("a*c|b").match(Input, &Matches));
+  EXPECT_EQ("b", Matches[0].str());
+  EXPECT_EQ(Input.size() - 1, size_t(Matches[0].data() - Input.data()));
+}
+
+double getWallTime() {
+  return TimeRecord::getCurrentTime(false).getWallTime();
+}
+
+// FileCheck-style patterns against a 1MB assembly listing, matched with
+// regexec's backtracking matcher and with Regex, which uses the DFA.  The
+// patterns only match in the last lines, or not at all.  Disabled by
+// default; run it with --gtest_also_run_disabled_tests.
+TEST_F(RegexTest, DISABLED_Throughput) {
+  std::string Input;
+  while (Input.size() < (1 << 20))
+    Input += ".LBB0_2:\n"
+             "\tpushq\t%rbp\n"
+             "\tmovq\t%rsp, %rbp\n"
+             "\tleaq\t8(%rdi), %rsi\n"
+             "\taddq\t$16, %rsp\n"
+             "\tcmpq\t%rdx, %rcx\n"
+             "\tjne\t.LBB0_3\n";
+  Input += "\tmovl\t%eax, (%rdi)\n"
+           "\tcallq\t_bar\n"
+           "\tret\n";
+
+  static const char *const Patterns[] = {
+    "movl.*%eax",
+    "callq[[:space:]]+_?bar",
+    "([a-z]+)\t(%[a-z]+), \\((%[a-z]+)\\)",
+    "^[[:space:]]*ret$",
+    "vmovaps.*%xmm[0-9]+",
+    "jne[[:space:]]+\\.LBB[0-9]+_1$"
+  };
+
+  for (unsigned i = 0; i != array_lengthof(Patterns); ++i) {
+    StringRef Pattern(Patterns[i]);
+    llvm_regex_t Preg;
+    Preg.re_endp = Pattern.end();
+    ASSERT_EQ(0, llvm_regcomp(&Preg, Pattern.data(),
+                              REG_EXTENDED | REG_NEWLINE | REG_PEND));
+    SmallVector<llvm_regmatch_t, 4> PM(Preg.re_nsub + 1);
+
+    double OldBest = 0;
+    int RC = 0;
+    for (unsigned Run = 0; Run != 3; ++Run) {
+      double Start = getWallTime();
+      PM[0].rm_so = 0;
+      PM[0].rm_eo = Input.size();
+      RC = llvm_regexec(&Preg, Input.data(), PM.size(), PM.data(),
+                        REG_STARTEND);
+      double Time = getWallTime() - Start;
+      if (Run == 0 || Time < OldBest)
+        OldBest = Time;
+    }
+    llvm_regfree(&Preg);
+
+    Regex R(Pattern, Regex::Newline);
+    SmallVector<StringRef, 4> Matches;
+    double NewBest = 0;
+    bool Matched = false;
+    for (unsigned Run = 0; Run != 3; ++Run) {
+      double Start = getWallTime();
+      Matched = R.match(Input, &Matches);
+      double Time = getWallTime() - Start;
+      if (Run == 0 || Time < NewBest)
+        NewBest = Time;
+    }
+
+    // Both matchers must agree on the match.
+    ASSERT_EQ(RC == 0, Matched);
+    if (Matched) {
+      ASSERT_EQ(PM.size(), Matches.size());
+      for (unsigned j = 0, e = PM.size(); j != e; ++j) {
+        EXPECT_EQ(size_t(PM[j].rm_so),
+                  size_t(Matches[j].data() - Input.data()));
+        EXPECT_EQ(size_t(PM[j].rm_eo - PM[j].rm_so), Matches[j].size());
+      }
+    }
+
+    outs() << "\"" << Pattern << "\": "
+           << format("regexec %.2fms, DFA %.2fms\n", OldBest * 1000,
+                     NewBest * 1000);
+  }
+}
+
 }
@@ -0,0 +1,191 @@
+//===- llvm/unittest/Support/ThreadPoolTest.cpp - ThreadPool tests --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Config/config.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "gtest/gtest.h"
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+void increment(void *Arg) {
+  sys::AtomicIncrement(static_cast<volatile sys::cas_flag*>(Arg));
+}
+
+TEST(ThreadPoolTest, Async) {
+  volatile sys::cas_flag Count = 0;
+  ThreadPool Pool(4);
+#if defined(LLVM_MULTITHREADED) && defined(HAVE_PTHREAD_H)
+  EXPECT_EQ(4U, Pool.getNumThreads());
+#else
+  // Without threads, tasks run one at a time as they are spawned.
+  EXPECT_EQ(1U, Pool.getNumThreads());
+#endif
+  for (unsigned i = 0; i != 1000; ++i)
+    Pool.async(&increment, const_cast<sys::cas_flag*>(&Count));
+  Pool.wait();
+  EXPECT_EQ(1000U, Count);
+}
+
+TEST(ThreadPoolTest, Groups) {
+  volatile sys::cas_flag A = 0, B = 0;
+  ThreadPool Pool(3);
+  TaskGroup GA(Pool), GB(Pool);
+  for (unsigned i = 0; i != 500; ++i) {
+    GA.spawn(&increment, const_cast<sys::cas_flag*>(&A));
+    GB.spawn(&increment, const_cast<sys::cas_flag*>(&B));
+  }
+  GA.wait();
+  EXPECT_EQ(500U, A);
+  GB.wait();
+  EXPECT_EQ(500U, B);
+}
+
+// Sum the integers in [Begin, End) by splitting the range in two until it is
+// small, spawning and waiting for the halves from within tasks.
+struct RangeSum {
+  ThreadPool *Pool;
+  unsigned Begin, End;
+  unsigned long long Sum;
+
+  static void run(void *Arg) {
+    RangeSum *R = static_cast<RangeSum*>(Arg);
+    R->Sum = 0;
+    if (R->End - R->Begin <= 16) {
+      for (unsigned i = R->Begin; i != R->End; ++i)
+        R->Sum += i;
+      return;
+    }
+    unsigned Mid = R->Begin + (R->End - R->Begin) / 2;
+    RangeSum Lo = { R->Pool, R->Begin, Mid, 0 };
+    RangeSum Hi = { R->Pool, Mid, R->End, 0 };
+    TaskGroup G(*R->Pool);
+    G.spawn(&run, &Lo);
+    G.spawn(&run, &Hi);
+    G.wait();
+    R->Sum = Lo.Sum + Hi.Sum;
+  }
+};
+
+TEST(ThreadPoolTest, Nested) {
+  ThreadPool Pool(4);
+  RangeSum R = { &Pool, 0, 100000, 0 };
+  TaskGroup G(Pool);
+  G.spawn(&RangeSum::run, &R);
+  G.wait();
+  EXPECT_EQ(100000ULL * 99999 / 2, R.Sum);
+}
+
+// A single worker must not deadlock when its tasks wait for other tasks.
+TEST(ThreadPoolTest, NestedOneThread) {
+  ThreadPool Pool(1);
+  RangeSum R = { &Pool, 0, 10000, 0 };
+  RangeSum::run(&R);
+  EXPECT_EQ(10000ULL * 9999 / 2, R.Sum);
+}
+
+struct Square {
+  void operator()(unsigned &X) const { X *= X; }
+};
+
+TEST(ThreadPoolTest, ParallelForEach) {
+  ThreadPool Pool(4);
+  std::vector<unsigned> V;
+  for (unsigned i = 0; i != 10000; ++i)
+    V.push_back(i);
+  parallel_for_each(Pool, V.begin(), V.end(), Square());
+  for (unsigned i = 0; i != 10000; ++i)
+    EXPECT_EQ(i * i, V[i]);
+
+  // Empty ranges and ranges smaller than the pool.
+  parallel_for_each(Pool, V.begin(), V.begin(), Square());
+  parallel_for_each(Pool, V.begin(), V.begin() + 3, Square());
+  EXPECT_EQ(1U, V[1]);
+  EXPECT_EQ(16U, V[2]);
+}
+
+// Elements whose cost grows with their index, so that the first chunks are
+// done long before the last ones and the threads have to steal from each
+// other to stay busy.
+struct Collatz {
+  void operator()(unsigned &X) const {
+    unsigned Steps = 0;
+    for (unsigned i = 0; i != X; ++i) {
+      unsigned long long N = i + 1;
+      while (N != 1) {
+        N = N & 1 ? 3 * N + 1 : N / 2;
+        ++Steps;
+      }
+    }
+    X = Steps;
+  }
+};
+
+TEST(ThreadPoolTest, UnevenWork) {
+  std::vector<unsigned> V;
+  for (unsigned i = 0; i != 200; ++i)
+    V.push_back(i * 10);
+  std::vector<unsigned> Expected = V;
+  for (unsigned i = 0, e = Expected.size(); i != e; ++i)
+    Collatz()(Expected[i]);
+
+  ThreadPool Pool(4);
+  parallel_for_each(Pool, V.begin(), V.end(), Collatz(), 1);
+  EXPECT_TRUE(Expected == V);
+}
+
+void nothing(void *) {}
+
+double getWallTime() {
+  return TimeRecord::getCurrentTime(false).getWallTime();
+}
+
+// Pool overhead on an uneven workload and on empty tasks, for 1 to 8
+// threads.  Disabled by default; run it with --gtest_also_run_disabled_tests.
+TEST(ThreadPoolTest, DISABLED_Throughput) {
+  std::vector<unsigned> Input;
+  for (unsigned i = 0; i != 2000; ++i)
+    Input.push_back(i * 10);
+
+  std::vector<unsigned> V = Input;
+  double Start = getWallTime();
+  for (unsigned i = 0, e = V.size(); i != e; ++i)
+    Collatz()(V[i]);
+  outs() << format("Collatz serial: %.3fs\n", getWallTime() - Start);
+  std::vector<unsigned> Expected = V;
+
+  for (unsigned NumThreads = 1; NumThreads <= 8; NumThreads *= 2) {
+    ThreadPool Pool(NumThreads);
+
+    V = Input;
+    Start = getWallTime();
+    parallel_for_each(Pool, V.begin(), V.end(), Collatz());
+    double CollatzTime = getWallTime() - Start;
+    EXPECT_TRUE(Expected == V);
+
+    Start = getWallTime();
+    {
+      TaskGroup G(Pool);
+      for (unsigned i = 0; i != 1000000; ++i)
+        G.spawn(&nothing, 0);
+    }
+    double SpawnTime = getWallTime() - Start;
+
+    outs() << format("%u threads: Collatz %.3fs, ", NumThreads, CollatzTime)
+           << format("1M empty tasks %.3fs\n", SpawnTime);
+  }
+}
+
+}
@@ -0,0 +1,46 @@
+//===- llvm/unittest/VMCore/AsmWriterTest.cpp - AsmWriter unit tests ------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+namespace llvm {
+namespace {
+
+// The writer buffers its output while printing to an unbuffered stream.  The
+// stream has to be unbuffered again afterwards.
+TEST(AsmWriterTest, UnbufferedStreamStaysUnbuffered) {
+  LLVMContext Context;
+  OwningPtr<Module> M(new Module("test", Context));
+  Constant *One = ConstantInt::get(Type::getInt32Ty(Context), 1);
+
+  std::string Str;
+  raw_string_ostream OS(Str);
+  OS.SetUnbuffered();
+  M->print(OS, 0);
+  EXPECT_EQ(0u, OS.GetBufferSize());
+  EXPECT_EQ("; ModuleID = 'test'\n", Str);
+
+  Str.clear();
+  One->print(OS);
+  EXPECT_EQ(0u, OS.GetBufferSize());
+  EXPECT_EQ("i32 1", Str);
+
+  One->print(errs());
+  errs() << '\n';
+  EXPECT_EQ(0u, errs().GetBufferSize());
+}
+
+}  // end anonymous namespace
+}  // end namespace llvm
@@ -10,7 +10,10 @@
 #include "llvm/Instructions.h"
 #include "llvm/BasicBlock.h"
 #include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
 #include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/ValueSymbolTable.h"
 #include "llvm/ADT/STLExtras.h"
 #include "gtest/gtest.h"
 
@@ -107,5 +110,32 @@ TEST(InstructionsTest, BranchInst) {
   delete bb1;
 }
 
+TEST(InstructionsTest, DiscardValueNames) {
+  LLVMContext C;
+  C.setDiscardValueNames(true);
+
+  Module M("M", C);
+  const IntegerType *Int32 = IntegerType::get(C, 32);
+  std::vector<const Type*> Params(1, Int32);
+  Function *F = Function::Create(FunctionType::get(Int32, Params, false),
+                                 GlobalValue::ExternalLinkage, "f", &M);
+  Argument *A = F->arg_begin();
+  A->setName("a");
+  BasicBlock *BB = BasicBlock::Create(C, "entry", F);
+  Instruction *Add = BinaryOperator::CreateAdd(A, A, "sum", BB);
+  ReturnInst::Create(C, Add, BB);
+
+  // Global values keep their names, local values don't get any.
+  EXPECT_EQ("f", F->getName());
+  EXPECT_FALSE(A->hasName());
+  EXPECT_FALSE(BB->hasName());
+  EXPECT_FALSE(Add->hasName());
+  EXPECT_TRUE(F->getValueSymbolTable().empty());
+
+  C.setDiscardValueNames(false);
+  Add->setName("sum");
+  EXPECT_EQ("sum", Add->getName());
+}
+
 }  // end anonymous namespace
 }  // end namespace llvm
@@ -24,10 +24,13 @@
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/Timer.h"
 #include "llvm/Support/system_error.h"
 #include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringMap.h"
 #include <algorithm>
+#include <cstring>
 using namespace llvm;
 
 static cl::opt<std::string>
@@ -45,6 +48,10 @@ static cl::opt<bool>
 NoCanonicalizeWhiteSpace("strict-whitespace",
               cl::desc("Do not treat all horizontal whitespace as equivalent"));
 
+static cl::opt<bool>
+TimeChecks("time-checks",
+           cl::desc("Report the time spent matching each check string"));
+
 //===----------------------------------------------------------------------===//
 // Pattern Handling Code.
 //===----------------------------------------------------------------------===//
@@ -63,6 +70,12 @@ class Pattern {
   /// RegEx - If non-empty, this is a regex pattern.
   std::string RegExStr;
 
+  /// Literal - For a regex pattern, the longest fixed string that any match
+  /// must contain, or empty if there is none that can be relied upon.  Such
+  /// a regex can only match within a single line, so Match searches for the
+  /// literal and runs the regex over just the lines it occurs on.
+  StringRef Literal;
+
   /// VariableUses - Entries in this vector map to uses of a variable in the
   /// pattern, e.g. "foo[[bar]]baz".  In this case, the RegExStr will contain
   /// "foobaz" and we'll get an entry in this vector that tells us to insert the
@@ -99,6 +112,11 @@ private:
   static void AddFixedStringToRegEx(StringRef FixedStr, std::string &TheStr);
   bool AddRegExToRegEx(StringRef RegExStr, unsigned &CurParen, SourceMgr &SM);
 
+  /// MatchRegEx - Run the regex R over Buffer, restricted to the lines that
+  /// contain Literal when that is safe.
+  bool MatchRegEx(Regex &R, StringRef Buffer, bool UseLiteral,
+                  SmallVectorImpl<StringRef> &MatchInfo) const;
+
   /// ComputeMatchDistance - Compute an arbitrary estimate for the quality of
   /// matching this pattern at the start of \arg Buffer; a distance of zero
   /// should correspond to a perfect match.
@@ -134,6 +152,10 @@ bool Pattern::ParsePattern(StringRef PatternStr, SourceMgr &SM) {
   // values add from their.
   unsigned CurParen = 1;
 
+  // Whether the fixed strings in the pattern are guaranteed to be part of
+  // every match, and every match is guaranteed to stay on one line.
+  bool LiteralIsRequired = true;
+
   // Otherwise, there is at least one regex piece.  Build up the regex pattern
   // by escaping scary characters in fixed strings, building up one big regex.
   while (!PatternStr.empty()) {
@@ -149,8 +171,15 @@ bool Pattern::ParsePattern(StringRef PatternStr, SourceMgr &SM) {
         return true;
       }
 
-      if (AddRegExToRegEx(PatternStr.substr(2, End-2), CurParen, SM))
+      StringRef RegexPiece = PatternStr.substr(2, End-2);
+      if (AddRegExToRegEx(RegexPiece, CurParen, SM))
         return true;
+      // A top-level '|' splits the whole regex, making the fixed strings
+      // optional, and [:space:] or [:cntrl:] can match across a newline.
+      if (RegexPiece.find('|') != StringRef::npos ||
+          RegexPiece.find("[:space:]") != StringRef::npos ||
+          RegexPiece.find("[:cntrl:]") != StringRef::npos)
+        LiteralIsRequired = false;
       PatternStr = PatternStr.substr(End+2);
       continue;
     }
@@ -212,8 +241,12 @@ bool Pattern::ParsePattern(StringRef PatternStr, SourceMgr &SM) {
       RegExStr += '(';
       ++CurParen;
 
-      if (AddRegExToRegEx(MatchStr.substr(NameEnd+1), CurParen, SM))
+      StringRef RegexPiece = MatchStr.substr(NameEnd+1);
+      if (AddRegExToRegEx(RegexPiece, CurParen, SM))
         return true;
+      if (RegexPiece.find("[:space:]") != StringRef::npos ||
+          RegexPiece.find("[:cntrl:]") != StringRef::npos)
+        LiteralIsRequired = false;
 
       RegExStr += ')';
     }
@@ -222,14 +255,43 @@ bool Pattern::ParsePattern(StringRef PatternStr, SourceMgr &SM) {
     // Find the end, which is the start of the next regex.
     size_t FixedMatchEnd = PatternStr.find("{{");
     FixedMatchEnd = std::min(FixedMatchEnd, PatternStr.find("[["));
-    AddFixedStringToRegEx(PatternStr.substr(0, FixedMatchEnd), RegExStr);
+    StringRef FixedPiece = PatternStr.substr(0, FixedMatchEnd);
+    AddFixedStringToRegEx(FixedPiece, RegExStr);
+    if (FixedPiece.size() > Literal.size())
+      Literal = FixedPiece;
     PatternStr = PatternStr.substr(FixedMatchEnd);
     continue;
   }
 
+  if (!LiteralIsRequired)
+    Literal = StringRef();
+
   return false;
 }
 
+/// FindLiteral - Return the offset of the first occurrence of Str in Buffer
+/// at or after From, or npos.  memchr skips to each occurrence of the first
+/// character, which is much faster than comparing at every offset.
+static size_t FindLiteral(StringRef Buffer, StringRef Str, size_t From = 0) {
+  if (Str.empty())
+    return From <= Buffer.size() ? From : StringRef::npos;
+  if (Str.size() > Buffer.size())
+    return StringRef::npos;
+
+  const char *Start = Buffer.data();
+  const char *Last = Start + Buffer.size() - Str.size();
+  const char *P = Start + From;
+  while (P <= Last) {
+    P = static_cast<const char*>(memchr(P, Str[0], Last - P + 1));
+    if (!P)
+      return StringRef::npos;
+    if (memcmp(P + 1, Str.data() + 1, Str.size() - 1) == 0)
+      return P - Start;
+    ++P;
+  }
+  return StringRef::npos;
+}
+
 void Pattern::AddFixedStringToRegEx(StringRef FixedStr, std::string &TheStr) {
   // Add the characters from FixedStr to the regex, escaping as needed.  This
   // avoids "leaning toothpicks" in common patterns.
@@ -286,7 +348,7 @@ size_t Pattern::Match(StringRef Buffer, size_t &MatchLen,
   // If this is a fixed string pattern, just match it now.
   if (!FixedStr.empty()) {
     MatchLen = FixedStr.size();
-    return Buffer.find(FixedStr);
+    return FindLiteral(Buffer, FixedStr);
   }
 
   // Regex match.
@@ -295,6 +357,7 @@ size_t Pattern::Match(StringRef Buffer, size_t &MatchLen,
   // actual value.
   StringRef RegExToMatch = RegExStr;
   std::string TmpStr;
+  bool UseLiteral = !Literal.empty();
   if (!VariableUses.empty()) {
     TmpStr = RegExStr;
 
@@ -306,6 +369,10 @@ size_t Pattern::Match(StringRef Buffer, size_t &MatchLen,
       if (it == VariableTable.end())
         return StringRef::npos;
 
+      // A value spanning lines lets the regex match across a newline.
+      if (it->second.find('\n') != StringRef::npos)
+        UseLiteral = false;
+
       // Look up the value and escape it so that we can plop it into the regex.
       std::string Value;
       AddFixedStringToRegEx(it->second, Value);
@@ -322,7 +389,8 @@ size_t Pattern::Match(StringRef Buffer, size_t &MatchLen,
 
 
   SmallVector<StringRef, 4> MatchInfo;
-  if (!Regex(RegExToMatch, Regex::Newline).match(Buffer, &MatchInfo))
+  Regex R(RegExToMatch, Regex::Newline);
+  if (!MatchRegEx(R, Buffer, UseLiteral, MatchInfo))
     return StringRef::npos;
 
   // Successful regex match.
@@ -340,6 +408,35 @@ size_t Pattern::Match(StringRef Buffer, size_t &MatchLen,
   return FullMatch.data()-Buffer.data();
 }
 
+bool Pattern::MatchRegEx(Regex &R, StringRef Buffer, bool UseLiteral,
+                         SmallVectorImpl<StringRef> &MatchInfo) const {
+  if (!UseLiteral)
+    return R.match(Buffer, &MatchInfo);
+
+  // Every match lies within one line and contains Literal, so the first line
+  // holding a match is among the lines the literal occurs on.  Try those in
+  // order; the leftmost match on the first one that matches is the leftmost
+  // match in the whole buffer.
+  size_t From = 0;
+  while (1) {
+    size_t Pos = FindLiteral(Buffer, Literal, From);
+    if (Pos == StringRef::npos)
+      return false;
+
+    size_t LineStart = Buffer.rfind('\n', Pos);
+    LineStart = LineStart == StringRef::npos ? 0 : LineStart+1;
+    size_t LineEnd = std::min(Buffer.find('\n', Pos+Literal.size()),
+                              Buffer.size());
+
+    if (R.match(Buffer.slice(LineStart, LineEnd), &MatchInfo))
+      return true;
+
+    if (LineEnd == Buffer.size())
+      return false;
+    From = LineEnd+1;
+  }
+}
+
 unsigned Pattern::ComputeMatchDistance(StringRef Buffer,
                               const StringMap<StringRef> &VariableTable) const {
   // Just compute the number of matching characters. For regular expressions, we
@@ -679,8 +776,25 @@ int main(int argc, char **argv) {
 
   const char *LastMatch = Buffer.data();
 
+  // With -time-checks, give each check string a timer named after its line
+  // in the check file.  The group prints its report when main returns.
+  TimerGroup CheckTimers("FileCheck per-check timing");
+  std::vector<Timer> Timers;
+  if (TimeChecks) {
+    Timers.resize(CheckStrings.size());
+    for (unsigned i = 0, e = CheckStrings.size(); i != e; ++i) {
+      const CheckString &CheckStr = CheckStrings[i];
+      const char *Start = CheckStr.Loc.getPointer(), *End = Start;
+      while (*End && *End != '\n' && *End != '\r' && End - Start < 60)
+        ++End;
+      Timers[i].init("line " + utostr(SM.FindLineNumber(CheckStr.Loc)) +
+                     ": " + std::string(Start, End), CheckTimers);
+    }
+  }
+
   for (unsigned StrNo = 0, e = CheckStrings.size(); StrNo != e; ++StrNo) {
     const CheckString &CheckStr = CheckStrings[StrNo];
+    TimeRegion CheckTime(TimeChecks ? &Timers[StrNo] : 0);
 
     StringRef SearchFrom = Buffer;
 
@@ -16,6 +16,7 @@
 #include "Record.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FormattedStream.h"
@@ -30,6 +31,13 @@ static cl::opt<bool>
 OmitComments("omit-comments", cl::desc("Do not generate comments"),
              cl::init(false));
 
+// Trades the size of the matcher table for the speed of compiled code.
+static cl::opt<bool>
+DirectDispatch("dag-isel-direct-dispatch",
+               cl::desc("Emit the instruction selector as C++ code that "
+                        "matches directly instead of as a matcher table"),
+               cl::init(false));
+
 namespace {
 class MatcherTableEmitter {
   const CodeGenDAGPatterns &CGP;
@@ -45,9 +53,13 @@ class MatcherTableEmitter {
 
   bool useEmitRegister2;
 
+  /// NextDirectID - Used to give the variables in the direct-dispatch
+  /// selector unique names.
+  unsigned NextDirectID;
+
 public:
   MatcherTableEmitter(const CodeGenDAGPatterns &cgp, bool _useEmitRegister2)
-    : CGP(cgp), useEmitRegister2(_useEmitRegister2) {}
+    : CGP(cgp), useEmitRegister2(_useEmitRegister2), NextDirectID(0) {}
 
   unsigned EmitMatcherList(const Matcher *N, unsigned Indent,
                            unsigned StartIdx, formatted_raw_ostream &OS);
@@ -55,10 +67,21 @@ public:
   void EmitPredicateFunctions(formatted_raw_ostream &OS);
 
   void EmitHistogram(const Matcher *N, formatted_raw_ostream &OS);
+
+  void EmitDirectSelector(const Matcher *N, formatted_raw_ostream &OS);
 private:
   unsigned EmitMatcher(const Matcher *N, unsigned Indent, unsigned CurrentIdx,
                        formatted_raw_ostream &OS);
 
+  void EmitDirectMatcherList(const Matcher *N, unsigned Indent,
+                             std::vector<std::string> NodeStack,
+                             formatted_raw_ostream &OS);
+  void EmitDirectMatcher(const Matcher *N, unsigned Indent,
+                         std::vector<std::string> &NodeStack,
+                         formatted_raw_ostream &OS);
+  void EmitDirectFunction(const std::string &Name, const Matcher *N,
+                          formatted_raw_ostream &OS);
+
   unsigned getNodePredicate(StringRef PredName) {
     unsigned &Entry = NodePredicateMap[PredName];
     if (Entry == 0) {
@@ -721,6 +744,519 @@ void MatcherTableEmitter::EmitPredicateFunctions(formatted_raw_ostream &OS) {
   }
 }
 
+/// GetInt64Literal - Return a C++ literal for the specified value.
+static std::string GetInt64Literal(int64_t Val) {
+  // -2^31 is left out, since it is the negation of an out of range int.
+  if (Val > -2147483648LL && Val <= 2147483647LL)
+    return itostr(Val);
+  return "(int64_t)UINT64_C(" + utostr((uint64_t)Val) + ")";
+}
+
+/// GetDirectTypeCheck - Return the condition under which the value V does
+/// not have type VT.
+static std::string GetDirectTypeCheck(const std::string &V,
+                                      MVT::SimpleValueType VT) {
+  std::string Check = V + " != " + getEnumName(VT);
+  if (VT == MVT::iPTR)
+    Check += " && " + V + " != TLI.getPointerTy()";
+  return Check;
+}
+
+/// EmitDirectMatcher - Emit C++ code that runs the specified matcher node
+/// directly.  NodeStack holds the names of the variables that hold the nodes
+/// on the matcher's node stack, the current node last.  A check that fails
+/// executes 'break', which leaves the innermost do/while(0) or switch; the
+/// code after that is where the failure is handled.
+void MatcherTableEmitter::
+EmitDirectMatcher(const Matcher *N, unsigned Indent,
+                  std::vector<std::string> &NodeStack,
+                  formatted_raw_ostream &OS) {
+  const std::string &CurN = NodeStack.back();
+  OS.indent(Indent*2);
+
+  switch (N->getKind()) {
+  case Matcher::Scope: {
+    // Each child runs in its own do/while(0), so that a failed check goes on
+    // to the next child once the match state is rolled back.  If the last
+    // child fails, the failure falls through to the enclosing matcher.
+    const ScopeMatcher *SM = cast<ScopeMatcher>(N);
+    assert(SM->getNext() == 0 && "Shouldn't have next after scope");
+    std::string CP = "CP" + utostr(NextDirectID++);
+    OS << "MatchState::Checkpoint " << CP << "(S);";
+    if (!OmitComments)
+      OS << "  // " << SM->getNumChildren() << " children in Scope";
+    OS << '\n';
+    for (unsigned i = 0, e = SM->getNumChildren(); i != e; ++i) {
+      if (i != 0)
+        OS.indent(Indent*2) << "S.rollback(" << CP << ");\n";
+      OS.indent(Indent*2) << "do {\n";
+      EmitDirectMatcherList(SM->getChild(i), Indent+1, NodeStack, OS);
+      OS.indent(Indent*2) << "} while (0);\n";
+    }
+    return;
+  }
+
+  case Matcher::RecordNode:
+    OS << "S.record(" << CurN << ", ";
+    if (NodeStack.size() > 1)
+      OS << NodeStack[NodeStack.size()-2] << ".getNode()";
+    else
+      OS << '0';
+    OS << ");";
+    if (!OmitComments)
+      OS << "  // #" << cast<RecordMatcher>(N)->getResultNo() << " = "
+         << cast<RecordMatcher>(N)->getWhatFor();
+    OS << '\n';
+    return;
+
+  case Matcher::RecordChild: {
+    unsigned ChildNo = cast<RecordChildMatcher>(N)->getChildNo();
+    OS << "if (" << ChildNo << " >= " << CurN << ".getNumOperands()) break;\n";
+    OS.indent(Indent*2) << "S.record(" << CurN << ".getOperand(" << ChildNo
+                        << "), " << CurN << ".getNode());";
+    if (!OmitComments)
+      OS << "  // #" << cast<RecordChildMatcher>(N)->getResultNo() << " = "
+         << cast<RecordChildMatcher>(N)->getWhatFor();
+    OS << '\n';
+    return;
+  }
+
+  case Matcher::RecordMemRef:
+    OS << "S.MatchedMemRefs.push_back(cast<MemSDNode>(" << CurN
+       << ")->getMemOperand());\n";
+    return;
+
+  case Matcher::CaptureGlueInput:
+    OS << "CaptureGlueInput(S, " << CurN << ");\n";
+    return;
+
+  case Matcher::MoveChild: {
+    unsigned ChildNo = cast<MoveChildMatcher>(N)->getChildNo();
+    std::string Child = "N" + utostr(NextDirectID++);
+    OS << "if (" << ChildNo << " >= " << CurN << ".getNumOperands()) break;\n";
+    OS.indent(Indent*2) << "SDValue " << Child << " = " << CurN
+                        << ".getOperand(" << ChildNo << ");\n";
+    NodeStack.push_back(Child);
+    return;
+  }
+
+  case Matcher::MoveParent:
+    assert(NodeStack.size() > 1 && "Node stack imbalance!");
+    NodeStack.pop_back();
+    if (!OmitComments)
+      OS << "// MoveParent";
+    OS << '\n';
+    return;
+
+  case Matcher::CheckSame:
+    OS << "if (" << CurN << " != S.RecordedNodes["
+       << cast<CheckSameMatcher>(N)->getMatchNumber() << "].first) break;\n";
+    return;
+
+  case Matcher::CheckPatternPredicate:
+    OS << "if (!(" << cast<CheckPatternPredicateMatcher>(N)->getPredicate()
+       << ")) break;\n";
+    return;
+
+  case Matcher::CheckPredicate: {
+    StringRef Pred = cast<CheckPredicateMatcher>(N)->getPredicateName();
+    OS << "if (!CheckNodePredicate(" << CurN << ".getNode(), "
+       << getNodePredicate(Pred) << ")) break;";
+    if (!OmitComments)
+      OS << "  // " << Pred;
+    OS << '\n';
+    return;
+  }
+
+  case Matcher::CheckOpcode:
+    OS << "if (" << CurN << ".getOpcode() != "
+       << cast<CheckOpcodeMatcher>(N)->getOpcode().getEnumName()
+       << ") break;\n";
+    return;
+
+  case Matcher::SwitchOpcode: {
+    const SwitchOpcodeMatcher *SOM = cast<SwitchOpcodeMatcher>(N);
+    OS << "switch (" << CurN << ".getOpcode()) {\n";
+    for (unsigned i = 0, e = SOM->getNumCases(); i != e; ++i) {
+      OS.indent(Indent*2) << "case " << SOM->getCaseOpcode(i).getEnumName()
+                          << ": {\n";
+      EmitDirectMatcherList(SOM->getCaseMatcher(i), Indent+1, NodeStack, OS);
+      OS.indent(Indent*2+2) << "break;\n";
+      OS.indent(Indent*2) << "}\n";
+    }
+    OS.indent(Indent*2) << "}\n";
+    return;
+  }
+
+  case Matcher::SwitchType: {
+    // iPTR can't be a case label, so switches that have it test the cases in
+    // order, like the matcher table does.
+    const SwitchTypeMatcher *STM = cast<SwitchTypeMatcher>(N);
+    bool HasIPTR = false;
+    for (unsigned i = 0, e = STM->getNumCases(); i != e; ++i)
+      HasIPTR |= STM->getCaseType(i) == MVT::iPTR;
+
+    std::string VT = "VT" + utostr(NextDirectID++);
+    OS << "MVT::SimpleValueType " << VT << " = " << CurN
+       << ".getValueType().getSimpleVT().SimpleTy;\n";
+    if (!HasIPTR)
+      OS.indent(Indent*2) << "switch (" << VT << ") {\n";
+    for (unsigned i = 0, e = STM->getNumCases(); i != e; ++i) {
+      MVT::SimpleValueType CaseVT = STM->getCaseType(i);
+      OS.indent(Indent*2);
+      if (!HasIPTR)
+        OS << "case " << getEnumName(CaseVT) << ": {\n";
+      else {
+        if (i != 0)
+          OS << "} else ";
+        OS << "if (" << VT << " == ";
+        if (CaseVT == MVT::iPTR)
+          OS << "TLI.getPointerTy().SimpleTy";
+        else
+          OS << getEnumName(CaseVT);
+        OS << ") {\n";
+      }
+      EmitDirectMatcherList(STM->getCaseMatcher(i), Indent+1, NodeStack, OS);
+      if (!HasIPTR) {
+        OS.indent(Indent*2+2) << "break;\n";
+        OS.indent(Indent*2) << "}\n";
+      }
+    }
+    OS.indent(Indent*2) << "}\n";
+    return;
+  }
+
+  case Matcher::CheckType:
+    assert(cast<CheckTypeMatcher>(N)->getResNo() == 0 &&
+           "FIXME: Add support for CheckType of resno != 0");
+    OS << "if (" << GetDirectTypeCheck(CurN + ".getValueType()",
+                                       cast<CheckTypeMatcher>(N)->getType())
+       << ") break;\n";
+    return;
+
+  case Matcher::CheckChildType: {
+    const CheckChildTypeMatcher *CCTM = cast<CheckChildTypeMatcher>(N);
+    std::string Child =
+      CurN + ".getOperand(" + utostr(CCTM->getChildNo()) + ")";
+    OS << "if (" << CCTM->getChildNo() << " >= " << CurN
+       << ".getNumOperands() ||\n";
+    OS.indent(Indent*2+4) << GetDirectTypeCheck(Child + ".getValueType()",
+                                                CCTM->getType())
+                          << ") break;\n";
+    return;
+  }
+
+  case Matcher::CheckInteger:
+    OS << "if (!isa<ConstantSDNode>(" << CurN << ") ||\n";
+    OS.indent(Indent*2+4) << "cast<ConstantSDNode>(" << CurN
+       << ")->getSExtValue() != "
+       << GetInt64Literal(cast<CheckIntegerMatcher>(N)->getValue())
+       << ") break;\n";
+    return;
+
+  case Matcher::CheckCondCode:
+    OS << "if (cast<CondCodeSDNode>(" << CurN << ")->get() != ISD::"
+       << cast<CheckCondCodeMatcher>(N)->getCondCodeName() << ") break;\n";
+    return;
+
+  case Matcher::CheckValueType: {
+    StringRef TypeName = cast<CheckValueTypeMatcher>(N)->getTypeName();
+    std::string VT = "cast<VTSDNode>(" + CurN + ")->getVT()";
+    OS << "if (" << VT << " != MVT::" << TypeName;
+    if (TypeName == "iPTR")
+      OS << " && " << VT << " != TLI.getPointerTy()";
+    OS << ") break;\n";
+    return;
+  }
+
+  case Matcher::CheckComplexPat: {
+    const CheckComplexPatMatcher *CCPM = cast<CheckComplexPatMatcher>(N);
+    const ComplexPattern &Pattern = CCPM->getPattern();
+    std::string Rec =
+      "S.RecordedNodes[" + utostr(CCPM->getMatchNumber()) + "]";
+    OS << "if (!CheckComplexPattern(S.NodeToMatch, " << Rec << ".second, "
+       << Rec << ".first,\n";
+    OS.indent(Indent*2+4) << getComplexPat(Pattern)
+                           << ", S.RecordedNodes)) break;";
+    if (!OmitComments)
+      OS << "  // " << Pattern.getSelectFunc() << ":$" << CCPM->getName();
+    OS << '\n';
+    return;
+  }
+
+  case Matcher::CheckAndImm:
+  case Matcher::CheckOrImm: {
+    bool IsAnd = isa<CheckAndImmMatcher>(N);
+    int64_t Val = IsAnd ? cast<CheckAndImmMatcher>(N)->getValue()
+                        : cast<CheckOrImmMatcher>(N)->getValue();
+    std::string RHS = CurN + ".getOperand(1)";
+    OS << "if (" << CurN << ".getOpcode() != ISD::" << (IsAnd ? "AND" : "OR")
+       << " || !isa<ConstantSDNode>(" << RHS << ") ||\n";
+    OS.indent(Indent*2+4) << "!" << (IsAnd ? "CheckAndMask" : "CheckOrMask")
+       << '(' << CurN << ".getOperand(0), cast<ConstantSDNode>(" << RHS
+       << "), " << GetInt64Literal(Val) << ")) break;\n";
+    return;
+  }
+
+  case Matcher::CheckFoldableChainNode: {
+    OS << "{\n";
+    OS.indent(Indent*2+2) << "const SDValue Stack[] = { ";
+    for (unsigned i = 0, e = NodeStack.size(); i != e; ++i)
+      OS << (i ? ", " : "") << NodeStack[i];
+    OS << " };\n";
+    OS.indent(Indent*2+2) << "if (!IsFoldableChainNode(S, Stack, "
+                          << NodeStack.size() << ")) break;\n";
+    OS.indent(Indent*2) << "}\n";
+    return;
+  }
+
+  case Matcher::EmitInteger:
+    OS << "S.record(CurDAG->getTargetConstant("
+       << GetInt64Literal(cast<EmitIntegerMatcher>(N)->getValue()) << ", "
+       << getEnumName(cast<EmitIntegerMatcher>(N)->getVT()) << "), 0);\n";
+    return;
+
+  case Matcher::EmitStringInteger:
+    OS << "S.record(CurDAG->getTargetConstant("
+       << cast<EmitStringIntegerMatcher>(N)->getValue() << ", "
+       << getEnumName(cast<EmitStringIntegerMatcher>(N)->getVT())
+       << "), 0);\n";
+    return;
+
+  case Matcher::EmitRegister: {
+    const EmitRegisterMatcher *ER = cast<EmitRegisterMatcher>(N);
+    OS << "S.record(CurDAG->getRegister(";
+    if (Record *R = ER->getReg())
+      OS << getQualifiedName(R);
+    else
+      OS << '0';
+    OS << ", " << getEnumName(ER->getVT()) << "), 0);\n";
+    return;
+  }
+
+  case Matcher::EmitConvertToTarget:
+    OS << "EmitConvertToTarget(S, "
+       << cast<EmitConvertToTargetMatcher>(N)->getSlot() << ");\n";
+    return;
+
+  case Matcher::EmitMergeInputChains: {
+    const EmitMergeInputChainsMatcher *MN =
+      cast<EmitMergeInputChainsMatcher>(N);
+    OS << "{\n";
+    OS.indent(Indent*2+2) << "static const unsigned RecNos[] = { ";
+    for (unsigned i = 0, e = MN->getNumNodes(); i != e; ++i)
+      OS << (i ? ", " : "") << MN->getNode(i);
+    OS << " };\n";
+    OS.indent(Indent*2+2) << "if (!EmitMergeInputChains(S, RecNos, "
+                          << MN->getNumNodes() << ")) break;\n";
+    OS.indent(Indent*2) << "}\n";
+    return;
+  }
+
+  case Matcher::EmitCopyToReg:
+    OS << "EmitCopyToReg(S, S.RecordedNodes["
+       << cast<EmitCopyToRegMatcher>(N)->getSrcSlot() << "].first, "
+       << getQualifiedName(cast<EmitCopyToRegMatcher>(N)->getDestPhysReg())
+       << ");\n";
+    return;
+
+  case Matcher::EmitNodeXForm: {
+    const EmitNodeXFormMatcher *XF = cast<EmitNodeXFormMatcher>(N);
+    OS << "S.record(RunSDNodeXForm(S.RecordedNodes[" << XF->getSlot()
+       << "].first, " << getNodeXFormID(XF->getNodeXForm()) << "), 0);";
+    if (!OmitComments)
+      OS << "  // " << XF->getNodeXForm()->getName();
+    OS << '\n';
+    return;
+  }
+
+  case Matcher::EmitNode:
+  case Matcher::MorphNodeTo: {
+    const EmitNodeMatcherCommon *EN = cast<EmitNodeMatcherCommon>(N);
+    bool IsMorph = isa<MorphNodeToMatcher>(EN);
+    OS << "{\n";
+    if (EN->getNumVTs()) {
+      OS.indent(Indent*2+2) << "static const MVT::SimpleValueType VTs[] = { ";
+      for (unsigned i = 0, e = EN->getNumVTs(); i != e; ++i)
+        OS << (i ? ", " : "") << getEnumName(EN->getVT(i));
+      OS << " };\n";
+    }
+    if (EN->getNumOperands()) {
+      OS.indent(Indent*2+2) << "SDValue Ops[] = {";
+      for (unsigned i = 0, e = EN->getNumOperands(); i != e; ++i) {
+        OS << (i ? ",\n" : "\n");
+        OS.indent(Indent*2+4) << "S.RecordedNodes[" << EN->getOperand(i)
+                              << "].first";
+      }
+      OS << " };\n";
+    }
+
+    OS.indent(Indent*2+2);
+    if (IsMorph)
+      OS << "Result = ";
+    OS << "EmitMatchedNode(S, " << (IsMorph ? "true" : "false") << ", "
+       << EN->getOpcodeName() << ", 0";
+    if (EN->hasChain())   OS << "|OPFL_Chain";
+    if (EN->hasInFlag())  OS << "|OPFL_GlueInput";
+    if (EN->hasOutFlag()) OS << "|OPFL_GlueOutput";
+    if (EN->hasMemRefs()) OS << "|OPFL_MemRefs";
+    if (EN->getNumFixedArityOperands() != -1)
+      OS << "|OPFL_Variadic" << EN->getNumFixedArityOperands();
+    OS << ",\n";
+    OS.indent(Indent*2+6);
+    if (EN->getNumVTs())
+      OS << "VTs, " << EN->getNumVTs() << ", ";
+    else
+      OS << "0, 0, ";
+    if (EN->getNumOperands())
+      OS << "Ops, " << EN->getNumOperands() << ");";
+    else
+      OS << "0, 0);";
+
+    if (!OmitComments) {
+      if (const EmitNodeMatcher *E = dyn_cast<EmitNodeMatcher>(EN)) {
+        if (unsigned NumResults = EN->getNumVTs()) {
+          OS << "  // Results =";
+          unsigned First = E->getFirstResultSlot();
+          for (unsigned i = 0; i != NumResults; ++i)
+            OS << " #" << First+i;
+        }
+      }
+    }
+    OS << '\n';
+
+    if (IsMorph) {
+      const MorphNodeToMatcher *SNT = cast<MorphNodeToMatcher>(N);
+      if (!OmitComments) {
+        OS.indent(Indent*2+2) << "// Src: "
+          << *SNT->getPattern().getSrcPattern() << " - Complexity = "
+          << SNT->getPattern().getPatternComplexity(CGP) << '\n';
+        OS.indent(Indent*2+2) << "// Dst: "
+          << *SNT->getPattern().getDstPattern() << '\n';
+      }
+      OS.indent(Indent*2+2) << "return true;\n";
+    }
+    OS.indent(Indent*2) << "}\n";
+    return;
+  }
+
+  case Matcher::MarkGlueResults: {
+    const MarkGlueResultsMatcher *CFR = cast<MarkGlueResultsMatcher>(N);
+    for (unsigned i = 0, e = CFR->getNumNodes(); i != e; ++i) {
+      if (i != 0)
+        OS.indent(Indent*2);
+      OS << "S.GlueResultNodesMatched.push_back(S.RecordedNodes["
+         << CFR->getNode(i) << "].first.getNode());\n";
+    }
+    return;
+  }
+
+  case Matcher::CompleteMatch: {
+    const CompleteMatchMatcher *CM = cast<CompleteMatchMatcher>(N);
+    OS << "{\n";
+    if (CM->getNumResults()) {
+      OS.indent(Indent*2+2) << "SDValue Results[] = { ";
+      for (unsigned i = 0, e = CM->getNumResults(); i != e; ++i)
+        OS << (i ? ", " : "") << "S.RecordedNodes[" << CM->getResult(i)
+           << "].first";
+      OS << " };\n";
+      OS.indent(Indent*2+2) << "CompleteMatch(S, Results, "
+                            << CM->getNumResults() << ");\n";
+    } else
+      OS.indent(Indent*2+2) << "CompleteMatch(S, 0, 0);\n";
+    if (!OmitComments) {
+      OS.indent(Indent*2+2) << "// Src: "
+        << *CM->getPattern().getSrcPattern() << " - Complexity = "
+        << CM->getPattern().getPatternComplexity(CGP) << '\n';
+      OS.indent(Indent*2+2) << "// Dst: "
+        << *CM->getPattern().getDstPattern() << '\n';
+    }
+    OS.indent(Indent*2+2) << "Result = 0;\n";
+    OS.indent(Indent*2+2) << "return true;\n";
+    OS.indent(Indent*2) << "}\n";
+    return;
+  }
+  }
+  assert(0 && "Unreachable");
+}
+
+/// EmitDirectMatcherList - Emit C++ code that runs the specified matcher
+/// subtree directly.  NodeStack is copied so that MoveChild and MoveParent
+/// only affect the rest of this list.
+void MatcherTableEmitter::
+EmitDirectMatcherList(const Matcher *N, unsigned Indent,
+                      std::vector<std::string> NodeStack,
+                      formatted_raw_ostream &OS) {
+  for (; N; N = N->getNext())
+    EmitDirectMatcher(N, Indent, NodeStack, OS);
+}
+
+/// EmitDirectFunction - Emit a member function that runs the specified
+/// matcher subtree on N0, the root of the match.  It returns true, with the
+/// selected node in Result, if one of the patterns matched.
+void MatcherTableEmitter::EmitDirectFunction(const std::string &Name,
+                                             const Matcher *N,
+                                             formatted_raw_ostream &OS) {
+  NextDirectID = 1;  // N0 is the root.
+  OS << "bool " << Name
+     << "(MatchState &S, SDValue N0, SDNode *&Result) {\n";
+  OS << "  do {\n";
+  EmitDirectMatcherList(N, 2, std::vector<std::string>(1, "N0"), OS);
+  OS << "  } while (0);\n";
+  OS << "  return false;\n";
+  OS << "}\n\n";
+}
+
+/// EmitDirectSelector - Emit SelectCode as C++ code that runs the matcher
+/// directly.  If the matcher starts by switching on the opcode of the root,
+/// each case gets its own function, and SelectCode dispatches to it.
+void MatcherTableEmitter::EmitDirectSelector(const Matcher *N,
+                                             formatted_raw_ostream &OS) {
+  std::vector<std::string> Cases, Functions;
+  const SwitchOpcodeMatcher *SOM = dyn_cast<SwitchOpcodeMatcher>(N);
+  if (SOM && SOM->getNext() == 0) {
+    for (unsigned i = 0, e = SOM->getNumCases(); i != e; ++i) {
+      std::string Opcode = SOM->getCaseOpcode(i).getEnumName();
+      std::string Name = "Match_" + Opcode;
+      for (size_t Pos; (Pos = Name.find("::")) != std::string::npos; )
+        Name.replace(Pos, 2, "_");
+      EmitDirectFunction(Name, SOM->getCaseMatcher(i), OS);
+      Cases.push_back(Opcode);
+      Functions.push_back(Name);
+    }
+  } else {
+    EmitDirectFunction("Match_All", N, OS);
+    Functions.push_back("Match_All");
+  }
+
+  OS << "// The main instruction selector code.\n";
+  OS << "SDNode *SelectCode(SDNode *N) {\n";
+  OS << "  if (useMatcherTable())\n";
+  OS << "    return SelectCodeWithTable(N);\n";
+  OS << "  SDNode *Result;\n";
+  OS << "  if (SelectSpecialNode(N, Result))\n";
+  OS << "    return Result;\n";
+  OS << "  assert(!N->isMachineOpcode() && \"Node already selected!\");\n\n";
+  OS << "  MatchState S(N);\n";
+  OS << "  SDValue N0(N, 0);\n";
+  if (Cases.empty()) {
+    OS << "  if (Match_All(S, N0, Result))\n";
+    OS << "    return Result;\n";
+  } else {
+    OS << "  switch (N->getOpcode()) {\n";
+    OS << "  default: break;\n";
+    for (unsigned i = 0, e = Cases.size(); i != e; ++i) {
+      OS << "  case " << Cases[i] << ":\n";
+      OS << "    if (" << Functions[i] << "(S, N0, Result)) return Result;\n";
+      OS << "    break;\n";
+    }
+    OS << "  }\n";
+  }
+  OS << "  CannotYetSelect(N);\n";
+  OS << "  return 0;\n";
+  OS << "}\n\n";
+}
+
 static void BuildHistogram(const Matcher *M, std::vector<unsigned> &OpcodeFreq){
   for (; M != 0; M = M->getNext()) {
     // Count this node.
@@ -804,11 +1340,19 @@ void llvm::EmitMatcherTable(const Matcher *TheMatcher,
                             raw_ostream &O) {
   formatted_raw_ostream OS(O);
 
-  OS << "// The main instruction selector code.\n";
-  OS << "SDNode *SelectCode(SDNode *N) {\n";
-
   MatcherTableEmitter MatcherEmitter(CGP, useEmitRegister2);
 
+  // The direct-dispatch selector keeps the matcher table as well, for
+  // -use-isel-matcher-table.  Both share the predicate functions.
+  if (DirectDispatch) {
+    MatcherEmitter.EmitDirectSelector(TheMatcher, OS);
+    OS << "// The matcher table the direct selector was compiled from.\n";
+    OS << "SDNode *SelectCodeWithTable(SDNode *N) {\n";
+  } else {
+    OS << "// The main instruction selector code.\n";
+    OS << "SDNode *SelectCode(SDNode *N) {\n";
+  }
+
   OS << "  // Some target values are emitted as 2 bytes, TARGET_VAL handles\n";
   OS << "  // this.\n";
   OS << "  #define TARGET_VAL(X) X & 255, unsigned(X) >> 8\n";
@@ -1290,6 +1290,12 @@ void Record::setName(const std::string &Name) {
   }
 }
 
+void Record::addSuperClass(Record *R) {
+  assert(!isSubClassOf(R) && "Already subclassing record!");
+  SuperClasses.push_back(R);
+  TrackedRecords.invalidateDerivedDefs();
+}
+
 /// resolveReferencesTo - If anything in this record refers to RV, replace the
 /// reference to RV with the RHS of RV.  If RV is null, we resolve all possible
 /// references.
@@ -1544,6 +1550,32 @@ raw_ostream &llvm::operator<<(raw_ostream &OS, const RecordKeeper &RK) {
 }
 
 
+/// buildDerivedDefs - Index every def under each of its superclasses.  Defs
+/// are visited in name order, so each list comes out sorted the same way a
+/// scan over Defs would produce it.
+void RecordKeeper::buildDerivedDefs() const {
+  DerivedDefs.clear();
+  for (std::map<std::string, Record*>::const_iterator I = Defs.begin(),
+         E = Defs.end(); I != E; ++I) {
+    const std::vector<Record*> &SCs = I->second->getSuperClasses();
+    for (unsigned i = 0, e = SCs.size(); i != e; ++i)
+      DerivedDefs[SCs[i]].push_back(I->second);
+  }
+  DerivedDefsValid = true;
+}
+
+const std::vector<Record*> &
+RecordKeeper::getDerivedDefinitions(const Record *Class) const {
+  if (!DerivedDefsValid)
+    buildDerivedDefs();
+  DenseMap<const Record*, std::vector<Record*> >::const_iterator I =
+    DerivedDefs.find(Class);
+  if (I != DerivedDefs.end())
+    return I->second;
+  static const std::vector<Record*> NoDefs;
+  return NoDefs;
+}
+
 /// getAllDerivedDefinitions - This method returns all concrete definitions
 /// that derive from the specified class name.  If a class with the specified
 /// name does not exist, an error is printed and true is returned.
@@ -1553,12 +1585,6 @@ RecordKeeper::getAllDerivedDefinitions(const std::string &ClassName) const {
   if (!Class)
     throw "ERROR: Couldn't find the `" + ClassName + "' class!\n";
 
-  std::vector<Record*> Defs;
-  for (std::map<std::string, Record*>::const_iterator I = getDefs().begin(),
-         E = getDefs().end(); I != E; ++I)
-    if (I->second->isSubClassOf(Class))
-      Defs.push_back(I->second);
-
-  return Defs;
+  return getDerivedDefinitions(Class);
 }
 
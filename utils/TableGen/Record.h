@@ -15,6 +15,8 @@
 #ifndef RECORD_H
 #define RECORD_H
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/DataTypes.h"
 #include "llvm/Support/raw_ostream.h"
@@ -1308,10 +1310,7 @@ public:
     return false;
   }
 
-  void addSuperClass(Record *R) {
-    assert(!isSubClassOf(R) && "Already subclassing record!");
-    SuperClasses.push_back(R);
-  }
+  void addSuperClass(Record *R);
 
   /// resolveReferences - If there are any field references that refer to fields
   /// that have been filled in, we can propagate the values now.
@@ -1414,7 +1413,21 @@ struct MultiClass {
 
 class RecordKeeper {
   std::map<std::string, Record*> Classes, Defs;
+
+  // ClassIndex/DefIndex - Hashed views of Classes and Defs, used for lookups
+  // by name.  The maps above own the records and provide the sorted order
+  // backends iterate in.
+  StringMap<Record*> ClassIndex, DefIndex;
+
+  // DerivedDefs - For each class, every def deriving from it in name order.
+  // Built on the first getAllDerivedDefinitions query and discarded whenever
+  // the set of records or their superclasses changes.
+  mutable DenseMap<const Record*, std::vector<Record*> > DerivedDefs;
+  mutable bool DerivedDefsValid;
+
+  void buildDerivedDefs() const;
 public:
+  RecordKeeper() : DerivedDefsValid(false) {}
   ~RecordKeeper() {
     for (std::map<std::string, Record*>::iterator I = Classes.begin(),
            E = Classes.end(); I != E; ++I)
@@ -1427,21 +1440,23 @@ public:
   const std::map<std::string, Record*> &getClasses() const { return Classes; }
   const std::map<std::string, Record*> &getDefs() const { return Defs; }
 
-  Record *getClass(const std::string &Name) const {
-    std::map<std::string, Record*>::const_iterator I = Classes.find(Name);
-    return I == Classes.end() ? 0 : I->second;
+  Record *getClass(StringRef Name) const {
+    return ClassIndex.lookup(Name);
   }
-  Record *getDef(const std::string &Name) const {
-    std::map<std::string, Record*>::const_iterator I = Defs.find(Name);
-    return I == Defs.end() ? 0 : I->second;
+  Record *getDef(StringRef Name) const {
+    return DefIndex.lookup(Name);
   }
   void addClass(Record *R) {
     assert(getClass(R->getName()) == 0 && "Class already exists!");
     Classes.insert(std::make_pair(R->getName(), R));
+    ClassIndex[R->getName()] = R;
+    invalidateDerivedDefs();
   }
   void addDef(Record *R) {
     assert(getDef(R->getName()) == 0 && "Def already exists!");
     Defs.insert(std::make_pair(R->getName(), R));
+    DefIndex[R->getName()] = R;
+    invalidateDerivedDefs();
   }
 
   /// removeClass - Remove, but do not delete, the specified record.
@@ -1449,12 +1464,24 @@ public:
   void removeClass(const std::string &Name) {
     assert(Classes.count(Name) && "Class does not exist!");
     Classes.erase(Name);
+    ClassIndex.erase(Name);
+    invalidateDerivedDefs();
   }
   /// removeDef - Remove, but do not delete, the specified record.
   ///
   void removeDef(const std::string &Name) {
     assert(Defs.count(Name) && "Def does not exist!");
     Defs.erase(Name);
+    DefIndex.erase(Name);
+    invalidateDerivedDefs();
+  }
+
+  /// invalidateDerivedDefs - Drop the class-to-derived-defs index.  Called
+  /// when records are added or removed, or a record gains a superclass.
+  void invalidateDerivedDefs() {
+    if (!DerivedDefsValid) return;
+    DerivedDefs.clear();
+    DerivedDefsValid = false;
   }
 
   //===--------------------------------------------------------------------===//
@@ -1466,6 +1493,11 @@ public:
   std::vector<Record*>
   getAllDerivedDefinitions(const std::string &ClassName) const;
 
+  /// getDerivedDefinitions - Return all concrete definitions that derive from
+  /// the specified class, sorted by name.  The reference stays valid until
+  /// the next change to the record set.
+  const std::vector<Record*> &getDerivedDefinitions(const Record *Class) const;
+
   void dump() const;
 };
 